@@ -3,11 +3,18 @@
 
 #include "types.h"
 
+/* Value of nav_input::version for the layout in this header. */
+#define NAV_INPUT_VERSION UINT64_C(0x4E4156494E505431)
+
 /**
  * @brief NAV "input stream".
  * 
- * For user-defined "input stream", populate the struct accordingly.
+ * Every nav_input must be initialized by nav_input_init() or one of the nav_input_populate_* functions before it's
+ * used. For user-defined "input stream", call nav_input_init() first, then set the functions that are implemented.
  * This struct can be allocated on stack, and is assumed so.
+ * 
+ * @note This struct grew in NAV 0.4.0. Code that was built against older headers must be rebuilt, which is why the
+ *       shared library name changed too.
  */
 typedef struct nav_input
 {
@@ -48,11 +55,43 @@ typedef struct nav_input
 
 	/**
 	 * @brief Function to get "input stream" size. Stream must support this!
+	 * 
+	 * This may be called often, so it should be cheap. Compute the size once when populating the struct if possible.
 	 * @param userdata Function-specific userdata.
 	 * @return Stream size in bytes.
 	 */
 	uint64_t (*size)(void *userdata);
 
+	/**
+	 * @brief Set to NAV_INPUT_VERSION by nav_input_init(). The functions below are ignored otherwise.
+	 */
+	uint64_t version;
+
+	/**
+	 * @brief Optional function to access "input stream" data in-place, without copying. Stream position is not changed.
+	 * 
+	 * This is meant for inputs whose data is already in memory. Backends that can use it avoid copying the data.
+	 * @param userdata Function-specific userdata.
+	 * @param offset Position of the data, based on the beginning of the file.
+	 * @param size Amount of bytes wanted.
+	 * @param ptr Pointer to the data is stored here. It must stay valid until `close` is called.
+	 * @return Amount of bytes available at `ptr`, at most `size`. Zero if `offset` is at the end of the stream.
+	 */
+	size_t (*borrow)(void *userdata, uint64_t offset, size_t size, const void **ptr);
+
+	/**
+	 * @brief Optional function to read from "input stream" at specific position. Stream position is not changed.
+	 * 
+	 * Backends that can use it track the position themselves, so seeking doesn't have to touch the input. It must be
+	 * safe to call from multiple threads at once, and together with the other functions.
+	 * @param userdata Function-specific userdata.
+	 * @param offset Position to read from, based on the beginning of the file.
+	 * @param dest Output buffer.
+	 * @param size Amount of bytes to read.
+	 * @return Amount of bytes read. Less than `size` only at the end of the stream or on error.
+	 */
+	size_t (*read_at)(void *userdata, uint64_t offset, void *dest, size_t size);
+
 #ifdef __cplusplus
 	inline void closef()
 	{
@@ -78,6 +117,26 @@ typedef struct nav_input
 	{
 		return size(userdata);
 	}
+
+	inline bool canBorrow() const
+	{
+		return version == NAV_INPUT_VERSION && borrow != nullptr;
+	}
+
+	inline size_t borrowf(uint64_t offset, size_t size, const void **ptr)
+	{
+		return borrow(userdata, offset, size, ptr);
+	}
+
+	inline bool canReadAt() const
+	{
+		return version == NAV_INPUT_VERSION && read_at != nullptr;
+	}
+
+	inline size_t readAtf(uint64_t offset, void *dest, size_t size)
+	{
+		return read_at(userdata, offset, dest, size);
+	}
 #endif /* __cplusplus */
 } nav_input;
 
@@ -10,7 +10,7 @@
 #define _NAV_H_
 
 #define NAV_VERSION_MAJOR 0
-#define NAV_VERSION_MINOR 3
+#define NAV_VERSION_MINOR 4
 #define NAV_VERSION_PATCH 0
 #define NAV_VERSION_FORMAT(a, b, c) ((a << 16) | (b << 8) | c)
 #define NAV_VERSION NAV_VERSION_FORMAT(NAV_VERSION_MAJOR, NAV_VERSION_MINOR, NAV_VERSION_PATCH)
@@ -62,12 +62,24 @@ NAV_API const char *nav_version_string();
  */
 NAV_API const char *nav_error();
 
+/**
+ * @brief Initialize nav_input for a user-defined "input stream".
+ * 
+ * This clears every function and sets `version`, so the optional functions that are set afterwards are used. This
+ * or one of the nav_input_populate_* functions is required before a nav_input is passed to any other function.
+ * 
+ * @param input Allocated, but uninitialized pointer to nav_input.
+ * @note The nav_input_populate_* functions already do this.
+ */
+NAV_API void nav_input_init(nav_input *input);
+
 /**
  * @brief Populate pointer of nav_input to read input data from memory.
  * @param input Allocated, but uninitialized pointer to nav_input.
  * @param buf Memory buffer.
  * @param size Size of memory buffer, in bytes.
  * @note Ensure `buf` exist during the whole lifetime of the nav_input.
+ * @note The resulting nav_input supports `borrow`.
  */
 NAV_API void nav_input_populate_from_memory(nav_input *input, void *buf, size_t size);
 
@@ -79,8 +91,37 @@ NAV_API void nav_input_populate_from_memory(nav_input *input, void *buf, size_t
  */
 NAV_API nav_bool nav_input_populate_from_file(nav_input *input, const char *filename);
 
+/**
+ * @brief Populate pointer of nav_input to read input data from file by mapping the whole file into memory.
+ * 
+ * Unlike nav_input_populate_from_file(), the resulting nav_input supports `borrow`, which lets backends consume the
+ * file data without copying it.
+ * @param input Allocated, but uninitialized pointer to nav_input.
+ * @param filename Path to the UTF-8 encoded file.
+ * @return 1 if success, 0 otherwise.
+ * @note The file must not be truncated while the nav_input is open.
+ * @sa nav_input_populate_from_file
+ */
+NAV_API nav_bool nav_input_populate_from_file_mapped(nav_input *input, const char *filename);
+
+/**
+ * @brief Populate pointer of nav_input to read input data from file, with the upcoming data read in the background.
+ * 
+ * A few blocks ahead of the read position are always being read, so reads rarely wait for the disk. On Linux, the
+ * reads go through io_uring, unless it's unavailable or `NAV_DISABLE_IO_URING` environment variable is set, in which
+ * case a background thread reads them. On Windows, this is the same as nav_input_populate_from_file().
+ * @param input Allocated, but uninitialized pointer to nav_input.
+ * @param filename Path to the UTF-8 encoded file.
+ * @return 1 if success, 0 otherwise.
+ * @sa nav_input_populate_from_file
+ */
+NAV_API nav_bool nav_input_populate_from_file_async(nav_input *input, const char *filename);
+
 /**
  * @brief Get amount of available backends.
+ * 
+ * Backends are only loaded when they're first needed, so this also counts backends whose libraries turn out to be
+ * missing later. Backends disabled through `NAV_DISABLE_*` environment variables are not counted.
  * @return Amount of available backends. 0 means no backends are available.
  */
 NAV_API size_t nav_backend_count();
@@ -102,12 +143,41 @@ NAV_API nav_backendtype nav_backend_type(size_t index);
 
 /**
  * @brief Get additional information of a certain backend.
+ * 
+ * This loads the backend if it's not loaded yet.
  * @param index **1-based index** of the backend. So, 1 is the first backend, 2 is the second backend, and so on.
  * @return Additional information about the backend, or NULL if there are no additional information or on failure.
- * @note use nav_error() to check if an error occured or a backend has no additional information.
+ * @note use nav_error() to check if an error occured, such as the backend failing to load, or a backend has no
+ *       additional information.
  */
 NAV_API const char *nav_backend_info(size_t index);
 
+/**
+ * @brief Load all backends now instead of when they're first needed.
+ * 
+ * Loading a backend involves loading its libraries, which can take a while. Calling this early hides that cost from
+ * the first nav_open().
+ * @param background Load them in a background thread and return immediately. Backends that must be loaded in the
+ *                   thread that uses them, such as Media Foundation, are still loaded when they're first needed.
+ */
+NAV_API void nav_preload_backends(nav_bool background);
+
+/**
+ * @brief Set the directory where probe cache entries are stored, so they persist across processes.
+ * 
+ * Entries are only used for nav_open() calls that enable `probe_cache` in nav_settings. Entries are always kept in
+ * memory as well. The directory must exist and be writable. Entries are never removed from the directory by NAV.
+ * @param directory Path to the UTF-8 encoded directory, or NULL to only keep entries in memory.
+ * @sa nav_probe_cache_clear
+ */
+NAV_API void nav_probe_cache_set_directory(const char *directory);
+
+/**
+ * @brief Forget all in-memory probe cache entries. Entries stored in the directory are left alone.
+ * @sa nav_probe_cache_set_directory
+ */
+NAV_API void nav_probe_cache_clear();
+
 /**
  * @brief Open new NAV instance.
  * 
@@ -126,10 +196,34 @@ NAV_NODISCARD NAV_API nav_t *nav_open(nav_input *input, const char *filename, co
 
 /**
  * @brief Close existing NAV instance.
+ * 
+ * This also stops the background decode thread, if any.
+ * 
  * @param nav Pointer to NAV instance.
  */
 NAV_API void nav_close(nav_t *nav);
 
+/**
+ * @brief Reuse existing NAV instance for another input.
+ * 
+ * If the streams of the new input have the same codec parameters as the current ones, the instance keeps its
+ * decoders, converters, and stream settings, and only replaces the demuxer. This is much faster than nav_open() for
+ * inputs encoded the same way, such as segments of a playlist. The position goes back to the start and frames read
+ * ahead from the previous input are dropped.
+ * 
+ * Otherwise, a new NAV instance is opened with the same settings and `nav` is closed. The new instance starts with
+ * default stream settings. Not all backends can keep their decoders, in which case this always opens a new instance.
+ * 
+ * @param nav Pointer to NAV instance.
+ * @param input Pointer to "input data". On success, this function takes the ownership of the input and closes the
+ *              previous input. As with nav_open(), the struct itself can then be refilled for the next input.
+ * @param filename Pseudo-filename that will be used to improve probing, as in nav_open().
+ * @return `nav` if it's reused, new NAV instance if it's not, or NULL on failure.
+ * @note When the function errors, `nav` is left as-is and the input ownership will be given back to the caller. The
+ *       input is seeked back to the position it had when this function is called.
+ */
+NAV_NODISCARD NAV_API nav_t *nav_reopen(nav_t *nav, nav_input *input, const char *filename);
+
 /**
  * @brief Get backend index that crated this NAV instance.
  * @param nav Pointer to NAV instance.
@@ -179,10 +273,91 @@ NAV_API nav_bool nav_stream_is_enabled(const nav_t *nav, size_t index);
  */
 NAV_API nav_bool nav_stream_enable(nav_t *nav, size_t index, nav_bool enable);
 
+/**
+ * @brief Set the output pixel format of a video stream.
+ * 
+ * The decoded frames are converted to the requested pixel format in a single pass by the backend. This must be
+ * called before the decoder is initialized.
+ * 
+ * @param nav Pointer to NAV instance.
+ * @param index Video stream index.
+ * @param pixfmt Requested pixel format.
+ * @return 1 if the change success, 0 otherwise (e.g. the backend can't convert to the requested pixel format).
+ * @note On success, the stream info returned by nav_stream_info() reflects the new pixel format.
+ * @sa nav_prepare nav_video_pixel_format
+ */
+NAV_API nav_bool nav_stream_set_pixel_format(nav_t *nav, size_t index, nav_pixelformat pixfmt);
+
+/**
+ * @brief Set the output dimensions of a video stream.
+ * 
+ * The decoded frames are scaled in the same pass as the pixel format conversion, which is considerably cheaper than
+ * scaling them afterwards when the requested dimensions are smaller. This must be called before the decoder is
+ * initialized.
+ * 
+ * @param nav Pointer to NAV instance.
+ * @param index Video stream index.
+ * @param width Requested width, or 0 to use the original width.
+ * @param height Requested height, or 0 to use the original height.
+ * @param scaler Scaling algorithm to use.
+ * @return 1 if the change success, 0 otherwise (e.g. the backend can't scale the video).
+ * @note On success, the stream info returned by nav_stream_info() reflects the new dimensions.
+ * @sa nav_prepare nav_stream_set_pixel_format
+ */
+NAV_API nav_bool nav_stream_set_video_size(nav_t *nav, size_t index, uint32_t width, uint32_t height, nav_scaler scaler);
+
+/**
+ * @brief Only decode keyframes of a video stream.
+ * 
+ * This is useful for generating thumbnails or scrubbing through long videos, where roughly one frame per group of
+ * pictures is enough. Frames that aren't keyframes are skipped before they're decoded. Unlike the other stream
+ * settings, this can be changed at any time. Turning it off drops the frames of this stream that are already queued,
+ * and full decoding resumes from the next keyframe.
+ * 
+ * @param nav Pointer to NAV instance.
+ * @param index Video stream index.
+ * @param keyframes_only 1 to decode only keyframes, 0 to decode all frames.
+ * @return 1 if the change success, 0 otherwise (e.g. the backend can't skip frames).
+ * @note Some backends (GStreamer) can only apply this to all video streams at once. In that case, the remaining video
+ *       streams also skip non-keyframes while any of them has this enabled.
+ */
+NAV_API nav_bool nav_stream_set_keyframes_only(nav_t *nav, size_t index, nav_bool keyframes_only);
+
+/**
+ * @brief Set the output sample format of an audio stream.
+ * 
+ * The sample rate and channel layout are kept as-is. Converting 32-bit float samples to 16-bit signed integer applies
+ * triangular dither. This must be called before the decoder is initialized.
+ * 
+ * @param nav Pointer to NAV instance.
+ * @param index Audio stream index.
+ * @param format Requested audio format. Only native-endian formats are accepted.
+ * @return 1 if the change success, 0 otherwise (e.g. the backend can't convert to the requested audio format).
+ * @note On success, the stream info returned by nav_stream_info() reflects the new audio format.
+ * @sa nav_prepare nav_audio_format
+ */
+NAV_API nav_bool nav_stream_set_audio_format(nav_t *nav, size_t index, nav_audioformat format);
+
+/**
+ * @brief Get the decoder delay of a stream.
+ * 
+ * This is the amount of frames the decoder needs to receive before it outputs the first one, such as after a seek.
+ * It comes from frame reordering and from decoding several frames at once in multiple threads. The latter can be
+ * avoided with `low_latency` in nav_settings. The value is only accurate once the stream is prepared.
+ * 
+ * @param nav Pointer to NAV instance.
+ * @param index Stream index.
+ * @return Decoder delay in frames, or 0 if there's none or the backend can't tell.
+ * @sa nav_prepare
+ */
+NAV_API uint32_t nav_stream_decoder_delay(const nav_t *nav, size_t index);
+
 /**
  * @brief Get media position.
  * @param nav Pointer to NAV instance.
  * @return Current media position in seconds, or -1 if unknown.
+ * @note When background decoding is enabled (see nav_settings::prefetch_frames), this is the position of the last
+ *       frame that was read, or the position passed to nav_seek() until a frame is read after it.
  */
 NAV_API double nav_tell(nav_t *nav);
 
@@ -199,9 +374,28 @@ NAV_API double nav_duration(nav_t *nav);
  * @param position Position in seconds, relative to the beginning of the media.
  * @return New (re-adjusted) position, or -1 on unknown or failure.
  * @note nav_error() will return NULL on success but new position can't be determined, non-NULL otherwise.
+ * @note When background decoding is enabled (see nav_settings::prefetch_frames), this returns immediately with
+ *       `position` after discarding the frames decoded ahead. The decode thread then seeks, and seek failure is
+ *       reported by the next nav_read() instead.
  */
 NAV_API double nav_seek(nav_t *nav, double position);
 
+/**
+ * @brief Set media position with additional seeking flags.
+ * 
+ * With NAV_SEEK_ACCURATE, the frames between the keyframe and the requested position are decoded then dropped inside
+ * the library without being converted. The first video frame returned is the one visible at `position` and the first
+ * audio frame is trimmed to start at the exact sample.
+ * 
+ * @param nav Pointer to NAV instance.
+ * @param position Position in seconds, relative to the beginning of the media.
+ * @param flags Combination of nav_seekflag values.
+ * @return New (re-adjusted) position, or -1 on unknown or failure.
+ * @note Same notes as nav_seek() apply.
+ * @sa nav_seek
+ */
+NAV_API double nav_seek_ex(nav_t *nav, double position, uint32_t flags);
+
 /**
  * @brief Initialize decoders.
  * 
@@ -235,6 +429,85 @@ NAV_API bool nav_is_prepared(const nav_t *nav);
  */
 NAV_NODISCARD NAV_API nav_frame_t *nav_read(nav_t *nav);
 
+/**
+ * @brief Decode stream from NAV instance directly into caller-owned memory.
+ * 
+ * This works like nav_read(), but the decoded frame is written straight into `planes`, skipping NAV's own frame
+ * buffer. For video, `nplanes` must equal nav_video_plane_count() of the stream pixel format and each `strides` must
+ * be at least the plane width returned by nav_video_plane_dimensions(). For audio, `nplanes` must be 1 and
+ * `strides[0]` is the capacity of `planes[0]` in bytes.
+ * 
+ * If the decoded frame doesn't fit the supplied memory (e.g. it belongs to a stream with different layout), the frame
+ * is returned as if nav_read() is called. Compare the pointers returned by nav_frame_acquire() against `planes` to
+ * know where the data lives.
+ * 
+ * @param nav Pointer to NAV instance.
+ * @param planes Array of pointer to each destination plane.
+ * @param strides Array of strides/pitch of each destination plane in bytes. Negative stride means plane is bottom-up.
+ * @param nplanes Amount of destination planes.
+ * @return Pointer to the NAV decoded frame instance, or NULL on failure.
+ * @note nav_error() will return NULL on EOS, non-NULL otherwise.
+ * @note The memory pointed by `planes` must stay valid until the returned frame is freed.
+ * @sa nav_read nav_frame_acquire
+ */
+NAV_NODISCARD NAV_API nav_frame_t *nav_read_into(nav_t *nav, uint8_t *const *planes, const ptrdiff_t *strides, size_t nplanes);
+
+/**
+ * @brief Decode all frames that are ready from NAV instance in one call.
+ * 
+ * This blocks until at least 1 frame is decoded like nav_read(), then collects the rest of the frames the decoders
+ * already have without reading more data from the input.
+ * 
+ * @param nav Pointer to NAV instance.
+ * @param out Array to store at most `max` pointer to NAV decoded frame instances.
+ * @param max Size of the `out` array.
+ * @param count Pointer to store the amount of frames written to `out`. 0 means EOS if this function succeeded.
+ * @return 1 on success, 0 on failure (including when `count` is NULL, or `out` is NULL and `max` isn't 0).
+ * @note On failure, frames that are already stored in `out` (as specified by `count`) are still valid and must be
+ *       freed.
+ * @sa nav_read nav_frame_free
+ */
+NAV_API nav_bool nav_read_batch(nav_t *nav, nav_frame_t **out, size_t max, size_t *count);
+
+/**
+ * @brief Decode next frame of a specific stream from NAV instance.
+ * 
+ * Frames of the other streams that are decoded in the meantime are kept in per-stream queues, so different threads
+ * can each call this function for their own stream. Only one thread decodes at a time, and the rest take their frames
+ * from the queue once it's available.
+ * 
+ * The queue of a stream only grows past its limit when no thread is currently waiting for that stream. Otherwise the
+ * decoding thread waits until that stream is read, so enabled streams should either be read or be disabled. A stream
+ * that nobody is reading keeps at most 256 frames or 256MiB of video. Its oldest frames are dropped beyond that.
+ * 
+ * @param nav Pointer to NAV instance.
+ * @param index Stream index. The stream must be enabled.
+ * @return Pointer to NAV decoded frame instance, or NULL on failure or EOS.
+ * @note Use nav_error() to differentiate between failure or EOS.
+ * @note Call nav_prepare() first before reading from multiple threads.
+ * @sa nav_read nav_frame_free
+ */
+NAV_NODISCARD NAV_API nav_frame_t *nav_read_stream(nav_t *nav, size_t index);
+
+/**
+ * @brief Decode exactly `nframes` audio sample frames of an audio stream.
+ * 
+ * Decoded samples that don't fit in `dst` are kept inside the NAV instance and returned by the next call of this
+ * function. Frames of other streams that are decoded in the meantime are kept too, and returned by subsequent
+ * nav_read() calls in decode order, up to the same limits as nav_read_stream().
+ * 
+ * @param nav Pointer to NAV instance.
+ * @param stream Audio stream index.
+ * @param dst Destination buffer to write the interleaved samples, which must hold at least
+ *            `nframes * nav_audio_size(nav_stream_info(nav, stream))` bytes.
+ * @param nframes Amount of sample frames to decode.
+ * @return Amount of sample frames written to `dst`. This is less than `nframes` only when EOS is reached. On failure,
+ *         this returns 0 and nav_error() returns non-NULL.
+ * @note Seeking or disabling the stream discards the leftover samples.
+ * @sa nav_read
+ */
+NAV_API size_t nav_read_audio(nav_t *nav, size_t stream, void *dst, size_t nframes);
+
 /**
  * @brief Get stream type.
  * @param streaminfo Pointer to NAV stream information.
@@ -45,9 +45,39 @@ typedef enum nav_pixelformat
 	/* YUV 4:4:4 subsampling, planar. */
 	NAV_PIXELFORMAT_YUV444,
 	/* YUV 4:2:0 subsampling, Y is planar, UV is packed. */
-	NAV_PIXELFORMAT_NV12
+	NAV_PIXELFORMAT_NV12,
+	/* RGBA, 32 bits per pixel, packed. Only available through nav_stream_set_pixel_format(). */
+	NAV_PIXELFORMAT_RGBA8,
+	/* BGRA, 32 bits per pixel, packed. Only available through nav_stream_set_pixel_format(). */
+	NAV_PIXELFORMAT_BGRA8
 } nav_pixelformat;
 
+/**
+ * @brief Scaling algorithm used when video frames are resized during decoding.
+ */
+typedef enum nav_scaler
+{
+	/* Let the backend decide. */
+	NAV_SCALER_DEFAULT,
+	/* Fastest, lower quality. Suitable for thumbnails and previews. */
+	NAV_SCALER_FAST_BILINEAR,
+	/* Bilinear filtering. */
+	NAV_SCALER_BILINEAR,
+	/* Bicubic filtering. Slower, higher quality. */
+	NAV_SCALER_BICUBIC
+} nav_scaler;
+
+/**
+ * @brief Flags for nav_seek_ex().
+ */
+typedef enum nav_seekflag
+{
+	/* Seek to the nearest keyframe at or before the requested position, like nav_seek(). */
+	NAV_SEEK_DEFAULT = 0,
+	/* Frames before the requested position are decoded and dropped so the first frame starts there. */
+	NAV_SEEK_ACCURATE = 1
+} nav_seekflag;
+
 /**
  * @brief Possible stream type.
  * @sa nav_streaminfo_t
@@ -84,7 +114,17 @@ typedef enum nav_hwacceltype
 	NAV_HWACCELTYPE_VAAPI,
 } nav_hwacceltype;
 
-#define NAV_SETTINGS_VERSION 0
+typedef enum nav_priority
+{
+	/* Default priority. */
+	NAV_PRIORITY_NORMAL,
+	/* Work of this instance runs before the work of other instances, such as for foreground playback. */
+	NAV_PRIORITY_HIGH,
+	/* Work of this instance runs only when no other instance has work queued, such as for thumbnailing. */
+	NAV_PRIORITY_LOW,
+} nav_priority;
+
+#define NAV_SETTINGS_VERSION 6
 
 typedef struct nav_settings
 {
@@ -102,6 +142,57 @@ typedef struct nav_settings
 	uint32_t max_threads;
 	/* If true, this hints backends to prefer CPU decoding. */
 	nav_bool disable_hwaccel;
+	/* (Version 1) Amount of frames to decode ahead of the caller in a background thread. If this or `prefetch_bytes`
+	 * is not 0, a decode thread is started on the first nav_prepare() and nav_read() takes frames decoded by it. 0 means
+	 * no limit on the amount of frames if `prefetch_bytes` is not 0. Defaults to 0 (no background decoding).
+	 * **Note**: Hardware-accelerated frames that are decoded ahead are downloaded to memory, as the decoder only has a
+	 * few hardware frames to decode into. */
+	uint32_t prefetch_frames;
+	/* (Version 1) Approximate amount of memory, in bytes, of video frames to decode ahead of the caller in a background
+	 * thread. 0 means no limit on the memory if `prefetch_frames` is not 0. Defaults to 0. */
+	uint64_t prefetch_bytes;
+	/* (Version 2) Size, in bytes, of the chunks backends read from the input at once, where the backend reads the input
+	 * itself. Larger values mean fewer read calls, which matters for network filesystems. 0 uses the default of 64KiB. */
+	uint32_t io_buffer_size;
+	/* (Version 2) If not 0, the input is read in windows of this size, in bytes, and the window after the one being
+	 * consumed is read in a background thread. Inputs that support `borrow` are never read ahead. Defaults to 0. */
+	uint32_t readahead_size;
+	/* (Version 3) Maximum amount of bytes read to detect the container format and its streams. Smaller values open
+	 * faster but may miss streams that start late in the file. 0 uses the backend default. */
+	uint64_t probe_size;
+	/* (Version 3) Maximum duration, in seconds, of the media decoded to find the stream parameters. 0 uses the backend
+	 * default. */
+	double analyze_duration;
+	/* (Version 3) If true, skip decoding to find the stream parameters when the container headers already describe
+	 * every stream completely. This makes opening considerably faster, but it relies on the headers being correct.
+	 * Defaults to false. */
+	nav_bool trust_headers;
+	/* (Version 4) If true, remember which backend opened the input and what it found while probing, so opening the same
+	 * input again skips trying other backends and most of the probing. The input is identified by `probe_cache_key`,
+	 * or if that's NULL, by the path, size, and modification time of the file named by the `filename` passed to
+	 * nav_open(). Defaults to false. See also nav_probe_cache_set_directory(). */
+	nav_bool probe_cache;
+	/* (Version 4) Caller-supplied identity of the input content, such as a content hash. Only used if `probe_cache` is
+	 * true. Inputs with different content must not share a key. Defaults to NULL. */
+	const char *probe_cache_key;
+	/* (Version 5) If true, decoding and conversion work is run in a thread pool shared by every instance with this
+	 * setting, sized to the amount of threads in the system, instead of threads owned by the instance. Use this when
+	 * many instances are open at once. `max_threads` is ignored for this instance. Defaults to false.
+	 * **Note**: Only the slices of a frame can run in the pool, so decoders don't decode several frames at once. Video
+	 * that's encoded as one slice per frame (which is common for H.264) is decoded by one thread at a time, so a
+	 * single instance decodes it slower than without this setting. At most 4 slices of a frame run at once, and each
+	 * video decoder still keeps up to 3 idle threads of its own. */
+	nav_bool shared_thread_pool;
+	/* (Version 5) Order of the work of this instance in the shared thread pool relative to other instances. Only used
+	 * if `shared_thread_pool` is true. Defaults to NAV_PRIORITY_NORMAL. */
+	nav_priority priority;
+	/* (Version 6) If true, tune decoding for the delay between sending a packet and getting its frame instead of for
+	 * throughput. Decoders only split frames into slices across threads instead of decoding several frames at once,
+	 * frames are output as soon as possible, and `prefetch_frames` and `prefetch_bytes` are ignored. Streams that
+	 * reorder frames (e.g. with B-frames) still wait for the frames they reorder, so they keep some delay. This makes
+	 * seeking in interactive previews more responsive at the cost of decoding speed. See also
+	 * nav_stream_decoder_delay(). Defaults to false. */
+	nav_bool low_latency;
 } nav_settings;
 
 #endif /* _NAV_TYPES_H_ */
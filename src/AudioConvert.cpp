@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "AudioConvert.hpp"
+#include "AudioKernels.hpp"
+#include "CPUFeatures.hpp"
+
+namespace nav
+{
+
+// Dither noise repeats every DITHER_SIZE samples. The table has DITHER_CHUNK extra entries at the end so a chunk never
+// has to wrap around.
+static constexpr size_t DITHER_SIZE = 4096;
+static constexpr size_t DITHER_CHUNK = 1024;
+// Offset between channels so they don't get the same noise.
+static constexpr size_t DITHER_CHANNEL_STRIDE = 1031;
+
+template<typename T>
+static void interleaveGeneric(T *dst, const T *const *src, size_t nchannels, size_t n)
+{
+	if (nchannels == 1)
+	{
+		std::copy(src[0], src[0] + n, dst);
+		return;
+	}
+
+	for (size_t i = 0; i < n; i++)
+	{
+		for (size_t c = 0; c < nchannels; c++)
+			*dst++ = src[c][i];
+	}
+}
+
+namespace scalar
+{
+
+static inline int16_t toS16(float x, float dither) noexcept
+{
+	// Scaling by a power of 2 is exact, so the result is the same with or without fused multiply-add.
+	float s = x * 32768.0f + dither;
+	// Written so NaN becomes the lower bound, like the SIMD variants.
+	s = s > -32768.0f ? s : -32768.0f;
+	s = s < 32767.0f ? s : 32767.0f;
+	return (int16_t) std::lrint(s);
+}
+
+void interleave16(uint16_t *dst, const uint16_t *const *src, size_t nchannels, size_t n)
+{
+	interleaveGeneric(dst, src, nchannels, n);
+}
+
+void interleave32(uint32_t *dst, const uint32_t *const *src, size_t nchannels, size_t n)
+{
+	interleaveGeneric(dst, src, nchannels, n);
+}
+
+void floatToS16(int16_t *dst, const float *const *src, const float *const *dither, size_t nchannels, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		for (size_t c = 0; c < nchannels; c++)
+			*dst++ = toS16(src[c][i], dither[c][i]);
+	}
+}
+
+}
+
+static const AudioKernels SCALAR_KERNELS = {
+	"scalar",
+	scalar::interleave16,
+	scalar::interleave32,
+	scalar::floatToS16
+};
+
+static const AudioKernels *selectKernels() noexcept
+{
+	const AudioKernels *kernels = nullptr;
+
+	if (cpu::hasAVX2())
+		kernels = getAVX2AudioKernels();
+	if (kernels == nullptr && cpu::hasSSE2())
+		kernels = getSSE2AudioKernels();
+	if (kernels == nullptr && cpu::hasNEON())
+		kernels = getNEONAudioKernels();
+
+	return kernels ? kernels : &SCALAR_KERNELS;
+}
+
+static const AudioKernels *getKernels() noexcept
+{
+	static const AudioKernels *kernels = selectKernels();
+	return kernels;
+}
+
+// Triangular PDF noise in the (-1, 1) LSB range. Deterministic, so decoding the same input gives the same output.
+static const float *getDitherTable()
+{
+	static const std::vector<float> table = []()
+	{
+		std::vector<float> result(DITHER_SIZE + DITHER_CHUNK);
+		uint32_t seed = 0x6E6176u;
+
+		auto next = [&seed]()
+		{
+			seed = seed * 1664525u + 1013904223u;
+			return (float) (seed >> 8) / 16777216.0f;
+		};
+
+		for (size_t i = 0; i < DITHER_SIZE; i++)
+		{
+			float a = next();
+			result[i] = a + next() - 1.0f;
+		}
+
+		std::copy(result.begin(), result.begin() + DITHER_CHUNK, result.begin() + DITHER_SIZE);
+		return result;
+	}();
+
+	return table.data();
+}
+
+const char *getAudioKernelsName() noexcept
+{
+	return getKernels()->name;
+}
+
+AudioConverter::AudioConverter(Mode mode, size_t sampleSize, size_t nchannels, bool planar)
+: mode(mode)
+, sampleSize(sampleSize)
+, nchannels(nchannels)
+, planar(planar)
+, ditherPosition(0)
+, kernels(getKernels())
+, planes()
+, dither()
+{
+	if (mode == Mode::FLOAT_TO_S16)
+	{
+		planes.resize(planar ? nchannels : 1);
+		dither.resize(planes.size());
+	}
+}
+
+AudioConverter AudioConverter::interleave(size_t sampleSize, size_t nchannels)
+{
+	return AudioConverter(Mode::INTERLEAVE, sampleSize, nchannels, true);
+}
+
+AudioConverter AudioConverter::floatToS16(size_t nchannels, bool planar)
+{
+	return AudioConverter(Mode::FLOAT_TO_S16, sizeof(float), nchannels, planar);
+}
+
+void AudioConverter::convert(const uint8_t *const *src, uint8_t *dst, size_t nframes)
+{
+	const AudioKernels &k = *kernels;
+
+	switch (mode)
+	{
+		case Mode::INTERLEAVE:
+		{
+			switch (sampleSize)
+			{
+				case 1:
+					interleaveGeneric(dst, src, nchannels, nframes);
+					break;
+				case 2:
+					k.interleave16((uint16_t*) dst, (const uint16_t *const *) src, nchannels, nframes);
+					break;
+				case 4:
+					k.interleave32((uint32_t*) dst, (const uint32_t *const *) src, nchannels, nframes);
+					break;
+				case 8:
+					interleaveGeneric((uint64_t*) dst, (const uint64_t *const *) src, nchannels, nframes);
+					break;
+				default:
+					break;
+			}
+
+			break;
+		}
+		case Mode::FLOAT_TO_S16:
+		{
+			// Packed source is handled as a single plane.
+			size_t nplanes = planes.size();
+			size_t nsamples = planar ? nframes : nframes * nchannels;
+			const float *ditherTable = getDitherTable();
+			int16_t *out = (int16_t*) dst;
+
+			for (size_t i = 0; i < nsamples; i += DITHER_CHUNK)
+			{
+				size_t n = std::min(nsamples - i, DITHER_CHUNK);
+
+				for (size_t c = 0; c < nplanes; c++)
+				{
+					planes[c] = ((const float*) src[c]) + i;
+					dither[c] = ditherTable + (ditherPosition + c * DITHER_CHANNEL_STRIDE) % DITHER_SIZE;
+				}
+
+				k.floatToS16(out, planes.data(), dither.data(), nplanes, n);
+				out += n * nplanes;
+				ditherPosition = (ditherPosition + n) % DITHER_SIZE;
+			}
+
+			break;
+		}
+	}
+}
+
+}
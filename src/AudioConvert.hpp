@@ -0,0 +1,50 @@
+#ifndef _NAV_AUDIO_CONVERT_HPP_
+#define _NAV_AUDIO_CONVERT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nav
+{
+
+struct AudioKernels;
+
+// Same-rate, same-layout sample conversion without going through the backend resampler. The kernels are picked by
+// the CPU features at runtime.
+class AudioConverter
+{
+public:
+	// Planar samples of `sampleSize` (1, 2, 4, or 8) bytes to packed.
+	static AudioConverter interleave(size_t sampleSize, size_t nchannels);
+	// 32-bit float, planar or packed, to packed signed 16-bit with triangular dither.
+	static AudioConverter floatToS16(size_t nchannels, bool planar);
+
+	// `src` holds one plane for each channel if the source is planar, or just one plane otherwise. Not thread-safe,
+	// as the dither position carries over between calls.
+	void convert(const uint8_t *const *src, uint8_t *dst, size_t nframes);
+
+private:
+	enum class Mode
+	{
+		INTERLEAVE,
+		FLOAT_TO_S16
+	};
+
+	AudioConverter(Mode mode, size_t sampleSize, size_t nchannels, bool planar);
+
+	Mode mode;
+	size_t sampleSize, nchannels;
+	bool planar;
+	size_t ditherPosition;
+	const AudioKernels *kernels;
+	// Scratch space for the plane and dither pointers of each chunk.
+	std::vector<const float*> planes, dither;
+};
+
+// Name of the kernel set in use: "avx2", "sse2", "neon", or "scalar".
+const char *getAudioKernelsName() noexcept;
+
+}
+
+#endif /* _NAV_AUDIO_CONVERT_HPP_ */
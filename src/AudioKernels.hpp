@@ -0,0 +1,37 @@
+#ifndef _NAV_AUDIO_KERNELS_HPP_
+#define _NAV_AUDIO_KERNELS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace nav
+{
+
+// Block kernels. `src` holds `nchannels` planes of `n` samples each and `dst` receives them interleaved.
+struct AudioKernels
+{
+	const char *name;
+	void (*interleave16)(uint16_t *dst, const uint16_t *const *src, size_t nchannels, size_t n);
+	void (*interleave32)(uint32_t *dst, const uint32_t *const *src, size_t nchannels, size_t n);
+	// dst = round(clamp(src * 32768 + dither, -32768, 32767)), where NaN becomes -32768. `dither` holds `n` values
+	// for each channel. Rounding is to nearest even.
+	void (*floatToS16)(int16_t *dst, const float *const *src, const float *const *dither, size_t nchannels, size_t n);
+};
+
+namespace scalar
+{
+
+void interleave16(uint16_t *dst, const uint16_t *const *src, size_t nchannels, size_t n);
+void interleave32(uint32_t *dst, const uint32_t *const *src, size_t nchannels, size_t n);
+void floatToS16(int16_t *dst, const float *const *src, const float *const *dither, size_t nchannels, size_t n);
+
+}
+
+// These return nullptr if the kernel set isn't compiled for the target architecture.
+const AudioKernels *getSSE2AudioKernels() noexcept;
+const AudioKernels *getAVX2AudioKernels() noexcept;
+const AudioKernels *getNEONAudioKernels() noexcept;
+
+}
+
+#endif /* _NAV_AUDIO_KERNELS_HPP_ */
@@ -0,0 +1,189 @@
+#include "AudioKernels.hpp"
+#include "CPUFeatures.hpp"
+
+#ifdef NAV_CPU_NEON
+
+#include <arm_neon.h>
+
+namespace nav
+{
+
+namespace neon
+{
+
+static void interleave16(uint16_t *dst, const uint16_t *const *src, size_t nchannels, size_t n)
+{
+	size_t i = 0;
+
+	switch (nchannels)
+	{
+		case 2:
+		{
+			for (; i + 8 <= n; i += 8)
+			{
+				uint16x8x2_t v = {{vld1q_u16(src[0] + i), vld1q_u16(src[1] + i)}};
+				vst2q_u16(dst + i * 2, v);
+			}
+
+			break;
+		}
+		case 3:
+		{
+			for (; i + 8 <= n; i += 8)
+			{
+				uint16x8x3_t v = {{vld1q_u16(src[0] + i), vld1q_u16(src[1] + i), vld1q_u16(src[2] + i)}};
+				vst3q_u16(dst + i * 3, v);
+			}
+
+			break;
+		}
+		case 4:
+		{
+			for (; i + 8 <= n; i += 8)
+			{
+				uint16x8x4_t v = {{vld1q_u16(src[0] + i), vld1q_u16(src[1] + i), vld1q_u16(src[2] + i), vld1q_u16(src[3] + i)}};
+				vst4q_u16(dst + i * 4, v);
+			}
+
+			break;
+		}
+		default:
+			scalar::interleave16(dst, src, nchannels, n);
+			return;
+	}
+
+	const uint16_t *rest[4];
+	for (size_t c = 0; c < nchannels; c++)
+		rest[c] = src[c] + i;
+
+	scalar::interleave16(dst + i * nchannels, rest, nchannels, n - i);
+}
+
+static void interleave32(uint32_t *dst, const uint32_t *const *src, size_t nchannels, size_t n)
+{
+	size_t i = 0;
+
+	switch (nchannels)
+	{
+		case 2:
+		{
+			for (; i + 4 <= n; i += 4)
+			{
+				uint32x4x2_t v = {{vld1q_u32(src[0] + i), vld1q_u32(src[1] + i)}};
+				vst2q_u32(dst + i * 2, v);
+			}
+
+			break;
+		}
+		case 3:
+		{
+			for (; i + 4 <= n; i += 4)
+			{
+				uint32x4x3_t v = {{vld1q_u32(src[0] + i), vld1q_u32(src[1] + i), vld1q_u32(src[2] + i)}};
+				vst3q_u32(dst + i * 3, v);
+			}
+
+			break;
+		}
+		case 4:
+		{
+			for (; i + 4 <= n; i += 4)
+			{
+				uint32x4x4_t v = {{vld1q_u32(src[0] + i), vld1q_u32(src[1] + i), vld1q_u32(src[2] + i), vld1q_u32(src[3] + i)}};
+				vst4q_u32(dst + i * 4, v);
+			}
+
+			break;
+		}
+		default:
+			scalar::interleave32(dst, src, nchannels, n);
+			return;
+	}
+
+	const uint32_t *rest[4];
+	for (size_t c = 0; c < nchannels; c++)
+		rest[c] = src[c] + i;
+
+	scalar::interleave32(dst + i * nchannels, rest, nchannels, n - i);
+}
+
+#ifdef __aarch64__
+// 4 samples to 16-bit integers.
+static inline int16x4_t toS16(const float *src, const float *dither)
+{
+	float32x4_t s = vaddq_f32(vmulq_n_f32(vld1q_f32(src), 32768.0f), vld1q_f32(dither));
+	// NaN becomes the lower bound, like the scalar variant.
+	s = vbslq_f32(vceqq_f32(s, s), s, vdupq_n_f32(-32768.0f));
+	s = vminq_f32(vmaxq_f32(s, vdupq_n_f32(-32768.0f)), vdupq_n_f32(32767.0f));
+	return vqmovn_s32(vcvtnq_s32_f32(s));
+}
+
+static void floatToS16(int16_t *dst, const float *const *src, const float *const *dither, size_t nchannels, size_t n)
+{
+	size_t i = 0;
+
+	switch (nchannels)
+	{
+		case 1:
+		{
+			for (; i + 8 <= n; i += 8)
+				vst1q_s16(dst + i, vcombine_s16(toS16(src[0] + i, dither[0] + i), toS16(src[0] + i + 4, dither[0] + i + 4)));
+
+			break;
+		}
+		case 2:
+		{
+			for (; i + 4 <= n; i += 4)
+			{
+				int16x4x2_t v = {{toS16(src[0] + i, dither[0] + i), toS16(src[1] + i, dither[1] + i)}};
+				vst2_s16(dst + i * 2, v);
+			}
+
+			break;
+		}
+		default:
+			scalar::floatToS16(dst, src, dither, nchannels, n);
+			return;
+	}
+
+	const float *rest[2] = {src[0] + i, nchannels == 2 ? src[1] + i : nullptr};
+	const float *restDither[2] = {dither[0] + i, nchannels == 2 ? dither[1] + i : nullptr};
+	scalar::floatToS16(dst + i * nchannels, rest, restDither, nchannels, n - i);
+}
+#else
+// 32-bit ARM has no round-to-nearest conversion.
+static void floatToS16(int16_t *dst, const float *const *src, const float *const *dither, size_t nchannels, size_t n)
+{
+	scalar::floatToS16(dst, src, dither, nchannels, n);
+}
+#endif /* __aarch64__ */
+
+}
+
+static const AudioKernels NEON_KERNELS = {
+	"neon",
+	neon::interleave16,
+	neon::interleave32,
+	neon::floatToS16
+};
+
+const AudioKernels *getNEONAudioKernels() noexcept
+{
+	return &NEON_KERNELS;
+}
+
+}
+
+#else
+
+namespace nav
+{
+
+const AudioKernels *getNEONAudioKernels() noexcept
+{
+	return nullptr;
+}
+
+}
+
+#endif /* NAV_CPU_NEON */
@@ -0,0 +1,256 @@
+#include "AudioKernels.hpp"
+#include "CPUFeatures.hpp"
+
+#ifdef NAV_CPU_X86
+
+#include <immintrin.h>
+
+namespace nav
+{
+
+namespace sse2
+{
+
+NAV_TARGET_SSE2 static void interleave16(uint16_t *dst, const uint16_t *const *src, size_t nchannels, size_t n)
+{
+	if (nchannels != 2)
+	{
+		scalar::interleave16(dst, src, nchannels, n);
+		return;
+	}
+
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8)
+	{
+		__m128i l = _mm_loadu_si128((const __m128i*) (src[0] + i));
+		__m128i r = _mm_loadu_si128((const __m128i*) (src[1] + i));
+		_mm_storeu_si128((__m128i*) (dst + i * 2), _mm_unpacklo_epi16(l, r));
+		_mm_storeu_si128((__m128i*) (dst + i * 2 + 8), _mm_unpackhi_epi16(l, r));
+	}
+
+	const uint16_t *rest[2] = {src[0] + i, src[1] + i};
+	scalar::interleave16(dst + i * 2, rest, 2, n - i);
+}
+
+NAV_TARGET_SSE2 static void interleave32(uint32_t *dst, const uint32_t *const *src, size_t nchannels, size_t n)
+{
+	if (nchannels != 2)
+	{
+		scalar::interleave32(dst, src, nchannels, n);
+		return;
+	}
+
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128i l = _mm_loadu_si128((const __m128i*) (src[0] + i));
+		__m128i r = _mm_loadu_si128((const __m128i*) (src[1] + i));
+		_mm_storeu_si128((__m128i*) (dst + i * 2), _mm_unpacklo_epi32(l, r));
+		_mm_storeu_si128((__m128i*) (dst + i * 2 + 4), _mm_unpackhi_epi32(l, r));
+	}
+
+	const uint32_t *rest[2] = {src[0] + i, src[1] + i};
+	scalar::interleave32(dst + i * 2, rest, 2, n - i);
+}
+
+// 4 samples to 32-bit integers.
+NAV_TARGET_SSE2 static inline __m128i toS32(const float *src, const float *dither)
+{
+	__m128 s = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src), _mm_set1_ps(32768.0f)), _mm_loadu_ps(dither));
+	// maxps returns the second operand for NaN.
+	s = _mm_max_ps(s, _mm_set1_ps(-32768.0f));
+	s = _mm_min_ps(s, _mm_set1_ps(32767.0f));
+	return _mm_cvtps_epi32(s);
+}
+
+NAV_TARGET_SSE2 static void floatToS16(int16_t *dst, const float *const *src, const float *const *dither, size_t nchannels, size_t n)
+{
+	size_t i = 0;
+
+	switch (nchannels)
+	{
+		case 1:
+		{
+			for (; i + 8 <= n; i += 8)
+			{
+				__m128i a = toS32(src[0] + i, dither[0] + i);
+				__m128i b = toS32(src[0] + i + 4, dither[0] + i + 4);
+				_mm_storeu_si128((__m128i*) (dst + i), _mm_packs_epi32(a, b));
+			}
+
+			break;
+		}
+		case 2:
+		{
+			for (; i + 4 <= n; i += 4)
+			{
+				__m128i l = toS32(src[0] + i, dither[0] + i);
+				__m128i r = toS32(src[1] + i, dither[1] + i);
+				_mm_storeu_si128((__m128i*) (dst + i * 2), _mm_packs_epi32(_mm_unpacklo_epi32(l, r), _mm_unpackhi_epi32(l, r)));
+			}
+
+			break;
+		}
+		default:
+			scalar::floatToS16(dst, src, dither, nchannels, n);
+			return;
+	}
+
+	const float *rest[2] = {src[0] + i, nchannels == 2 ? src[1] + i : nullptr};
+	const float *restDither[2] = {dither[0] + i, nchannels == 2 ? dither[1] + i : nullptr};
+	scalar::floatToS16(dst + i * nchannels, rest, restDither, nchannels, n - i);
+}
+
+}
+
+namespace avx2
+{
+
+NAV_TARGET_AVX2 static void interleave16(uint16_t *dst, const uint16_t *const *src, size_t nchannels, size_t n)
+{
+	if (nchannels != 2)
+	{
+		scalar::interleave16(dst, src, nchannels, n);
+		return;
+	}
+
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16)
+	{
+		__m256i l = _mm256_loadu_si256((const __m256i*) (src[0] + i));
+		__m256i r = _mm256_loadu_si256((const __m256i*) (src[1] + i));
+		__m256i lo = _mm256_unpacklo_epi16(l, r);
+		__m256i hi = _mm256_unpackhi_epi16(l, r);
+		// Unpack works per 128-bit lane.
+		_mm256_storeu_si256((__m256i*) (dst + i * 2), _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i*) (dst + i * 2 + 16), _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+
+	const uint16_t *rest[2] = {src[0] + i, src[1] + i};
+	sse2::interleave16(dst + i * 2, rest, 2, n - i);
+}
+
+NAV_TARGET_AVX2 static void interleave32(uint32_t *dst, const uint32_t *const *src, size_t nchannels, size_t n)
+{
+	if (nchannels != 2)
+	{
+		scalar::interleave32(dst, src, nchannels, n);
+		return;
+	}
+
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256i l = _mm256_loadu_si256((const __m256i*) (src[0] + i));
+		__m256i r = _mm256_loadu_si256((const __m256i*) (src[1] + i));
+		__m256i lo = _mm256_unpacklo_epi32(l, r);
+		__m256i hi = _mm256_unpackhi_epi32(l, r);
+		_mm256_storeu_si256((__m256i*) (dst + i * 2), _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i*) (dst + i * 2 + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+
+	const uint32_t *rest[2] = {src[0] + i, src[1] + i};
+	sse2::interleave32(dst + i * 2, rest, 2, n - i);
+}
+
+// 8 samples to 32-bit integers.
+NAV_TARGET_AVX2 static inline __m256i toS32(const float *src, const float *dither)
+{
+	__m256 s = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(src), _mm256_set1_ps(32768.0f)), _mm256_loadu_ps(dither));
+	// maxps returns the second operand for NaN.
+	s = _mm256_max_ps(s, _mm256_set1_ps(-32768.0f));
+	s = _mm256_min_ps(s, _mm256_set1_ps(32767.0f));
+	return _mm256_cvtps_epi32(s);
+}
+
+NAV_TARGET_AVX2 static void floatToS16(int16_t *dst, const float *const *src, const float *const *dither, size_t nchannels, size_t n)
+{
+	size_t i = 0;
+
+	switch (nchannels)
+	{
+		case 1:
+		{
+			for (; i + 16 <= n; i += 16)
+			{
+				__m256i a = toS32(src[0] + i, dither[0] + i);
+				__m256i b = toS32(src[0] + i + 8, dither[0] + i + 8);
+				// Pack works per 128-bit lane.
+				_mm256_storeu_si256((__m256i*) (dst + i), _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8));
+			}
+
+			break;
+		}
+		case 2:
+		{
+			for (; i + 8 <= n; i += 8)
+			{
+				__m256i l = toS32(src[0] + i, dither[0] + i);
+				__m256i r = toS32(src[1] + i, dither[1] + i);
+				// Per-lane unpack and pack cancel each other out.
+				__m256i packed = _mm256_packs_epi32(_mm256_unpacklo_epi32(l, r), _mm256_unpackhi_epi32(l, r));
+				_mm256_storeu_si256((__m256i*) (dst + i * 2), packed);
+			}
+
+			break;
+		}
+		default:
+			scalar::floatToS16(dst, src, dither, nchannels, n);
+			return;
+	}
+
+	const float *rest[2] = {src[0] + i, nchannels == 2 ? src[1] + i : nullptr};
+	const float *restDither[2] = {dither[0] + i, nchannels == 2 ? dither[1] + i : nullptr};
+	sse2::floatToS16(dst + i * nchannels, rest, restDither, nchannels, n - i);
+}
+
+}
+
+static const AudioKernels SSE2_KERNELS = {
+	"sse2",
+	sse2::interleave16,
+	sse2::interleave32,
+	sse2::floatToS16
+};
+
+static const AudioKernels AVX2_KERNELS = {
+	"avx2",
+	avx2::interleave16,
+	avx2::interleave32,
+	avx2::floatToS16
+};
+
+const AudioKernels *getSSE2AudioKernels() noexcept
+{
+	return &SSE2_KERNELS;
+}
+
+const AudioKernels *getAVX2AudioKernels() noexcept
+{
+	return &AVX2_KERNELS;
+}
+
+}
+
+#else
+
+namespace nav
+{
+
+const AudioKernels *getSSE2AudioKernels() noexcept
+{
+	return nullptr;
+}
+
+const AudioKernels *getAVX2AudioKernels() noexcept
+{
+	return nullptr;
+}
+
+}
+
+#endif /* NAV_CPU_X86 */
@@ -6,4 +6,19 @@ namespace nav
 Backend::~Backend()
 {}
 
+nav_t *Backend::openCached(
+	nav_input *input,
+	const char *filename,
+	const nav_settings *settings,
+	[[maybe_unused]] const std::vector<uint8_t> &probeData
+)
+{
+	return open(input, filename, settings);
+}
+
+bool Backend::canOpen([[maybe_unused]] ContainerType container)
+{
+	return true;
+}
+
 }
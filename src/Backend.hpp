@@ -1,13 +1,31 @@
 #ifndef _NAV_BACKEND_H_
 #define _NAV_BACKEND_H_
 
+#include <vector>
+
 #include "Internal.hpp"
+#include "Sniffer.hpp"
 
 #include "nav/nav.h"
 
 namespace nav
 {
 
+class Backend;
+
+// Describes a compiled-in backend, so it can be listed without loading it.
+struct BackendDescriptor
+{
+	const char *name;
+	nav_backendtype type;
+	// Loading it sets up state tied to the loading thread, so it's not loaded ahead of time in another thread.
+	bool threadBound;
+	// Checks the NAV_DISABLE_* environment variables.
+	bool (*isDisabled)();
+	// Returns NULL and sets the error on failure.
+	Backend *(*create)();
+};
+
 class Backend
 {
 public:
@@ -16,6 +34,17 @@ public:
 	virtual nav_backendtype getType() const noexcept = 0;
 	virtual const char *getInfo() = 0;
 	virtual nav_t *open(nav_input *input, const char *filename, const nav_settings *settings) = 0;
+	// `probeData` is what nav_t::getProbeData() of this backend returned for the same input before. Backends can use
+	// it to skip probing. Default implementation ignores it.
+	virtual nav_t *openCached(
+		nav_input *input,
+		const char *filename,
+		const nav_settings *settings,
+		const std::vector<uint8_t> &probeData
+	);
+	// Returns false only if the backend is known to be unable to demux `container`, so opening it can be skipped.
+	// Default implementation returns true.
+	virtual bool canOpen(ContainerType container);
 };
 
 }
@@ -0,0 +1,75 @@
+#include "CPUFeatures.hpp"
+#include "Common.hpp"
+
+#if defined(NAV_CPU_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace nav::cpu
+{
+
+struct Features
+{
+	bool sse2, avx2, neon;
+
+	Features() noexcept
+	: sse2(false)
+	, avx2(false)
+	, neon(false)
+	{
+		if (getEnvvarBool("NAV_DISABLE_SIMD"))
+			return;
+
+#if defined(NAV_CPU_X86)
+#if defined(_MSC_VER)
+		int info[4] = {0};
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+
+		__cpuid(info, 1);
+		sse2 = (info[3] & (1 << 26)) != 0;
+		// AVX needs the OS to save the YMM registers too.
+		bool osxsave = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0;
+
+		if (osxsave && maxLeaf >= 7 && (_xgetbv(0) & 6) == 6)
+		{
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0;
+		}
+#elif defined(__GNUC__)
+		__builtin_cpu_init();
+		sse2 = __builtin_cpu_supports("sse2");
+		avx2 = __builtin_cpu_supports("avx2");
+#endif
+#endif /* NAV_CPU_X86 */
+
+#if defined(NAV_CPU_NEON)
+		// Compiled with NEON enabled means the target always has it.
+		neon = true;
+#endif
+	}
+};
+
+static const Features &getFeatures() noexcept
+{
+	static Features features;
+	return features;
+}
+
+bool hasSSE2() noexcept
+{
+	return getFeatures().sse2;
+}
+
+bool hasAVX2() noexcept
+{
+	return getFeatures().avx2;
+}
+
+bool hasNEON() noexcept
+{
+	return getFeatures().neon;
+}
+
+}
@@ -0,0 +1,31 @@
+#ifndef _NAV_CPU_FEATURES_HPP_
+#define _NAV_CPU_FEATURES_HPP_
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NAV_CPU_X86
+#endif
+
+// Functions using instructions beyond the compiler baseline. MSVC allows them without this.
+#if defined(NAV_CPU_X86) && defined(__GNUC__)
+#define NAV_TARGET_SSE2 __attribute__((target("sse2")))
+#define NAV_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define NAV_TARGET_SSE2
+#define NAV_TARGET_AVX2
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define NAV_CPU_NEON
+#endif
+
+namespace nav::cpu
+{
+
+// These are detected once. Setting NAV_DISABLE_SIMD environment variable makes all of them return false.
+bool hasSSE2() noexcept;
+bool hasAVX2() noexcept;
+bool hasNEON() noexcept;
+
+}
+
+#endif /* _NAV_CPU_FEATURES_HPP_ */
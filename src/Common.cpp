@@ -12,23 +12,120 @@
 namespace nav
 {
 
+AlignedBuffer::AlignedBuffer() noexcept
+: buffer(nullptr)
+, length(0)
+, capacity(0)
+{}
+
+AlignedBuffer::~AlignedBuffer()
+{
+	if (buffer)
+		operator delete[](buffer, std::align_val_t(ALIGNMENT));
+}
+
+void AlignedBuffer::resize(size_t size)
+{
+	if (size > capacity)
+	{
+		uint8_t *newBuffer = (uint8_t*) operator new[](size, std::align_val_t(ALIGNMENT));
+
+		if (buffer)
+			operator delete[](buffer, std::align_val_t(ALIGNMENT));
+
+		buffer = newBuffer;
+		capacity = size;
+	}
+
+	length = size;
+}
+
+uint8_t *AlignedBuffer::data() const noexcept
+{
+	return buffer;
+}
+
+size_t AlignedBuffer::size() const noexcept
+{
+	return length;
+}
+
+FramePool::FramePool(size_t capacity)
+: mutex()
+, frames()
+, capacity(capacity)
+{
+	frames.reserve(capacity);
+}
+
+FramePool::~FramePool()
+{
+	for (nav_frame_t *frame: frames)
+		delete frame;
+}
+
+void FramePool::put(nav_frame_t *frame) noexcept
+{
+	frame->recycle();
+
+	{
+		std::lock_guard lg(mutex);
+
+		if (frames.size() < capacity)
+		{
+			frames.push_back(frame);
+			return;
+		}
+	}
+
+	delete frame;
+}
+
 FrameVector::FrameVector(nav_streaminfo_t *streaminfo, size_t streamindex, double position, const void *data, size_t size)
-: buffer(size)
-, data(planeCount(streaminfo->video.format), nullptr)
-, planeWidths(planeCount(streaminfo->video.format), 0)
+: buffer()
+, data()
+, planeWidths()
 , streaminfo(streaminfo)
 , streamindex(streamindex)
 , position(position)
 {
+	reset(streaminfo, streamindex, position, data, size);
+}
+
+FrameVector::FrameVector(nav_streaminfo_t *streaminfo, size_t streamindex, double position, const FrameTarget &target, size_t size)
+: buffer()
+, data()
+, planeWidths()
+, streaminfo(streaminfo)
+, streamindex(streamindex)
+, position(position)
+{
+	reset(streaminfo, streamindex, position, target, size);
+}
+
+FrameVector::~FrameVector()
+{}
+
+void FrameVector::reset(nav_streaminfo_t *streaminfo, size_t streamindex, double position, const void *data, size_t size)
+{
+	size_t nplanes = streaminfo->type == NAV_STREAMTYPE_AUDIO ? 1 : planeCount(streaminfo->video.format);
+
+	buffer.resize(size);
+	this->data.assign(nplanes, nullptr);
+	planeWidths.assign(nplanes, 0);
+	this->streaminfo = streaminfo;
+	this->streamindex = streamindex;
+	this->position = position;
+
 	if (data)
 		std::copy((const uint8_t*) data, ((const uint8_t*) data) + size, buffer.data());
-	
+
 	// Partition data, assume no padding
 	uint8_t *start = buffer.data();
 
 	if (streaminfo->type == NAV_STREAMTYPE_VIDEO)
 	{
-		for (size_t i = 0; i < planeCount(streaminfo->video.format); i++)
+		for (size_t i = 0; i < nplanes; i++)
 		{
 			this->data[i] = start;
 			planeWidths[i] = streaminfo->plane_width(i);
@@ -42,8 +139,18 @@ FrameVector::FrameVector(nav_streaminfo_t *streaminfo, size_t streamindex, doubl
 	}
 }
 
-FrameVector::~FrameVector()
-{}
+void FrameVector::reset(nav_streaminfo_t *streaminfo, size_t streamindex, double position, const FrameTarget &target, size_t size)
+{
+	data.assign(target.planes, target.planes + target.nplanes);
+	planeWidths.assign(target.strides, target.strides + target.nplanes);
+	this->streaminfo = streaminfo;
+	this->streamindex = streamindex;
+	this->position = position;
+
+	if (streaminfo->type == NAV_STREAMTYPE_AUDIO)
+		planeWidths[0] = (ptrdiff_t) size;
+}
+
 
 size_t FrameVector::getStreamIndex() const noexcept
 {
@@ -69,7 +176,7 @@ const uint8_t *const *FrameVector::acquire(ptrdiff_t **strides, size_t *nplanes)
 	}
 
 	if (nplanes)
-		*nplanes = planeCount(streaminfo->video.format);
+		*nplanes = data.size();
 
 	*strides = planeWidths.data();
 
@@ -82,7 +189,7 @@ void FrameVector::release() noexcept
 
 uint8_t *FrameVector::pointer() noexcept
 {
-	return buffer.data();
+	return data.empty() ? nullptr : data[0];
 }
 
 nav_hwacceltype FrameVector::getHWAccelType() const noexcept
@@ -139,6 +246,8 @@ size_t planeCount(nav_pixelformat fmt) noexcept
 		default:
 			return 0;
 		case NAV_PIXELFORMAT_RGB8:
+		case NAV_PIXELFORMAT_RGBA8:
+		case NAV_PIXELFORMAT_BGRA8:
 			return 1;
 		case NAV_PIXELFORMAT_NV12:
 			return 2;
@@ -148,6 +257,49 @@ size_t planeCount(nav_pixelformat fmt) noexcept
 	}
 }
 
+nav_frame_t *copyFrameToTarget(nav_frame_t *frame, const FrameTarget &target)
+{
+	nav_streaminfo_t *sinfo = (nav_streaminfo_t*) frame->getStreamInfo();
+	ptrdiff_t *strides = nullptr;
+	size_t nplanes = 0;
+	const uint8_t *const *planes = frame->acquire(&strides, &nplanes);
+	if (planes == nullptr)
+	{
+		frame->dispose();
+		throw std::runtime_error(error::get());
+	}
+
+	size_t size = sinfo->type == NAV_STREAMTYPE_AUDIO ? (size_t) strides[0] : 0;
+	if (!target.fits(frame->getStreamIndex(), sinfo, size))
+	{
+		frame->release();
+		return frame;
+	}
+
+	if (sinfo->type == NAV_STREAMTYPE_AUDIO)
+		std::copy(planes[0], planes[0] + size, target.planes[0]);
+	else
+	{
+		for (size_t i = 0; i < nplanes; i++)
+		{
+			size_t width = sinfo->plane_width(i);
+
+			for (size_t y = 0; y < sinfo->plane_height(i); y++)
+			{
+				const uint8_t *src = planes[i] + strides[i] * (ptrdiff_t) y;
+				std::copy(src, src + width, target.planes[i] + target.strides[i] * (ptrdiff_t) y);
+			}
+		}
+	}
+
+	FrameVector *result = frame->pool
+		? frame->pool->make<FrameVector>(sinfo, frame->getStreamIndex(), frame->tell(), target, size)
+		: new FrameVector(sinfo, frame->getStreamIndex(), frame->tell(), target, size);
+	frame->release();
+	frame->dispose();
+	return result;
+}
+
 #ifdef _WIN32
 std::wstring fromUTF8(const std::string &str)
 {
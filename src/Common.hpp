@@ -1,6 +1,7 @@
 #ifndef _NAV_COMMON_H_
 #define _NAV_COMMON_H_
 
+#include <mutex>
 #include <numeric>
 #include <optional>
 #include <string>
@@ -19,10 +20,92 @@ struct AcquireData
 	std::vector<ptrdiff_t> strides;
 };
 
+// 64-byte aligned storage. Contents are left uninitialized and the allocation only grows.
+class AlignedBuffer
+{
+public:
+	static constexpr size_t ALIGNMENT = 64;
+
+	AlignedBuffer() noexcept;
+	AlignedBuffer(const AlignedBuffer &) = delete;
+	~AlignedBuffer();
+	void resize(size_t size);
+	uint8_t *data() const noexcept;
+	size_t size() const noexcept;
+
+private:
+	uint8_t *buffer;
+	size_t length, capacity;
+};
+
+// Per-stream pool of frames given back by nav_frame_free.
+class FramePool: public std::enable_shared_from_this<FramePool>
+{
+public:
+	static constexpr size_t DEFAULT_CAPACITY = 16;
+
+	FramePool(size_t capacity = DEFAULT_CAPACITY);
+	FramePool(const FramePool &) = delete;
+	~FramePool();
+
+	// Reuse an idle frame of type T through its reset() method, or construct a new one.
+	template<typename T, typename... Args>
+	T *make(Args&&... args)
+	{
+		T *frame = take<T>();
+
+		if (frame)
+		{
+			try
+			{
+				frame->reset(std::forward<Args>(args)...);
+			}
+			catch (...)
+			{
+				delete frame;
+				throw;
+			}
+		}
+		else
+			frame = new T(std::forward<Args>(args)...);
+
+		frame->pool = shared_from_this();
+		return frame;
+	}
+
+	void put(nav_frame_t *frame) noexcept;
+
+private:
+	template<typename T>
+	T *take() noexcept
+	{
+		std::lock_guard lg(mutex);
+
+		for (auto it = frames.rbegin(); it != frames.rend(); ++it)
+		{
+			if (T *frame = dynamic_cast<T*>(*it))
+			{
+				frames.erase(std::next(it).base());
+				return frame;
+			}
+		}
+
+		return nullptr;
+	}
+
+	std::mutex mutex;
+	std::vector<nav_frame_t*> frames;
+	size_t capacity;
+};
+
 struct FrameVector: public nav_frame_t
 {
 	FrameVector(nav_streaminfo_t *streaminfo, size_t streamindex, double position, const void *data, size_t size);
+	// Refer to caller-owned memory instead. For audio, `size` is the amount of bytes written.
+	FrameVector(nav_streaminfo_t *streaminfo, size_t streamindex, double position, const FrameTarget &target, size_t size);
 	~FrameVector() override;
+	void reset(nav_streaminfo_t *streaminfo, size_t streamindex, double position, const void *data, size_t size);
+	void reset(nav_streaminfo_t *streaminfo, size_t streamindex, double position, const FrameTarget &target, size_t size);
 	size_t getStreamIndex() const noexcept override;
 	nav_streaminfo_t *getStreamInfo() const noexcept override;
 	double tell() const noexcept override;
@@ -34,7 +117,7 @@ struct FrameVector: public nav_frame_t
 	void *getHWAccelHandle() override;
 
 private:
-	std::vector<uint8_t> buffer;
+	AlignedBuffer buffer;
 	std::vector<uint8_t*> data;
 	std::vector<ptrdiff_t> planeWidths;
 	nav_streaminfo_t *streaminfo;
@@ -64,6 +147,8 @@ bool getEnvvarBool(const std::string &name);
 std::optional<int> getEnvvarInt(const std::string &name);
 bool checkBackendDisabled(const std::string &backendNameUppercase);
 size_t planeCount(nav_pixelformat fmt) noexcept;
+// Copy the frame data to the target then free the frame. Returns the frame as-is if it doesn't fit.
+nav_frame_t *copyFrameToTarget(nav_frame_t *frame, const FrameTarget &target);
 
 #ifdef _WIN32
 std::wstring fromUTF8(const std::string &str);
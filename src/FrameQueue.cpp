@@ -0,0 +1,158 @@
+#include "FrameQueue.hpp"
+#include "Internal.hpp"
+
+namespace nav
+{
+
+FrameQueue::FrameQueue() noexcept
+: streams()
+, nextSequence(0)
+, count(0)
+, maxFrames(DEFAULT_LIMIT)
+, totalBytes(0)
+{}
+
+FrameQueue::~FrameQueue()
+{
+	clear();
+}
+
+void FrameQueue::push(nav_frame_t *frame)
+{
+	// Don't acquire the frame just to get its size, it may need to be downloaded from the GPU.
+	const nav_streaminfo_t *sinfo = frame->getStreamInfo();
+	size_t size = sinfo->type == NAV_STREAMTYPE_VIDEO ? sinfo->video.size() : 0;
+
+	Stream &s = getStream(frame->getStreamIndex());
+	s.frames.push_back({frame, nextSequence++, size});
+	s.bytes += size;
+	totalBytes += size;
+	count++;
+}
+
+nav_frame_t *FrameQueue::pop() noexcept
+{
+	Stream *oldest = nullptr;
+
+	for (Stream &s: streams)
+	{
+		if (!s.frames.empty() && (oldest == nullptr || s.frames.front().sequence < oldest->frames.front().sequence))
+			oldest = &s;
+	}
+
+	if (oldest == nullptr)
+		return nullptr;
+
+	return take(*oldest);
+}
+
+nav_frame_t *FrameQueue::pop(size_t stream) noexcept
+{
+	if (stream >= streams.size() || streams[stream].frames.empty())
+		return nullptr;
+
+	return take(streams[stream]);
+}
+
+size_t FrameQueue::size() const noexcept
+{
+	return count;
+}
+
+size_t FrameQueue::size(size_t stream) const noexcept
+{
+	return stream < streams.size() ? streams[stream].frames.size() : 0;
+}
+
+uint64_t FrameQueue::bytes() const noexcept
+{
+	return totalBytes;
+}
+
+uint64_t FrameQueue::bytes(size_t stream) const noexcept
+{
+	return stream < streams.size() ? streams[stream].bytes : 0;
+}
+
+void FrameQueue::clear() noexcept
+{
+	for (size_t i = 0; i < streams.size(); i++)
+		clear(i);
+}
+
+void FrameQueue::clear(size_t stream) noexcept
+{
+	if (stream >= streams.size())
+		return;
+
+	Stream &s = streams[stream];
+
+	for (const Entry &e: s.frames)
+	{
+		e.frame->release();
+		e.frame->dispose();
+		totalBytes -= e.bytes;
+	}
+
+	count -= s.frames.size();
+	s.frames.clear();
+	s.bytes = 0;
+
+	if (s.partial)
+	{
+		s.partial->release();
+		s.partial->dispose();
+		s.partial = nullptr;
+	}
+}
+
+size_t FrameQueue::limit() const noexcept
+{
+	return maxFrames;
+}
+
+void FrameQueue::setLimit(size_t limit) noexcept
+{
+	maxFrames = limit;
+}
+
+nav_frame_t *FrameQueue::takePartial(size_t stream, size_t &offset) noexcept
+{
+	if (stream >= streams.size())
+		return nullptr;
+
+	Stream &s = streams[stream];
+	nav_frame_t *frame = s.partial;
+	offset = s.partialOffset;
+	s.partial = nullptr;
+	s.partialOffset = 0;
+	return frame;
+}
+
+void FrameQueue::setPartial(size_t stream, nav_frame_t *frame, size_t offset)
+{
+	Stream &s = getStream(stream);
+	s.partial = frame;
+	s.partialOffset = offset;
+}
+
+FrameQueue::Stream &FrameQueue::getStream(size_t stream)
+{
+	if (stream >= streams.size())
+		streams.resize(stream + 1);
+
+	return streams[stream];
+}
+
+nav_frame_t *FrameQueue::take(Stream &s) noexcept
+{
+	Entry &e = s.frames.front();
+	nav_frame_t *frame = e.frame;
+	totalBytes -= e.bytes;
+	s.bytes -= e.bytes;
+	count--;
+	s.frames.pop_front();
+	return frame;
+}
+
+}
@@ -0,0 +1,72 @@
+#ifndef _NAV_FRAME_QUEUE_HPP_
+#define _NAV_FRAME_QUEUE_HPP_
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "nav/types.h"
+
+namespace nav
+{
+
+// Frames decoded ahead of the caller, kept per stream in decode order.
+class FrameQueue
+{
+public:
+	// Amount of frames per stream before the demuxer waits for the stream to be read.
+	static constexpr size_t DEFAULT_LIMIT = 16;
+	// Amount of frames and bytes kept for a stream that nobody reads. Older frames are dropped beyond this.
+	static constexpr size_t UNREAD_FRAMES = 256;
+	static constexpr uint64_t UNREAD_BYTES = 256 * 1024 * 1024;
+
+	FrameQueue() noexcept;
+	FrameQueue(const FrameQueue &) = delete;
+	~FrameQueue();
+
+	void push(nav_frame_t *frame);
+	// Oldest frame across all streams, or NULL if empty.
+	nav_frame_t *pop() noexcept;
+	nav_frame_t *pop(size_t stream) noexcept;
+	size_t size() const noexcept;
+	size_t size(size_t stream) const noexcept;
+	// Approximate memory used by the queued video frames, in bytes.
+	uint64_t bytes() const noexcept;
+	uint64_t bytes(size_t stream) const noexcept;
+	void clear() noexcept;
+	void clear(size_t stream) noexcept;
+	size_t limit() const noexcept;
+	void setLimit(size_t limit) noexcept;
+
+	// Audio frame that's partially consumed by readAudio. `offset` is in bytes.
+	nav_frame_t *takePartial(size_t stream, size_t &offset) noexcept;
+	void setPartial(size_t stream, nav_frame_t *frame, size_t offset);
+
+private:
+	struct Entry
+	{
+		nav_frame_t *frame;
+		uint64_t sequence;
+		size_t bytes;
+	};
+
+	struct Stream
+	{
+		std::deque<Entry> frames;
+		uint64_t bytes = 0;
+		nav_frame_t *partial = nullptr;
+		size_t partialOffset = 0;
+	};
+
+	Stream &getStream(size_t stream);
+	nav_frame_t *take(Stream &s) noexcept;
+
+	std::vector<Stream> streams;
+	uint64_t nextSequence;
+	size_t count, maxFrames;
+	uint64_t totalBytes;
+};
+
+}
+
+#endif /* _NAV_FRAME_QUEUE_HPP_ */
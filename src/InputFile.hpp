@@ -9,6 +9,10 @@ namespace nav::input::file
 {
 
 bool populate(nav_input *input, const std::string &filename);
+// Maps the whole file into memory. The resulting input supports borrow.
+bool populateMapped(nav_input *input, const std::string &filename);
+// Reads ahead in the background through io_uring, or a pread thread if it's not available.
+bool populateAsync(nav_input *input, const std::string &filename);
 
 }
 
@@ -3,9 +3,12 @@
 // This means 32-bit platform < Android N is limited to 2GB file size.
 #ifdef __ANDROID__
 
+#include <cerrno>
 #include <cstdio>
 
 #include <dlfcn.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "InputFile.hpp"
 #include "Common.hpp"
@@ -28,11 +31,19 @@ static void initLFS()
 	}
 }
 
+struct File
+{
+	FILE *f;
+	// Both are tracked here so they don't cost a system call.
+	uint64_t size, position;
+};
+
 static void closefile(void **userdata)
 {
-	FILE **f = (FILE**) userdata;
-	fclose(*f);
-	*f = nullptr;
+	File **file = (File**) userdata;
+	fclose((*file)->f);
+	delete *file;
+	*file = nullptr;
 }
 
 inline int seekimpl(FILE *f, int64_t pos, int origin)
@@ -57,31 +68,79 @@ inline uint64_t tellimpl(FILE *f)
 
 static size_t readfile(void *userdata, void *dest, size_t size)
 {
-	return fread(dest, 1, size, (FILE*) userdata);
+	File *file = (File*) userdata;
+	size_t readed = fread(dest, 1, size, file->f);
+	file->position += readed;
+	return readed;
 }
 
 static nav_bool seekfile(void *userdata, uint64_t pos)
 {
-	return seekimpl((FILE*) userdata, (int64_t) pos, SEEK_SET) == 0;
+	File *file = (File*) userdata;
+
+	if (seekimpl(file->f, (int64_t) pos, SEEK_SET) != 0)
+		return false;
+
+	file->position = pos;
+	return true;
 }
 
 static uint64_t tellfile(void *userdata)
 {
-	return tellimpl((FILE*) userdata);
+	return ((File*) userdata)->position;
 }
 
 static uint64_t sizefile(void *userdata)
 {
-	FILE *f = (FILE*) userdata;
-	uint64_t curpos = tellimpl(f);
+	return ((File*) userdata)->size;
+}
+
+static size_t readatfile(void *userdata, uint64_t offset, void *dest, size_t size)
+{
+	int fd = fileno(((File*) userdata)->f);
+	size_t total = 0;
+
+	while (total < size)
+	{
+		// pread64 takes 64-bit offset on 32-bit platforms too.
+		ssize_t readed = pread64(fd, (uint8_t*) dest + total, size - total, (off64_t) (offset + total));
+
+		if (readed < 0 && errno == EINTR)
+			continue;
+		else if (readed <= 0)
+			break;
+
+		total += (size_t) readed;
+	}
+
+	return total;
+}
+
+static uint64_t querysize(FILE *f)
+{
 	if (seekimpl(f, 0, SEEK_END) != 0)
 		return 0;
-	
+
 	uint64_t size = tellimpl(f);
-	seekimpl(f, curpos, SEEK_SET);
+	seekimpl(f, 0, SEEK_SET);
 	return size;
 }
 
+// See InputFile.cpp
+static void adviseSequential(FILE *f)
+{
+	constexpr size_t BUFFER_SIZE = 65536;
+	constexpr off_t HEAD_SIZE = 1048576;
+
+	setvbuf(f, nullptr, _IOFBF, BUFFER_SIZE);
+
+#if __ANDROID_API__ >= 21
+	int fd = fileno(f);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	posix_fadvise(fd, 0, HEAD_SIZE, POSIX_FADV_WILLNEED);
+#endif
+}
+
 bool populate(nav_input *input, const std::string &filename)
 {
 	initLFS();
@@ -93,13 +152,23 @@ bool populate(nav_input *input, const std::string &filename)
 		return false;
 	}
 
+	adviseSequential(f);
+
+	File *file = new File();
+	file->f = f;
+	file->size = querysize(f);
+	file->position = 0;
+
 	nav::error::set("");
-	input->userdata = f;
+	input->userdata = file;
 	input->close = closefile;
 	input->read = readfile;
 	input->seek = seekfile;
 	input->tell = tellfile;
 	input->size = sizefile;
+	input->version = NAV_INPUT_VERSION;
+	input->borrow = nullptr;
+	input->read_at = readatfile;
 	return true;
 }
 
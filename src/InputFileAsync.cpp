@@ -0,0 +1,566 @@
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#ifdef __NR_io_uring_setup
+#define NAV_HAS_IO_URING
+#endif
+#endif
+
+#include "InputFile.hpp"
+#include "Common.hpp"
+#include "Error.hpp"
+
+namespace nav::input::file
+{
+
+#ifndef _WIN32
+
+namespace async
+{
+
+constexpr size_t CHUNK_SIZE = 262144;
+constexpr size_t QUEUE_DEPTH = 4;
+
+struct Block
+{
+	std::vector<uint8_t> data;
+	iovec iov;
+	uint64_t offset;
+	// Bytes read, or negative errno. Only valid when not in flight.
+	ssize_t result;
+	bool inflight;
+};
+
+class Engine
+{
+public:
+	virtual ~Engine() {}
+	// Starts reading the whole block at its offset.
+	virtual void submit(Block &block) = 0;
+	// Waits until the block is no longer in flight.
+	virtual void wait(Block &block) = 0;
+};
+
+static ssize_t readBlock(int fd, Block &block)
+{
+	size_t total = 0;
+
+	while (total < CHUNK_SIZE)
+	{
+		ssize_t readed = pread(fd, block.data.data() + total, CHUNK_SIZE - total, (off_t) (block.offset + total));
+
+		if (readed < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			return total > 0 ? (ssize_t) total : -errno;
+		}
+		else if (readed == 0)
+			break;
+
+		total += (size_t) readed;
+	}
+
+	return (ssize_t) total;
+}
+
+// Fallback engine. A thread per file reads the blocks with pread in submission order.
+class ThreadEngine: public Engine
+{
+public:
+	ThreadEngine(int fd)
+	: fd(fd)
+	, mutex()
+	, cond()
+	, queue()
+	, stopping(false)
+	, thread(&ThreadEngine::worker, this)
+	{}
+
+	~ThreadEngine() override
+	{
+		{
+			std::lock_guard lg(mutex);
+			stopping = true;
+		}
+
+		cond.notify_all();
+		thread.join();
+	}
+
+	void submit(Block &block) override
+	{
+		{
+			std::lock_guard lg(mutex);
+			queue.push_back(&block);
+		}
+
+		cond.notify_all();
+	}
+
+	void wait(Block &block) override
+	{
+		std::unique_lock lock(mutex);
+		cond.wait(lock, [&block]() { return !block.inflight; });
+	}
+
+private:
+	void worker()
+	{
+		std::unique_lock lock(mutex);
+
+		while (true)
+		{
+			cond.wait(lock, [this]() { return stopping || !queue.empty(); });
+
+			if (stopping)
+				return;
+
+			Block *block = queue.front();
+			queue.pop_front();
+
+			lock.unlock();
+			ssize_t result = readBlock(fd, *block);
+			lock.lock();
+
+			block->result = result;
+			block->inflight = false;
+			cond.notify_all();
+		}
+	}
+
+	int fd;
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::deque<Block*> queue;
+	bool stopping;
+	std::thread thread;
+};
+
+#ifdef NAV_HAS_IO_URING
+// Talks to the kernel directly so there's no liburing dependency.
+class UringEngine: public Engine
+{
+public:
+	UringEngine(int fd)
+	: fd(fd)
+	, ringfd(-1)
+	, params()
+	, sqRing(MAP_FAILED)
+	, cqRing(MAP_FAILED)
+	, sqes((io_uring_sqe*) MAP_FAILED)
+	, sqRingSize(0)
+	, cqRingSize(0)
+	, inflight(0)
+	{
+		ringfd = (int) syscall(__NR_io_uring_setup, (unsigned) QUEUE_DEPTH, &params);
+		if (ringfd < 0)
+			throw std::runtime_error("io_uring is not available");
+
+		sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+		if (params.features & IORING_FEAT_SINGLE_MMAP)
+			sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+		sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQ_RING);
+		if (sqRing == MAP_FAILED)
+		{
+			cleanup();
+			throw std::runtime_error("Cannot map io_uring submission queue");
+		}
+
+		if (params.features & IORING_FEAT_SINGLE_MMAP)
+			cqRing = sqRing;
+		else
+		{
+			cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_CQ_RING);
+			if (cqRing == MAP_FAILED)
+			{
+				cleanup();
+				throw std::runtime_error("Cannot map io_uring completion queue");
+			}
+		}
+
+		sqes = (io_uring_sqe*) mmap(
+			nullptr,
+			params.sq_entries * sizeof(io_uring_sqe),
+			PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE,
+			ringfd,
+			IORING_OFF_SQES
+		);
+		if (sqes == MAP_FAILED)
+		{
+			cleanup();
+			throw std::runtime_error("Cannot map io_uring submission entries");
+		}
+
+		uint8_t *sq = (uint8_t*) sqRing;
+		sqHead = (unsigned*) (sq + params.sq_off.head);
+		sqTail = (unsigned*) (sq + params.sq_off.tail);
+		sqMask = (unsigned*) (sq + params.sq_off.ring_mask);
+		sqArray = (unsigned*) (sq + params.sq_off.array);
+
+		uint8_t *cq = (uint8_t*) cqRing;
+		cqHead = (unsigned*) (cq + params.cq_off.head);
+		cqTail = (unsigned*) (cq + params.cq_off.tail);
+		cqMask = (unsigned*) (cq + params.cq_off.ring_mask);
+		cqes = (io_uring_cqe*) (cq + params.cq_off.cqes);
+	}
+
+	~UringEngine() override
+	{
+		// The kernel may still write to the blocks.
+		while (inflight > 0)
+		{
+			reap();
+
+			if (inflight > 0 && !enter(IORING_ENTER_GETEVENTS))
+				break;
+		}
+
+		cleanup();
+	}
+
+	void submit(Block &block) override
+	{
+		// Only this thread produces, and there are never more than QUEUE_DEPTH blocks in flight.
+		unsigned tail = *sqTail;
+		unsigned index = tail & *sqMask;
+
+		io_uring_sqe &sqe = sqes[index];
+		memset(&sqe, 0, sizeof(io_uring_sqe));
+		sqe.opcode = IORING_OP_READV;
+		sqe.fd = fd;
+		sqe.addr = (uint64_t) (uintptr_t) &block.iov;
+		sqe.len = 1;
+		sqe.off = block.offset;
+		sqe.user_data = (uint64_t) (uintptr_t) &block;
+
+		sqArray[index] = index;
+		__atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+		inflight++;
+
+		enter(0);
+	}
+
+	void wait(Block &block) override
+	{
+		while (block.inflight)
+		{
+			reap();
+
+			if (block.inflight && !enter(IORING_ENTER_GETEVENTS))
+			{
+				// Shouldn't happen. Read the block here instead.
+				block.result = readBlock(fd, block);
+				block.inflight = false;
+			}
+		}
+	}
+
+private:
+	// Submits pending entries, optionally waiting for a completion.
+	bool enter(unsigned flags)
+	{
+		while (true)
+		{
+			unsigned toSubmit = *sqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+			unsigned minComplete = (flags & IORING_ENTER_GETEVENTS) ? 1 : 0;
+
+			if (syscall(__NR_io_uring_enter, ringfd, toSubmit, minComplete, flags, nullptr, 0) >= 0)
+				return true;
+
+			if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+				return false;
+		}
+	}
+
+	void reap()
+	{
+		unsigned head = *cqHead;
+		unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+
+		for (; head != tail; head++)
+		{
+			const io_uring_cqe &cqe = cqes[head & *cqMask];
+			Block *block = (Block*) (uintptr_t) cqe.user_data;
+			block->result = cqe.res;
+			block->inflight = false;
+			inflight--;
+		}
+
+		__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+	}
+
+	void cleanup()
+	{
+		if (sqes != MAP_FAILED)
+			munmap(sqes, params.sq_entries * sizeof(io_uring_sqe));
+		if (cqRing != MAP_FAILED && cqRing != sqRing)
+			munmap(cqRing, cqRingSize);
+		if (sqRing != MAP_FAILED)
+			munmap(sqRing, sqRingSize);
+		if (ringfd >= 0)
+			::close(ringfd);
+	}
+
+	int fd, ringfd;
+	io_uring_params params;
+	void *sqRing, *cqRing;
+	io_uring_sqe *sqes;
+	size_t sqRingSize, cqRingSize;
+	unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+	unsigned *cqHead, *cqTail, *cqMask;
+	io_uring_cqe *cqes;
+	size_t inflight;
+};
+#endif /* NAV_HAS_IO_URING */
+
+// Keeps QUEUE_DEPTH consecutive blocks in flight ahead of the read position.
+class File
+{
+public:
+	File(int fd, uint64_t size)
+	: fd(fd)
+	, size(size)
+	, position(0)
+	, engine()
+	, blocks()
+	, head(0)
+	, started(false)
+	{
+#ifdef NAV_HAS_IO_URING
+		if (!getEnvvarBool("NAV_DISABLE_IO_URING"))
+		{
+			try
+			{
+				engine = std::make_unique<UringEngine>(fd);
+			}
+			catch (const std::exception &)
+			{
+				// Kernel too old, or io_uring is blocked.
+			}
+		}
+#endif
+
+		if (!engine)
+			engine = std::make_unique<ThreadEngine>(fd);
+
+		for (Block &block: blocks)
+		{
+			block.data.resize(CHUNK_SIZE);
+			block.iov.iov_base = block.data.data();
+			block.iov.iov_len = CHUNK_SIZE;
+			block.offset = 0;
+			block.result = 0;
+			block.inflight = false;
+		}
+
+		// Probing starts at the beginning.
+		restart(0);
+	}
+
+	~File()
+	{
+		for (Block &block: blocks)
+			engine->wait(block);
+
+		engine.reset();
+		::close(fd);
+	}
+
+	size_t read(void *dest, size_t amount)
+	{
+		uint8_t *out = (uint8_t*) dest;
+		size_t total = 0;
+
+		while (total < amount && position < size)
+		{
+			if (!started || position < blocks[head].offset || position >= blocks[head].offset + QUEUE_DEPTH * CHUNK_SIZE)
+				restart(position);
+
+			// Blocks behind the position are reused to read further ahead.
+			while (position >= blocks[head].offset + CHUNK_SIZE)
+			{
+				engine->wait(blocks[head]);
+				submit(blocks[head], blocks[head].offset + QUEUE_DEPTH * CHUNK_SIZE);
+				head = (head + 1) % QUEUE_DEPTH;
+			}
+
+			Block &block = blocks[head];
+			engine->wait(block);
+
+			size_t valid = block.result > 0 ? (size_t) block.result : 0;
+			size_t offset = (size_t) (position - block.offset);
+
+			if (offset >= valid)
+			{
+				// Read error.
+				if (valid == 0)
+					break;
+
+				// Short read. Continue from here.
+				started = false;
+				continue;
+			}
+
+			size_t count = std::min(amount - total, valid - offset);
+			std::copy(block.data.data() + offset, block.data.data() + offset + count, out + total);
+			total += count;
+			position += count;
+		}
+
+		return total;
+	}
+
+	int fd;
+	uint64_t size, position;
+
+private:
+	void submit(Block &block, uint64_t offset)
+	{
+		block.offset = offset;
+
+		if (offset >= size)
+		{
+			block.result = 0;
+			block.inflight = false;
+		}
+		else
+		{
+			block.inflight = true;
+			engine->submit(block);
+		}
+	}
+
+	void restart(uint64_t pos)
+	{
+		for (Block &block: blocks)
+			engine->wait(block);
+
+		head = 0;
+
+		for (size_t i = 0; i < QUEUE_DEPTH; i++)
+			submit(blocks[i], pos + i * CHUNK_SIZE);
+
+		started = true;
+	}
+
+	std::unique_ptr<Engine> engine;
+	Block blocks[QUEUE_DEPTH];
+	size_t head;
+	bool started;
+};
+
+static void close(void **userdata)
+{
+	File **file = (File**) userdata;
+	delete *file;
+	*file = nullptr;
+}
+
+static size_t read(void *userdata, void *dest, size_t size)
+{
+	return ((File*) userdata)->read(dest, size);
+}
+
+static nav_bool seek(void *userdata, uint64_t pos)
+{
+	((File*) userdata)->position = pos;
+	return true;
+}
+
+static uint64_t tell(void *userdata)
+{
+	return ((File*) userdata)->position;
+}
+
+static uint64_t fsize(void *userdata)
+{
+	return ((File*) userdata)->size;
+}
+
+}
+
+bool populateAsync(nav_input *input, const std::string &filename)
+{
+	int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+	{
+		nav::error::set("Cannot open file");
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+		::close(fd);
+		nav::error::set("Cannot query file size");
+		return false;
+	}
+
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	async::File *file = nullptr;
+
+	try
+	{
+		// Takes the descriptor.
+		file = new async::File(fd, (uint64_t) st.st_size);
+	}
+	catch (const std::exception &e)
+	{
+		::close(fd);
+		nav::error::set(e);
+		return false;
+	}
+
+	nav::error::set("");
+	input->userdata = file;
+	input->close = async::close;
+	input->read = async::read;
+	input->seek = async::seek;
+	input->tell = async::tell;
+	input->size = async::fsize;
+	input->version = NAV_INPUT_VERSION;
+	input->borrow = nullptr;
+	// Positional reads would skip the chunks read ahead.
+	input->read_at = nullptr;
+	return true;
+}
+
+#else
+
+bool populateAsync(nav_input *input, const std::string &filename)
+{
+	// No asynchronous engine for Windows yet.
+	return populate(input, filename);
+}
+
+#endif /* _WIN32 */
+
+}
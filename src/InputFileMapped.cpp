@@ -0,0 +1,152 @@
+#include <limits>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "InputFile.hpp"
+#include "InputMemory.hpp"
+#include "Common.hpp"
+#include "Error.hpp"
+
+namespace nav::input::file
+{
+
+static void closemapped(void **userdata)
+{
+	nav::input::memory::Memory **mem = (nav::input::memory::Memory**) userdata;
+
+	if ((*mem)->data)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile((*mem)->data);
+#else
+		munmap((*mem)->data, (*mem)->size);
+#endif
+	}
+
+	delete *mem;
+	*mem = nullptr;
+}
+
+#ifdef _WIN32
+static bool mapfile(const std::string &filename, void **data, size_t *size)
+{
+	std::wstring wide;
+
+	try
+	{
+		wide = nav::fromUTF8(filename);
+	}
+	catch (const std::exception &e)
+	{
+		nav::error::set(e);
+		return false;
+	}
+
+	HANDLE file = CreateFileW(wide.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		nav::error::set("Cannot open file");
+		return false;
+	}
+
+	LARGE_INTEGER filesize;
+	if (!GetFileSizeEx(file, &filesize) || uint64_t(filesize.QuadPart) > std::numeric_limits<size_t>::max())
+	{
+		CloseHandle(file);
+		nav::error::set("File is too large to map");
+		return false;
+	}
+
+	*data = nullptr;
+	*size = (size_t) filesize.QuadPart;
+
+	// Zero-sized files can't be mapped.
+	if (*size > 0)
+	{
+		HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+		if (mapping)
+		{
+			*data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			// The view keeps the mapping alive.
+			CloseHandle(mapping);
+		}
+
+		if (*data == nullptr)
+		{
+			CloseHandle(file);
+			nav::error::set("Cannot map file");
+			return false;
+		}
+	}
+
+	CloseHandle(file);
+	return true;
+}
+#else
+static bool mapfile(const std::string &filename, void **data, size_t *size)
+{
+	int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+	{
+		nav::error::set("Cannot open file");
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || uint64_t(st.st_size) > std::numeric_limits<size_t>::max())
+	{
+		::close(fd);
+		nav::error::set("File is too large to map");
+		return false;
+	}
+
+	*data = nullptr;
+	*size = (size_t) st.st_size;
+
+	// Zero-sized files can't be mapped.
+	if (*size > 0)
+	{
+		void *ptr = mmap(nullptr, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (ptr == MAP_FAILED)
+		{
+			::close(fd);
+			nav::error::set("Cannot map file");
+			return false;
+		}
+
+#ifdef POSIX_MADV_SEQUENTIAL
+		posix_madvise(ptr, *size, POSIX_MADV_SEQUENTIAL);
+#endif
+		*data = ptr;
+	}
+
+	// The mapping stays valid after the descriptor is closed.
+	::close(fd);
+	return true;
+}
+#endif /* _WIN32 */
+
+bool populateMapped(nav_input *input, const std::string &filename)
+{
+	void *data = nullptr;
+	size_t size = 0;
+
+	if (!mapfile(filename, &data, &size))
+		return false;
+
+	nav::error::set("");
+	nav::input::memory::populate(input, data, size, closemapped);
+	return true;
+}
+
+}
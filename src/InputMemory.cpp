@@ -12,29 +12,36 @@ static void close(void **userdata)
 	*mem = nullptr;
 }
 
-static size_t read(void *userdata, void *dest, size_t size)
+static size_t borrow(void *userdata, uint64_t offset, size_t size, const void **ptr)
 {
 	Memory *mem = (Memory*) userdata;
-	size_t nextpos = mem->pos + size;
-	size_t readed;
-
-	if (nextpos >= mem->size)
-	{
-		readed = size - (mem->size - nextpos);
-		nextpos = mem->size;
-	}
-	else
-		readed = size;
+
+	if (offset >= mem->size)
+		return 0;
+
+	*ptr = mem->data + offset;
+	return std::min<size_t>(size, mem->size - (size_t) offset);
+}
+
+static size_t readAt(void *userdata, uint64_t offset, void *dest, size_t size)
+{
+	const void *src = nullptr;
+	size_t readed = borrow(userdata, offset, size, &src);
 
 	if (readed > 0)
-	{
-		std::copy(mem->data + mem->pos, mem->data + mem->pos + readed, (uint8_t*) dest);
-		mem->pos = nextpos;
-	}
+		std::copy((const uint8_t*) src, (const uint8_t*) src + readed, (uint8_t*) dest);
 
 	return readed;
 }
 
+static size_t read(void *userdata, void *dest, size_t size)
+{
+	Memory *mem = (Memory*) userdata;
+	size_t readed = readAt(userdata, mem->pos, dest, size);
+	mem->pos += readed;
+	return readed;
+}
+
 static nav_bool seek(void *userdata, uint64_t pos)
 {
 	Memory *mem = (Memory*) userdata;
@@ -59,7 +66,7 @@ static uint64_t fsize(void *userdata)
 	return (uint64_t) mem->size;
 }
 
-void populate(nav_input *input, void *buf, size_t size)
+void populate(nav_input *input, void *buf, size_t size, void (*closefunc)(void **userdata))
 {
 	Memory *mem = new Memory();
 	mem->data = (uint8_t*) buf;
@@ -67,11 +74,14 @@ void populate(nav_input *input, void *buf, size_t size)
 	mem->size = size;
 
 	input->userdata = mem;
-	input->close = close;
+	input->close = closefunc ? closefunc : close;
 	input->read = read;
 	input->seek = seek;
 	input->tell = tell;
 	input->size = fsize;
+	input->version = NAV_INPUT_VERSION;
+	input->borrow = borrow;
+	input->read_at = readAt;
 }
 
 }
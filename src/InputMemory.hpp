@@ -12,7 +12,9 @@ struct Memory
 	size_t size, pos;
 };
 
-void populate(nav_input *input, void *buf, size_t size);
+// closefunc replaces the default close function, which only deletes the Memory struct. It must delete the Memory
+// struct too.
+void populate(nav_input *input, void *buf, size_t size, void (*closefunc)(void **userdata) = nullptr);
 
 }
 
@@ -0,0 +1,206 @@
+#include <algorithm>
+
+#include "InputReadAhead.hpp"
+
+namespace nav::input
+{
+
+ReadAhead::ReadAhead(const nav_input &source, size_t window)
+: source(source)
+, wrapper()
+, sourceSize(this->source.sizef())
+, window(std::max<size_t>(window, 1))
+, position(this->source.tellf())
+, current()
+, currentPos(0)
+, currentSize(0)
+, mutex()
+, cond()
+, thread()
+, next()
+, nextPos(0)
+, nextSize(0)
+, pending(false)
+, stopping(false)
+{
+	wrapper.userdata = this;
+	wrapper.close = close;
+	wrapper.read = read;
+	wrapper.seek = seek;
+	wrapper.tell = tell;
+	wrapper.size = size;
+	wrapper.version = NAV_INPUT_VERSION;
+	wrapper.borrow = nullptr;
+	// Positional reads would skip the windows.
+	wrapper.read_at = nullptr;
+}
+
+ReadAhead::~ReadAhead()
+{
+	stop();
+}
+
+nav_input *ReadAhead::getInput() noexcept
+{
+	return &wrapper;
+}
+
+nav_input ReadAhead::release()
+{
+	stop();
+	source.seekf(position);
+	return source;
+}
+
+void ReadAhead::close(void **userdata)
+{
+	ReadAhead *self = (ReadAhead*) *userdata;
+	nav_input source = self->source;
+
+	// userdata may point inside the object.
+	*userdata = nullptr;
+	delete self;
+	source.closef();
+}
+
+size_t ReadAhead::read(void *userdata, void *dest, size_t size)
+{
+	ReadAhead *self = (ReadAhead*) userdata;
+	uint8_t *out = (uint8_t*) dest;
+	size_t total = 0;
+
+	while (total < size)
+	{
+		if (self->position < self->currentPos || self->position >= self->currentPos + self->currentSize)
+		{
+			if (!self->fill())
+				break;
+		}
+
+		size_t offset = (size_t) (self->position - self->currentPos);
+		size_t amount = std::min(size - total, self->currentSize - offset);
+		std::copy(self->current.data() + offset, self->current.data() + offset + amount, out + total);
+		total += amount;
+		self->position += amount;
+	}
+
+	return total;
+}
+
+nav_bool ReadAhead::seek(void *userdata, uint64_t pos)
+{
+	ReadAhead *self = (ReadAhead*) userdata;
+
+	// The source is only seeked on the next window fill.
+	if (pos > self->sourceSize)
+		return false;
+
+	self->position = pos;
+	return true;
+}
+
+uint64_t ReadAhead::tell(void *userdata)
+{
+	return ((ReadAhead*) userdata)->position;
+}
+
+uint64_t ReadAhead::size(void *userdata)
+{
+	return ((ReadAhead*) userdata)->sourceSize;
+}
+
+void ReadAhead::stop()
+{
+	{
+		std::lock_guard lg(mutex);
+		stopping = true;
+	}
+
+	cond.notify_all();
+
+	if (thread.joinable())
+		thread.join();
+}
+
+bool ReadAhead::fill()
+{
+	std::unique_lock lock(mutex);
+	cond.wait(lock, [this]() { return !pending; });
+
+	if (nextSize > 0 && position >= nextPos && position < nextPos + nextSize)
+	{
+		std::swap(current, next);
+		currentPos = nextPos;
+		currentSize = nextSize;
+	}
+	else
+	{
+		// Random access. Read the window now.
+		currentPos = position;
+		currentSize = readSource(current, position);
+	}
+
+	nextSize = 0;
+
+	if (currentSize == 0)
+		return false;
+
+	// A short window means the end of the stream is reached.
+	if (currentSize == window)
+	{
+		if (!thread.joinable())
+			thread = std::thread(&ReadAhead::worker, this);
+
+		nextPos = currentPos + currentSize;
+		pending = true;
+		lock.unlock();
+		cond.notify_all();
+	}
+
+	return true;
+}
+
+size_t ReadAhead::readSource(std::vector<uint8_t> &dest, uint64_t pos)
+{
+	dest.resize(window);
+
+	if (!source.seekf(pos))
+		return 0;
+
+	size_t total = 0;
+
+	while (total < window)
+	{
+		size_t readed = source.readf(dest.data() + total, window - total);
+		if (readed == 0)
+			break;
+
+		total += readed;
+	}
+
+	return total;
+}
+
+void ReadAhead::worker()
+{
+	std::unique_lock lock(mutex);
+
+	while (true)
+	{
+		cond.wait(lock, [this]() { return stopping || pending; });
+
+		if (stopping)
+			return;
+
+		uint64_t pos = nextPos;
+		lock.unlock();
+		size_t readed = readSource(next, pos);
+		lock.lock();
+
+		nextSize = readed;
+		pending = false;
+		cond.notify_all();
+	}
+}
+
+}
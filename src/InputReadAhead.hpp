@@ -0,0 +1,62 @@
+#ifndef _NAV_INPUT_READ_AHEAD_HPP_
+#define _NAV_INPUT_READ_AHEAD_HPP_
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "nav/input.h"
+
+namespace nav::input
+{
+
+// Wraps another input, reading it in windows of fixed size. While the caller consumes one window, the next one is read
+// in a background thread. Closing the wrapper input closes the source input and deletes this object.
+class ReadAhead
+{
+public:
+	ReadAhead(const nav_input &source, size_t window);
+	ReadAhead(const ReadAhead &) = delete;
+	// Doesn't close the source input.
+	~ReadAhead();
+	nav_input *getInput() noexcept;
+	// Gives back the source input, positioned where the wrapper input was. The wrapper input can't be used afterwards.
+	nav_input release();
+
+private:
+	static void close(void **userdata);
+	static size_t read(void *userdata, void *dest, size_t size);
+	static nav_bool seek(void *userdata, uint64_t pos);
+	static uint64_t tell(void *userdata);
+	static uint64_t size(void *userdata);
+
+	void stop();
+	bool fill();
+	size_t readSource(std::vector<uint8_t> &dest, uint64_t pos);
+	void worker();
+
+	nav_input source, wrapper;
+	uint64_t sourceSize;
+	size_t window;
+	uint64_t position;
+
+	// Window the caller reads from. Only touched by the caller thread.
+	std::vector<uint8_t> current;
+	uint64_t currentPos;
+	size_t currentSize;
+
+	// Window read by the worker. The source is only accessed by the worker while `pending` is set.
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::thread thread;
+	std::vector<uint8_t> next;
+	uint64_t nextPos;
+	size_t nextSize;
+	bool pending;
+	bool stopping;
+};
+
+}
+
+#endif /* _NAV_INPUT_READ_AHEAD_HPP_ */
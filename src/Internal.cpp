@@ -1,8 +1,798 @@
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+
 #include "Internal.hpp"
+#include "Common.hpp"
+#include "Error.hpp"
+
+namespace nav
+{
+
+bool FrameTarget::fits(size_t index, const nav_streaminfo_t *sinfo, size_t size) const noexcept
+{
+	if (planes == nullptr || strides == nullptr || (stream != ANY_STREAM && stream != index))
+		return false;
+
+	switch (sinfo->type)
+	{
+		case NAV_STREAMTYPE_AUDIO:
+			return nplanes == 1 && planes[0] != nullptr && strides[0] >= 0 && size_t(strides[0]) >= size;
+		case NAV_STREAMTYPE_VIDEO:
+		{
+			if (nplanes != planeCount(sinfo->video.format))
+				return false;
+
+			for (size_t i = 0; i < nplanes; i++)
+			{
+				if (planes[i] == nullptr || size_t(std::abs(strides[i])) < sinfo->plane_width(i))
+					return false;
+			}
+
+			return true;
+		}
+		default:
+			return false;
+	}
+}
+
+}
 
 nav_t::~nav_t()
 {}
 
+nav_frame_t *nav_t::readInto(const nav::FrameTarget &target)
+{
+	nav_frame_t *frame = read();
+	if (frame == nullptr)
+		return nullptr;
+
+	return nav::copyFrameToTarget(frame, target);
+}
+
+bool nav_t::readBatch(nav_frame_t **out, size_t max, size_t *count)
+{
+	*count = 0;
+
+	if (max > 0 && (out[0] = read()) != nullptr)
+		*count = 1;
+
+	return true;
+}
+
+bool nav_t::setPixelFormat(size_t index, nav_pixelformat format)
+{
+	const nav_streaminfo_t *sinfo = getStreamInfo(index);
+	if (sinfo == nullptr)
+		return false;
+
+	if (sinfo->type != NAV_STREAMTYPE_VIDEO)
+	{
+		nav::error::set("Not a video stream");
+		return false;
+	}
+
+	if (sinfo->video.format != format)
+	{
+		nav::error::set("Pixel format conversion is not supported by this backend");
+		return false;
+	}
+
+	return true;
+}
+
+bool nav_t::setVideoSize(size_t index, uint32_t width, uint32_t height, [[maybe_unused]] nav_scaler scaler)
+{
+	const nav_streaminfo_t *sinfo = getStreamInfo(index);
+	if (sinfo == nullptr)
+		return false;
+
+	if (sinfo->type != NAV_STREAMTYPE_VIDEO)
+	{
+		nav::error::set("Not a video stream");
+		return false;
+	}
+
+	if ((width != 0 && width != sinfo->video.width) || (height != 0 && height != sinfo->video.height))
+	{
+		nav::error::set("Scaling is not supported by this backend");
+		return false;
+	}
+
+	return true;
+}
+
+bool nav_t::setKeyframesOnly(size_t index, bool keyframesOnly)
+{
+	const nav_streaminfo_t *sinfo = getStreamInfo(index);
+	if (sinfo == nullptr)
+		return false;
+
+	if (sinfo->type != NAV_STREAMTYPE_VIDEO)
+	{
+		nav::error::set("Not a video stream");
+		return false;
+	}
+
+	if (keyframesOnly)
+	{
+		nav::error::set("Keyframe-only decoding is not supported by this backend");
+		return false;
+	}
+
+	return true;
+}
+
+bool nav_t::setAudioFormat(size_t index, nav_audioformat format)
+{
+	const nav_streaminfo_t *sinfo = getStreamInfo(index);
+	if (sinfo == nullptr)
+		return false;
+
+	if (sinfo->type != NAV_STREAMTYPE_AUDIO)
+	{
+		nav::error::set("Not an audio stream");
+		return false;
+	}
+
+	if (sinfo->audio.format != format)
+	{
+		nav::error::set("Audio format conversion is not supported by this backend");
+		return false;
+	}
+
+	return true;
+}
+
+uint32_t nav_t::getDecoderDelay([[maybe_unused]] size_t index) const noexcept
+{
+	return 0;
+}
+
+std::vector<uint8_t> nav_t::getProbeData()
+{
+	return std::vector<uint8_t>();
+}
+
+bool nav_t::setInput([[maybe_unused]] nav_input *input, [[maybe_unused]] const char *filename)
+{
+	return false;
+}
+
+double nav_t::setPositionAccurate([[maybe_unused]] double off)
+{
+	throw std::runtime_error("Accurate seeking is not supported by this backend");
+}
+
+// Exclusive right to call into the backend decoding functions. `lock` must be held when constructing.
+struct nav_t::DemuxGuard
+{
+	DemuxGuard(nav_t *state, std::unique_lock<std::mutex> &lock)
+	: state(state)
+	, lock(lock)
+	{
+		state->queueCond.wait(lock, [state]() {return !state->demuxing;});
+		state->demuxing = true;
+	}
+
+	~DemuxGuard()
+	{
+		if (!lock.owns_lock())
+			lock.lock();
+
+		state->demuxing = false;
+		state->queueCond.notify_all();
+	}
+
+	nav_t *state;
+	std::unique_lock<std::mutex> &lock;
+};
+
+nav_frame_t *nav_t::next()
+{
+	std::unique_lock lock(queueMutex);
+	if (prefetchThread.joinable())
+		return waitPrefetched(lock, nav::FrameTarget::ANY_STREAM);
+
+	DemuxGuard guard(this, lock);
+
+	if (nav_frame_t *frame = readAhead.pop())
+		return frame;
+
+	lock.unlock();
+	nav_frame_t *frame = read();
+	lock.lock();
+
+	eos = frame == nullptr;
+	return frame;
+}
+
+nav_frame_t *nav_t::nextInto(const nav::FrameTarget &target)
+{
+	std::unique_lock lock(queueMutex);
+	if (prefetchThread.joinable())
+	{
+		nav_frame_t *frame = waitPrefetched(lock, nav::FrameTarget::ANY_STREAM);
+		lock.unlock();
+		return frame ? nav::copyFrameToTarget(frame, target) : nullptr;
+	}
+
+	DemuxGuard guard(this, lock);
+
+	if (nav_frame_t *frame = readAhead.pop())
+	{
+		lock.unlock();
+		return nav::copyFrameToTarget(frame, target);
+	}
+
+	lock.unlock();
+	nav_frame_t *frame = readInto(target);
+	lock.lock();
+
+	eos = frame == nullptr;
+	return frame;
+}
+
+bool nav_t::nextBatch(nav_frame_t **out, size_t max, size_t *count)
+{
+	*count = 0;
+
+	std::unique_lock lock(queueMutex);
+	if (prefetchThread.joinable())
+	{
+		if (max == 0 || (out[0] = waitPrefetched(lock, nav::FrameTarget::ANY_STREAM)) == nullptr)
+			return true;
+
+		for (*count = 1; *count < max; ++*count)
+		{
+			out[*count] = readAhead.pop();
+			if (out[*count] == nullptr)
+				break;
+
+			readPosition = out[*count]->tell();
+		}
+
+		queueCond.notify_all();
+		return true;
+	}
+
+	DemuxGuard guard(this, lock);
+
+	if (readAhead.size() == 0)
+	{
+		lock.unlock();
+		bool result = readBatch(out, max, count);
+		lock.lock();
+
+		eos = *count == 0;
+		return result;
+	}
+
+	for (; *count < max; ++*count)
+	{
+		out[*count] = readAhead.pop();
+		if (out[*count] == nullptr)
+			break;
+	}
+
+	return true;
+}
+
+nav_frame_t *nav_t::readStream(size_t stream)
+{
+	if (stream >= getStreamCount())
+		throw std::runtime_error("Stream index out of range");
+	if (!isStreamEnabled(stream))
+		throw std::runtime_error("Stream is not enabled");
+
+	std::unique_lock lock(queueMutex);
+	if (prefetchThread.joinable())
+		return waitPrefetched(lock, stream);
+
+	if (streamReaders.size() <= stream)
+		streamReaders.resize(stream + 1, 0);
+
+	// Queued frames of this stream will be taken, so the demuxer may wait for space.
+	struct StreamReader
+	{
+		nav_t *state;
+		size_t stream;
+
+		~StreamReader()
+		{
+			// The lock is held again at this point.
+			state->streamReaders[stream]--;
+			state->queueCond.notify_all();
+		}
+	} reader = {this, stream};
+	streamReaders[stream]++;
+
+	while (true)
+	{
+		if (nav_frame_t *frame = readAhead.pop(stream))
+		{
+			queueCond.notify_all();
+			return frame;
+		}
+
+		if (eos)
+			return nullptr;
+
+		if (demuxing)
+		{
+			// Someone else is decoding. Wait for it to queue our frame.
+			queueCond.wait(lock);
+			continue;
+		}
+
+		DemuxGuard guard(this, lock);
+		lock.unlock();
+		nav_frame_t *frame = read();
+		if (frame && frame->getStreamIndex() != stream)
+			frame->detach();
+		lock.lock();
+
+		if (frame == nullptr)
+		{
+			eos = true;
+			return nullptr;
+		}
+
+		if (frame->getStreamIndex() == stream)
+			return frame;
+
+		queueFrame(lock, frame);
+	}
+}
+
+size_t nav_t::readAudio(size_t stream, void *dest, size_t nframes)
+{
+	const nav_streaminfo_t *sinfo = getStreamInfo(stream);
+	if (sinfo == nullptr || sinfo->type != NAV_STREAMTYPE_AUDIO)
+		throw std::runtime_error("Not an audio stream");
+	if (!isStreamEnabled(stream))
+		throw std::runtime_error("Stream is not enabled");
+
+	size_t frameSize = sinfo->audio.size();
+	size_t want = nframes * frameSize, filled = 0;
+	uint8_t *out = (uint8_t*) dest;
+
+	std::unique_lock lock(queueMutex);
+	std::optional<DemuxGuard> guard;
+	if (!prefetchThread.joinable())
+		guard.emplace(this, lock);
+
+	while (filled < want)
+	{
+		size_t offset = 0;
+		nav_frame_t *frame = readAhead.takePartial(stream, offset);
+
+		if (frame == nullptr)
+			frame = readAhead.pop(stream);
+
+		if (frame == nullptr && prefetchThread.joinable())
+		{
+			frame = waitPrefetched(lock, stream);
+			if (frame == nullptr)
+				break;
+		}
+		else if (frame && prefetchThread.joinable())
+			readPosition = frame->tell();
+		else if (frame == nullptr)
+		{
+			if (eos)
+				break;
+
+			// Let the backend decode straight into the destination if the whole frame fits.
+			uint8_t *plane = out + filled;
+			ptrdiff_t capacity = (ptrdiff_t) (want - filled);
+			nav::FrameTarget target = {&plane, &capacity, 1, stream};
+
+			lock.unlock();
+			frame = readInto(target);
+			if (frame && frame->getStreamIndex() != stream)
+				frame->detach();
+			lock.lock();
+
+			if (frame == nullptr)
+			{
+				eos = true;
+				break;
+			}
+
+			if (frame->getStreamIndex() != stream)
+			{
+				queueFrame(lock, frame);
+				continue;
+			}
+		}
+
+		ptrdiff_t *strides = nullptr;
+		size_t nplanes = 0;
+		const uint8_t *const *planes = frame->acquire(&strides, &nplanes);
+		if (planes == nullptr)
+		{
+			frame->dispose();
+			throw std::runtime_error(nav::error::get());
+		}
+
+		size_t size = (size_t) strides[0];
+
+		if (planes[0] == out + filled)
+			// Decoded in-place.
+			filled += size;
+		else
+		{
+			size_t amount = std::min(size - offset, want - filled);
+			std::copy(planes[0] + offset, planes[0] + offset + amount, out + filled);
+			filled += amount;
+			offset += amount;
+		}
+
+		frame->release();
+
+		if (offset > 0 && offset < size)
+			readAhead.setPartial(stream, frame, offset);
+		else
+			frame->dispose();
+	}
+
+	return filled / frameSize;
+}
+
+double nav_t::seek(double off, uint32_t flags)
+{
+	std::unique_lock lock(queueMutex);
+	if (prefetchThread.joinable())
+	{
+		// Let the decode thread seek. Frames it's currently decoding are discarded.
+		readAhead.clear();
+		eos = false;
+		prefetchError.clear();
+		pendingSeek = off;
+		pendingSeekFlags = flags;
+		readPosition = off;
+		hasPendingSeek = true;
+		seekGeneration++;
+		queueCond.notify_all();
+		return off;
+	}
+
+	DemuxGuard guard(this, lock);
+
+	readAhead.clear();
+	eos = false;
+	lock.unlock();
+	return seekBackend(off, flags);
+}
+
+double nav_t::getReadPosition() noexcept
+{
+	{
+		std::lock_guard lg(queueMutex);
+		if (prefetchThread.joinable())
+			return readPosition;
+	}
+
+	return getPosition();
+}
+
+bool nav_t::enableStream(size_t index, bool enabled)
+{
+	std::unique_lock lock(queueMutex);
+	DemuxGuard guard(this, lock);
+
+	if (!enabled)
+		readAhead.clear(index);
+
+	lock.unlock();
+	return setStreamEnabled(index, enabled);
+}
+
+bool nav_t::enableKeyframesOnly(size_t index, bool enabled)
+{
+	std::unique_lock lock(queueMutex);
+	DemuxGuard guard(this, lock);
+
+	// Full decoding resumes from the next keyframe, so the frames queued until then are from the old mode.
+	if (!enabled)
+		readAhead.clear(index);
+
+	lock.unlock();
+	return setKeyframesOnly(index, enabled);
+}
+
+bool nav_t::start()
+{
+	{
+		std::lock_guard lg(queueMutex);
+		if (prefetchThread.joinable())
+			return true;
+	}
+
+	if (!prepare())
+		return false;
+
+	if (prefetchFrames > 0 || prefetchBytes > 0)
+	{
+		std::lock_guard lg(queueMutex);
+		if (!prefetchThread.joinable())
+		{
+			readPosition = getPosition();
+			prefetchThread = std::thread(&nav_t::prefetch, this);
+		}
+	}
+
+	return true;
+}
+
+void nav_t::setPrefetch(uint32_t frames, uint64_t bytes) noexcept
+{
+	prefetchFrames = frames;
+	prefetchBytes = bytes;
+}
+
+bool nav_t::reopen(nav_input *input, const char *filename)
+{
+	std::unique_lock lock(queueMutex);
+	DemuxGuard guard(this, lock);
+	lock.unlock();
+
+	if (!setInput(input, filename))
+		return false;
+
+	lock.lock();
+	readAhead.clear();
+	eos = false;
+	prefetchError.clear();
+	readPosition = 0.0;
+	hasPendingSeek = false;
+	seekGeneration++;
+	return true;
+}
+
+void nav_t::setSettings(const nav_settings &newSettings) noexcept
+{
+	settings = newSettings;
+	settings.backend_order = nullptr;
+	settings.probe_cache_key = nullptr;
+}
+
+const nav_settings &nav_t::getSettings() const noexcept
+{
+	return settings;
+}
+
+void nav_t::stop() noexcept
+{
+	{
+		std::lock_guard lg(queueMutex);
+		stopping = true;
+		queueCond.notify_all();
+	}
+
+	if (prefetchThread.joinable())
+		prefetchThread.join();
+}
+
+double nav_t::seekBackend(double off, uint32_t flags)
+{
+	return (flags & NAV_SEEK_ACCURATE) ? setPositionAccurate(off) : setPosition(off);
+}
+
+void nav_t::queueFrame(std::unique_lock<std::mutex> &lock, nav_frame_t *frame)
+{
+	size_t stream = frame->getStreamIndex();
+
+	// Only wait for space if there's a reader that'll make some, otherwise the queue grows past the limit.
+	queueCond.wait(lock, [this, stream]()
+	{
+		return readAhead.size(stream) < readAhead.limit()
+			|| stream >= streamReaders.size()
+			|| streamReaders[stream] == 0;
+	});
+
+	try
+	{
+		readAhead.push(frame);
+	}
+	catch (...)
+	{
+		frame->dispose();
+		throw;
+	}
+
+	trimUnread(stream);
+	queueCond.notify_all();
+}
+
+nav_frame_t *nav_t::waitPrefetched(std::unique_lock<std::mutex> &lock, size_t stream)
+{
+	if (stream != nav::FrameTarget::ANY_STREAM && streamReaders.size() <= stream)
+		streamReaders.resize(stream + 1, 0);
+
+	// Don't keep the reference, other reader may resize the vector while waiting.
+	auto readers = [this, stream]() -> size_t&
+	{
+		return stream == nav::FrameTarget::ANY_STREAM ? anyReaders : streamReaders[stream];
+	};
+	readers()++;
+
+	// Let the decode thread know someone is waiting, even if the queue is full.
+	queueCond.notify_all();
+
+	while (true)
+	{
+		nav_frame_t *frame = stream == nav::FrameTarget::ANY_STREAM ? readAhead.pop() : readAhead.pop(stream);
+
+		if (frame || eos || !prefetchError.empty())
+		{
+			readers()--;
+			queueCond.notify_all();
+
+			if (frame)
+			{
+				readPosition = frame->tell();
+				return frame;
+			}
+			if (!prefetchError.empty())
+				throw std::runtime_error(prefetchError);
+
+			return nullptr;
+		}
+
+		queueCond.wait(lock);
+	}
+}
+
+bool nav_t::isPrefetchFull() const noexcept
+{
+	return (prefetchFrames > 0 && readAhead.size() >= prefetchFrames)
+		|| (prefetchBytes > 0 && readAhead.bytes() >= prefetchBytes);
+}
+
+bool nav_t::hasReader(size_t stream) const noexcept
+{
+	return anyReaders > 0 || (stream < streamReaders.size() && streamReaders[stream] > 0);
+}
+
+void nav_t::trimUnread(size_t stream) noexcept
+{
+	if (hasReader(stream))
+		return;
+
+	while (
+		readAhead.size(stream) > nav::FrameQueue::UNREAD_FRAMES ||
+		readAhead.bytes(stream) > nav::FrameQueue::UNREAD_BYTES
+	)
+	{
+		nav_frame_t *frame = readAhead.pop(stream);
+		frame->release();
+		frame->dispose();
+	}
+}
+
+bool nav_t::isReaderStarving() const noexcept
+{
+	if (anyReaders > 0 && readAhead.size() == 0)
+		return true;
+
+	for (size_t i = 0; i < streamReaders.size(); i++)
+	{
+		if (streamReaders[i] > 0 && readAhead.size(i) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+void nav_t::prefetch()
+{
+	std::unique_lock lock(queueMutex);
+
+	while (!stopping)
+	{
+		if (hasPendingSeek)
+		{
+			double position = pendingSeek;
+			uint32_t flags = pendingSeekFlags;
+			uint64_t generation = seekGeneration;
+			hasPendingSeek = false;
+
+			DemuxGuard guard(this, lock);
+			lock.unlock();
+
+			try
+			{
+				seekBackend(position, flags);
+			}
+			catch (const std::exception &e)
+			{
+				lock.lock();
+				if (generation == seekGeneration)
+					prefetchError = e.what();
+			}
+
+			continue;
+		}
+
+		if (eos || !prefetchError.empty() || (isPrefetchFull() && !isReaderStarving()))
+		{
+			queueCond.wait(lock);
+			continue;
+		}
+
+		uint64_t generation = seekGeneration;
+		DemuxGuard guard(this, lock);
+		lock.unlock();
+
+		nav_frame_t *frame = nullptr;
+		std::string error;
+
+		try
+		{
+			frame = read();
+			if (frame)
+				frame->detach();
+		}
+		catch (const std::exception &e)
+		{
+			error = e.what();
+		}
+
+		lock.lock();
+
+		if (generation != seekGeneration)
+		{
+			// Seeked while decoding.
+			if (frame)
+				frame->dispose();
+		}
+		else if (!error.empty())
+			prefetchError = error;
+		else if (frame == nullptr)
+			eos = true;
+		else
+		{
+			size_t stream = frame->getStreamIndex();
+
+			try
+			{
+				readAhead.push(frame);
+
+				// Only decoding past the limits for a starving reader can make other streams pile up.
+				if (isPrefetchFull())
+					trimUnread(stream);
+			}
+			catch (const std::exception &e)
+			{
+				frame->dispose();
+				prefetchError = e.what();
+			}
+		}
+
+		queueCond.notify_all();
+	}
+}
+
 nav_frame_t::~nav_frame_t()
 {
 }
+
+void nav_frame_t::recycle() noexcept
+{
+	release();
+}
+
+void nav_frame_t::detach() noexcept
+{}
+
+void nav_frame_t::dispose() noexcept
+{
+	if (std::shared_ptr<nav::FramePool> p = std::move(pool))
+		p->put(this);
+	else
+		delete this;
+}
@@ -12,12 +12,20 @@
 #define NAV_CAT(x, y) x##y
 #endif
 
+#include <condition_variable>
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "nav/audioformat.h"
+#include "nav/input.h"
 #include "nav/types.h"
 
 #include "Backend.hpp"
+#include "FrameQueue.hpp"
 
 namespace nav
 {
@@ -27,6 +35,22 @@ typedef nav_streaminfo_t StreamInfo;
 typedef nav_frame_t Frame;
 
 class Backend;
+class FramePool;
+
+// Caller-owned memory where decoded frame data should be written to.
+struct FrameTarget
+{
+	uint8_t *const *planes;
+	const ptrdiff_t *strides;
+	size_t nplanes;
+	// Only frames of this stream are written to the target.
+	size_t stream;
+
+	static constexpr size_t ANY_STREAM = ~(size_t) 0;
+
+	// For audio, `size` is the size of the decoded samples in bytes. Ignored for video.
+	bool fits(size_t index, const nav_streaminfo_t *sinfo, size_t size) const noexcept;
+};
 
 }
 
@@ -41,9 +65,93 @@ struct nav_t
 	virtual double getDuration() noexcept = 0;
 	virtual double getPosition() noexcept = 0;
 	virtual double setPosition(double off) = 0;
+	// Seek such that the first frames start exactly at `off`. Default implementation throws.
+	virtual double setPositionAccurate(double off);
 	virtual bool prepare() = 0;
 	virtual bool isPrepared() const noexcept = 0;
 	virtual nav_frame_t *read() = 0;
+	// Default implementation calls read() then copies the result to the target.
+	virtual nav_frame_t *readInto(const nav::FrameTarget &target);
+	// `count` holds the amount of frames stored in `out`, even if this throws.
+	// Default implementation returns at most 1 frame.
+	virtual bool readBatch(nav_frame_t **out, size_t max, size_t *count);
+	// Default implementation only accepts the current pixel format.
+	virtual bool setPixelFormat(size_t index, nav_pixelformat format);
+	// Width and height of 0 means the original dimensions. Default implementation only accepts the current dimensions.
+	virtual bool setVideoSize(size_t index, uint32_t width, uint32_t height, nav_scaler scaler);
+	// Default implementation only accepts decoding all frames.
+	virtual bool setKeyframesOnly(size_t index, bool keyframesOnly);
+	// Default implementation only accepts the current audio format.
+	virtual bool setAudioFormat(size_t index, nav_audioformat format);
+	// Amount of frames the decoder holds before outputting the first one. Default implementation returns 0.
+	virtual uint32_t getDecoderDelay(size_t index) const noexcept;
+	// Data that lets Backend::openCached() skip probing the same input later. Default implementation returns nothing.
+	virtual std::vector<uint8_t> getProbeData();
+	// Switches to `input` and takes its ownership if its streams match the current ones, keeping the decoders. Returns
+	// false, leaving the current input in use, if they don't. Default implementation returns false.
+	virtual bool setInput(nav_input *input, const char *filename);
+
+	// These return frames that are read ahead by other calls first before asking the backend. Only one thread calls
+	// into the backend decoding functions at a time. The rest can take frames of their own stream in the meantime.
+	nav_frame_t *next();
+	nav_frame_t *nextInto(const nav::FrameTarget &target);
+	bool nextBatch(nav_frame_t **out, size_t max, size_t *count);
+	nav_frame_t *readStream(size_t stream);
+	// Returns amount of sample frames written, which is less than `nframes` only at EOS.
+	size_t readAudio(size_t stream, void *dest, size_t nframes);
+	// Drop read-ahead frames then call the backend. When prefetching, seeking is done by the decode thread later.
+	double seek(double off, uint32_t flags);
+	// When prefetching, the position of the last frame handed out instead of the backend one, which is ahead.
+	double getReadPosition() noexcept;
+	bool enableStream(size_t index, bool enabled);
+	bool enableKeyframesOnly(size_t index, bool enabled);
+	// Calls prepare(), then starts the decode thread if prefetching is configured.
+	bool start();
+	// Must be called before start().
+	void setPrefetch(uint32_t frames, uint64_t bytes) noexcept;
+	// Drop read-ahead frames then call setInput().
+	bool reopen(nav_input *input, const char *filename);
+	// Settings it was opened with. Pointers are cleared, as they point to caller memory.
+	void setSettings(const nav_settings &newSettings) noexcept;
+	const nav_settings &getSettings() const noexcept;
+	// Must be called before the backend state is destroyed.
+	void stop() noexcept;
+
+private:
+	struct DemuxGuard;
+	double seekBackend(double off, uint32_t flags);
+	// Must be called with the lock held. Waits for space if the stream has someone reading it.
+	void queueFrame(std::unique_lock<std::mutex> &lock, nav_frame_t *frame);
+	// Must be called with the lock held. Takes frame of `stream` (or any stream) decoded by the decode thread.
+	nav_frame_t *waitPrefetched(std::unique_lock<std::mutex> &lock, size_t stream);
+	bool isPrefetchFull() const noexcept;
+	bool hasReader(size_t stream) const noexcept;
+	// Must be called with the lock held. Drops the oldest frames of `stream` past the limits of unread streams if
+	// nobody is reading it.
+	void trimUnread(size_t stream) noexcept;
+	bool isReaderStarving() const noexcept;
+	void prefetch();
+
+	nav::FrameQueue readAhead;
+	std::vector<size_t> streamReaders;
+	std::mutex queueMutex;
+	std::condition_variable queueCond;
+	bool demuxing = false;
+	bool eos = false;
+
+	std::thread prefetchThread;
+	std::string prefetchError;
+	nav_settings settings = {};
+	uint64_t prefetchBytes = 0;
+	uint64_t seekGeneration = 0;
+	double pendingSeek = 0.0;
+	// Timestamp of the last frame handed out while prefetching, or the pending seek target.
+	double readPosition = 0.0;
+	uint32_t pendingSeekFlags = 0;
+	size_t prefetchFrames = 0;
+	size_t anyReaders = 0;
+	bool hasPendingSeek = false;
+	bool stopping = false;
 };
 
 struct nav_streaminfo_t
@@ -78,6 +186,9 @@ struct nav_streaminfo_t
 				case NAV_PIXELFORMAT_RGB8:
 				case NAV_PIXELFORMAT_YUV444:
 					return 3 * dimensions;
+				case NAV_PIXELFORMAT_RGBA8:
+				case NAV_PIXELFORMAT_BGRA8:
+					return 4 * dimensions;
 				case NAV_PIXELFORMAT_YUV420:
 				case NAV_PIXELFORMAT_NV12:
 					return dimensions + 2 * ((width + 1) / 2) * ((height + 1) / 2);
@@ -97,6 +208,9 @@ struct nav_streaminfo_t
 					return width;
 				case NAV_PIXELFORMAT_RGB8:
 					return ((size_t) width) * 3;
+				case NAV_PIXELFORMAT_RGBA8:
+				case NAV_PIXELFORMAT_BGRA8:
+					return ((size_t) width) * 4;
 			}
 		}
 	};
@@ -146,6 +260,9 @@ struct nav_streaminfo_t
 						return 0;
 					case NAV_PIXELFORMAT_RGB8:
 						return video.width * (size_t) 3;
+					case NAV_PIXELFORMAT_RGBA8:
+					case NAV_PIXELFORMAT_BGRA8:
+						return video.width * (size_t) 4;
 				}
 
 				return 0;
@@ -201,6 +318,8 @@ struct nav_streaminfo_t
 
 						return 0;
 					case NAV_PIXELFORMAT_RGB8:
+					case NAV_PIXELFORMAT_RGBA8:
+					case NAV_PIXELFORMAT_BGRA8:
 						return video.height;
 				}
 
@@ -231,6 +350,15 @@ struct nav_frame_t
 	virtual void release() noexcept = 0;
 	virtual nav_hwacceltype getHWAccelType() const noexcept = 0;
 	virtual void *getHWAccelHandle() = 0;
+	// Drop references to decoder-owned resources before the frame is kept for reuse.
+	virtual void recycle() noexcept;
+	// Called before the frame is queued. Frames that hold a hardware frame from the fixed-size pool of the decoder
+	// download it if possible, so queued frames don't stall the decoder. Default implementation does nothing.
+	virtual void detach() noexcept;
+	// Give the frame back to its pool, or delete it if it's not pooled.
+	void dispose() noexcept;
+
+	std::shared_ptr<nav::FramePool> pool;
 
 	inline bool operator<(const nav_frame_t &other) const noexcept
 	{
@@ -1,4 +1,8 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <exception>
+#include <memory>
 #include <mutex>
 #include <numeric>
 #include <thread>
@@ -20,23 +24,33 @@
 #include "Error.hpp"
 #include "InputFile.hpp"
 #include "InputMemory.hpp"
+#include "InputReadAhead.hpp"
+#include "ProbeCache.hpp"
+#include "Sniffer.hpp"
 
 #include "nav/nav.h"
 
 static class BackendContainer
 {
 public:
-	BackendContainer(std::initializer_list<nav::Backend*(*)()> backendlist)
+	static constexpr uint32_t DEFAULT_IO_BUFFER_SIZE = 65536;
+
+	BackendContainer(std::initializer_list<const nav::BackendDescriptor*> backendlist)
 	: initialized(false)
 	, activeBackend()
 	, factory(backendlist)
 	, mutex()
+	, preloadThread()
+	, probeCache()
 	{}
 
 	~BackendContainer()
 	{
-		for (nav::Backend *b: activeBackend)
-			delete b;
+		if (preloadThread.joinable())
+			preloadThread.join();
+
+		for (const std::unique_ptr<LazyBackend> &lazy: activeBackend)
+			delete lazy->backend;
 	}
 
 	void init()
@@ -45,15 +59,11 @@ public:
 
 		if (!initialized)
 		{
-			for (auto func: factory)
+			// Backends are only listed here. Loading them is deferred until they're needed.
+			for (const nav::BackendDescriptor *descriptor: factory)
 			{
-				if (func)
-				{
-					nav::Backend *b = func();
-
-					if (b != nullptr)
-						activeBackend.push_back(b);
-				}
+				if (descriptor && !descriptor->isDisabled())
+					activeBackend.push_back(std::make_unique<LazyBackend>(descriptor));
 			}
 
 			for (size_t i = 0; i < activeBackend.size(); i++)
@@ -64,7 +74,19 @@ public:
 				NAV_SETTINGS_VERSION,
 				nullptr,
 				std::max<uint32_t>(std::thread::hardware_concurrency(), 1),
-				nav::getEnvvarBool("NAV_DISABLE_HWACCEL")
+				nav::getEnvvarBool("NAV_DISABLE_HWACCEL"),
+				0,
+				0,
+				DEFAULT_IO_BUFFER_SIZE,
+				0,
+				0,
+				0.0,
+				false,
+				false,
+				nullptr,
+				false,
+				NAV_PRIORITY_NORMAL,
+				false
 			};
 			if (std::optional<int> threadCount = nav::getEnvvarInt("NAV_THREAD_COUNT"))
 				defaultSettings.max_threads = (uint32_t) std::max(threadCount.value(), 1);
@@ -80,28 +102,123 @@ public:
 			init();
 	}
 
-	nav::State *open(nav_input *input, const char *filename, const nav_settings *settings)
+	// `preferred` is the index of the backend to try first, or 0.
+	nav::State *open(nav_input *input, const char *filename, const nav_settings *settings, size_t preferred)
 	{
 		ensureInit();
 
 		if (settings == nullptr)
 			settings = &defaultSettings;
 
-		nav_settings newSettings = *settings;
+		// Older nav_settings struct is smaller. Only copy the fields that it has.
+		nav_settings newSettings = defaultSettings;
+		std::copy(
+			(const uint8_t*) settings,
+			(const uint8_t*) settings + getSettingsSize(settings->version),
+			(uint8_t*) &newSettings
+		);
+		newSettings.version = NAV_SETTINGS_VERSION;
 		newSettings.max_threads = std::max<uint32_t>(newSettings.max_threads, 1);
+		if (newSettings.io_buffer_size == 0)
+			newSettings.io_buffer_size = DEFAULT_IO_BUFFER_SIZE;
+		if (newSettings.low_latency)
+		{
+			// Frames decoded ahead are stale after every seek.
+			newSettings.prefetch_frames = 0;
+			newSettings.prefetch_bytes = 0;
+		}
+
+		// Inputs already in memory gain nothing from reading ahead.
+		nav_input *userInput = input;
+		std::unique_ptr<nav::input::ReadAhead> readAhead;
+		if (newSettings.readahead_size > 0 && !input->canBorrow())
+		{
+			readAhead = std::make_unique<nav::input::ReadAhead>(*input, newSettings.readahead_size);
+			input = readAhead->getInput();
+		}
+
+		std::vector<size_t> order;
+		for (const size_t *o = newSettings.backend_order ? newSettings.backend_order : defaultOrder.data(); *o; o++)
+		{
+			if (*o > 0 && *o <= activeBackend.size())
+				order.push_back(*o);
+		}
+
+		if (auto it = std::find(order.begin(), order.end(), preferred); it != order.end())
+			std::rotate(order.begin(), it, it + 1);
+
+		nav::ContainerType container = nav::sniffContainer(input);
+		bool sniffed = container != nav::ContainerType::UNKNOWN;
+		if (!sniffed)
+			container = nav::containerFromExtension(filename);
+
+		// Try the backend that opened this input last time first.
+		std::string cacheKey;
+		nav::ProbeCache::Entry cached;
+		bool cacheHit = false;
+
+		if (newSettings.probe_cache)
+		{
+			if (newSettings.probe_cache_key)
+				cacheKey = std::string("key:") + newSettings.probe_cache_key;
+			else
+				cacheKey = nav::ProbeCache::makeFileKey(filename, userInput->sizef());
+
+			if (!cacheKey.empty() && probeCache.find(cacheKey, cached))
+			{
+				auto it = std::find_if(order.begin(), order.end(), [this, &cached](size_t index)
+				{
+					return cached.backend == activeBackend[index - 1]->descriptor->name;
+				});
+
+				if (it != order.end())
+				{
+					std::rotate(order.begin(), it, it + 1);
+					cacheHit = true;
+				}
+			}
+		}
 
 		std::vector<std::string> errors;
-		const size_t *order = newSettings.backend_order ? newSettings.backend_order : defaultOrder.data();
+		std::vector<size_t> deferred;
+		bool skipped = false;
 
-		for (size_t backendIndex = *order; *order; backendIndex = *++order)
+		// Second pass goes through backends that can't open the container guessed from the extension.
+		for (size_t pass = 0; pass < 2; pass++)
 		{
-			if (backendIndex > 0 && backendIndex <= activeBackend.size())
+			for (size_t backendIndex: pass == 0 ? order : deferred)
 			{
-				nav::Backend *b = activeBackend[backendIndex - 1];
+				nav::Backend *b = load(*activeBackend[backendIndex - 1]);
+				if (b == nullptr)
+					continue;
+
+				if (pass == 0 && container != nav::ContainerType::UNKNOWN && !b->canOpen(container))
+				{
+					// Only a signature in the content is trusted enough to skip the backend.
+					if (sniffed)
+						skipped = true;
+					else
+						deferred.push_back(backendIndex);
+
+					continue;
+				}
+
+				bool useCached = pass == 0 && cacheHit && backendIndex == order.front();
 
 				try
 				{
-					return b->open(input, filename, &newSettings);
+					nav::State *state = useCached
+						? b->openCached(input, filename, &newSettings, cached.data)
+						: b->open(input, filename, &newSettings);
+					state->setPrefetch(newSettings.prefetch_frames, newSettings.prefetch_bytes);
+					state->setSettings(newSettings);
+					// Closing the input deletes it now.
+					readAhead.release();
+
+					if (!cacheKey.empty() && !useCached)
+						storeProbeData(cacheKey, b, state);
+
+					return state;
 				}
 				catch (const std::exception &e)
 				{
@@ -110,8 +227,16 @@ public:
 			}
 		}
 
+		if (readAhead)
+			*userInput = readAhead->release();
+
 		if (errors.empty())
-			nav::error::set("No backend available");
+		{
+			if (skipped)
+				nav::error::set(std::string("No backend can open ") + nav::getContainerName(container) + " input");
+			else
+				nav::error::set("No backend available");
+		}
 		else
 		{
 			std::stringstream ss;
@@ -124,28 +249,115 @@ public:
 		return nullptr;
 	}
 
+	nav::State *reopen(nav::State *state, nav_input *input, const char *filename)
+	{
+		// Probing moves inputs without read_at. Opening expects them where the caller left them.
+		uint64_t start = input->tellf();
+		std::string reopenError;
+
+		try
+		{
+			if (state->reopen(input, filename))
+				return state;
+		}
+		catch (const std::exception &e)
+		{
+			// Another backend may still open it.
+			reopenError = e.what();
+		}
+
+		input->seekf(start);
+
+		// The stored settings outlive the instance that's closed below.
+		nav_settings settings = state->getSettings();
+		nav::State *newState = open(input, filename, &settings, getBackendIndex(state->getBackend()));
+
+		if (newState)
+		{
+			state->stop();
+			delete state;
+		}
+		else
+		{
+			input->seekf(start);
+
+			if (!reopenError.empty())
+			{
+				const char *openError = nav::error::get();
+				nav::error::set(std::string(openError ? openError : "") + "\nCannot keep the decoders: " + reopenError);
+			}
+		}
+
+		return newState;
+	}
+
 	size_t count()
 	{
 		ensureInit();
 		return activeBackend.size();
 	}
 
+	const nav::BackendDescriptor *getDescriptor(size_t i)
+	{
+		ensureInit();
+
+		if (i > 0 && i <= activeBackend.size())
+			return activeBackend[i - 1]->descriptor;
+
+		nav::error::set("Index out of range");
+		return nullptr;
+	}
+
+	// Loads the backend if it's not loaded yet.
 	nav::Backend *getBackend(size_t i)
 	{
 		ensureInit();
 
 		if (i > 0 && i <= activeBackend.size())
-			return activeBackend[i - 1];
+		{
+			LazyBackend &lazy = *activeBackend[i - 1];
+
+			if (nav::Backend *b = load(lazy))
+				return b;
+
+			nav::error::set(lazy.error);
+			return nullptr;
+		}
 
 		nav::error::set("Index out of range");
 		return nullptr;
 	}
 
+	void preload(bool background)
+	{
+		ensureInit();
+
+		if (background)
+		{
+			std::lock_guard lg(mutex);
+
+			if (!preloadThread.joinable())
+				preloadThread = std::thread(&BackendContainer::loadAll, this, false);
+		}
+		else
+			loadAll(true);
+	}
+
+	void setProbeCacheDirectory(const char *directory)
+	{
+		probeCache.setDirectory(directory ? directory : "");
+	}
+
+	void clearProbeCache()
+	{
+		probeCache.clear();
+	}
+
 	size_t getBackendIndex(nav::Backend *backend)
 	{
 		for (size_t i = 0; i < activeBackend.size(); i++)
 		{
-			if (activeBackend[i] == backend)
+			if (activeBackend[i]->backend == backend)
 				return i + 1;
 		}
 
@@ -153,36 +365,110 @@ public:
 	}
 
 private:
+	struct LazyBackend
+	{
+		LazyBackend(const nav::BackendDescriptor *descriptor)
+		: descriptor(descriptor)
+		, loaded()
+		, backend(nullptr)
+		, error()
+		{}
+
+		const nav::BackendDescriptor *descriptor;
+		std::once_flag loaded;
+		// Atomic, as getBackendIndex() reads it without going through `loaded`.
+		std::atomic<nav::Backend*> backend;
+		// Why loading failed.
+		std::string error;
+	};
+
+	// Returns NULL if the backend can't be loaded, with the reason in `lazy.error`.
+	static nav::Backend *load(LazyBackend &lazy)
+	{
+		std::call_once(lazy.loaded, [&lazy]()
+		{
+			nav::Backend *backend = lazy.descriptor->create();
+			lazy.backend = backend;
+			if (backend == nullptr)
+				lazy.error = std::string("Cannot load backend ") + lazy.descriptor->name + ": " + nav::error::get();
+		});
+
+		return lazy.backend;
+	}
+
+	void loadAll(bool includeThreadBound)
+	{
+		for (const std::unique_ptr<LazyBackend> &lazy: activeBackend)
+		{
+			if (includeThreadBound || !lazy->descriptor->threadBound)
+				load(*lazy);
+		}
+	}
+
+	void storeProbeData(const std::string &key, nav::Backend *backend, nav::State *state)
+	{
+		// The cache is only an optimization. Failing to fill it doesn't fail the open.
+		try
+		{
+			probeCache.store(key, {backend->getName(), state->getProbeData()});
+		}
+		catch (const std::exception &)
+		{}
+	}
+
+	static size_t getSettingsSize(uint64_t version)
+	{
+		switch (version)
+		{
+			case 0:
+				return offsetof(nav_settings, prefetch_frames);
+			case 1:
+				return offsetof(nav_settings, io_buffer_size);
+			case 2:
+				return offsetof(nav_settings, probe_size);
+			case 3:
+				return offsetof(nav_settings, probe_cache);
+			case 4:
+				return offsetof(nav_settings, shared_thread_pool);
+			case 5:
+				return offsetof(nav_settings, low_latency);
+			default:
+				return sizeof(nav_settings);
+		}
+	}
+
 	bool initialized;
-	std::vector<nav::Backend*> activeBackend;
-	std::vector<nav::Backend*(*)()> factory;
+	std::vector<std::unique_ptr<LazyBackend>> activeBackend;
+	std::vector<const nav::BackendDescriptor*> factory;
 	std::vector<size_t> defaultOrder;
 	std::mutex mutex;
+	std::thread preloadThread;
+	nav::ProbeCache probeCache;
 	nav_settings defaultSettings;
 } backendContainer({
 #ifdef NAV_BACKEND_FFMPEG_8
-	&nav::ffmpeg8::create,
+	&nav::ffmpeg8::descriptor,
 #endif
 #ifdef NAV_BACKEND_FFMPEG_7
-	&nav::ffmpeg7::create,
+	&nav::ffmpeg7::descriptor,
 #endif
 #ifdef NAV_BACKEND_FFMPEG_6
-	&nav::ffmpeg6::create,
+	&nav::ffmpeg6::descriptor,
 #endif
 #ifdef NAV_BACKEND_FFMPEG_5
-	&nav::ffmpeg5::create,
+	&nav::ffmpeg5::descriptor,
 #endif
 #ifdef NAV_BACKEND_FFMPEG_4
-	&nav::ffmpeg4::create,
+	&nav::ffmpeg4::descriptor,
 #endif
 #ifdef NAV_BACKEND_ANDROIDNDK
-	&nav::androidndk::create,
+	&nav::androidndk::descriptor,
 #endif
 #ifdef NAV_BACKEND_GSTREAMER
-	&nav::gstreamer::create,
+	&nav::gstreamer::descriptor,
 #endif
 #ifdef NAV_BACKEND_MEDIAFOUNDATION
-	&nav::mediafoundation::create,
+	&nav::mediafoundation::descriptor,
 #endif
 	nullptr
 });
@@ -218,6 +504,12 @@ extern "C" const char *nav_error()
 	return nav::error::get();
 }
 
+extern "C" void nav_input_init(nav_input *input)
+{
+	*input = {};
+	input->version = NAV_INPUT_VERSION;
+}
+
 extern "C" void nav_input_populate_from_memory(nav_input *input, void *buf, size_t size)
 {
 	nav::error::set("");
@@ -230,6 +522,30 @@ extern "C" nav_bool nav_input_populate_from_file(nav_input *input, const char *f
 	return (nav_bool) nav::input::file::populate(input, filename);
 }
 
+extern "C" nav_bool nav_input_populate_from_file_mapped(nav_input *input, const char *filename)
+{
+	nav::error::set("");
+	return (nav_bool) nav::input::file::populateMapped(input, filename);
+}
+
+extern "C" nav_bool nav_input_populate_from_file_async(nav_input *input, const char *filename)
+{
+	nav::error::set("");
+	return (nav_bool) nav::input::file::populateAsync(input, filename);
+}
+
+extern "C" void nav_probe_cache_set_directory(const char *directory)
+{
+	nav::error::set("");
+	backendContainer.setProbeCacheDirectory(directory);
+}
+
+extern "C" void nav_probe_cache_clear()
+{
+	nav::error::set("");
+	backendContainer.clearProbeCache();
+}
+
 extern "C" size_t nav_backend_count()
 {
 	nav::error::set("");
@@ -239,15 +555,15 @@ extern "C" size_t nav_backend_count()
 extern "C" const char *nav_backend_name(size_t index)
 {
 	nav::error::set("");
-	nav::Backend *backend = backendContainer.getBackend(index);
-	return backend ? backend->getName() : nullptr;
+	const nav::BackendDescriptor *descriptor = backendContainer.getDescriptor(index);
+	return descriptor ? descriptor->name : nullptr;
 }
 
 extern "C" nav_backendtype nav_backend_type(size_t index)
 {
 	nav::error::set("");
-	nav::Backend *backend = backendContainer.getBackend(index);
-	return backend ? backend->getType() : NAV_BACKENDTYPE_UNKNOWN;
+	const nav::BackendDescriptor *descriptor = backendContainer.getDescriptor(index);
+	return descriptor ? descriptor->type : NAV_BACKENDTYPE_UNKNOWN;
 }
 
 extern "C" const char *nav_backend_info(size_t index)
@@ -257,14 +573,26 @@ extern "C" const char *nav_backend_info(size_t index)
 	return backend ? wrapcall<const char*>(backend, &nav::Backend::getInfo, nullptr) : nullptr;
 }
 
+extern "C" void nav_preload_backends(nav_bool background)
+{
+	nav::error::set("");
+	backendContainer.preload(background);
+}
+
 extern "C" nav_t *nav_open(nav_input *input, const char *filename, const nav_settings *settings)
 {
-	return wrapcall<nav_t*>(&backendContainer, &BackendContainer::open, nullptr, input, filename, settings);
+	return wrapcall<nav_t*>(&backendContainer, &BackendContainer::open, nullptr, input, filename, settings, (size_t) 0);
+}
+
+extern "C" nav_t *nav_reopen(nav_t *state, nav_input *input, const char *filename)
+{
+	return wrapcall<nav_t*>(&backendContainer, &BackendContainer::reopen, nullptr, state, input, filename);
 }
 
 extern "C" void nav_close(nav_t *state)
 {
 	nav::error::set("");
+	state->stop();
 	delete state;
 }
 
@@ -295,13 +623,39 @@ extern "C" nav_bool nav_stream_is_enabled(const nav_t *state, size_t index)
 
 extern "C" nav_bool nav_stream_enable(nav_t *state, size_t index, nav_bool enable)
 {
-	return (nav_bool) wrapcall(state, &nav::State::setStreamEnabled, false, index, enable);
+	return (nav_bool) wrapcall(state, &nav::State::enableStream, false, index, enable);
+}
+
+extern "C" nav_bool nav_stream_set_pixel_format(nav_t *state, size_t index, nav_pixelformat format)
+{
+	return (nav_bool) wrapcall(state, &nav::State::setPixelFormat, false, index, format);
+}
+
+extern "C" nav_bool nav_stream_set_video_size(nav_t *state, size_t index, uint32_t width, uint32_t height, nav_scaler scaler)
+{
+	return (nav_bool) wrapcall(state, &nav::State::setVideoSize, false, index, width, height, scaler);
+}
+
+extern "C" nav_bool nav_stream_set_keyframes_only(nav_t *state, size_t index, nav_bool keyframes_only)
+{
+	return (nav_bool) wrapcall(state, &nav::State::enableKeyframesOnly, false, index, (bool) keyframes_only);
+}
+
+extern "C" nav_bool nav_stream_set_audio_format(nav_t *state, size_t index, nav_audioformat format)
+{
+	return (nav_bool) wrapcall(state, &nav::State::setAudioFormat, false, index, format);
+}
+
+extern "C" uint32_t nav_stream_decoder_delay(const nav_t *state, size_t index)
+{
+	nav::error::set("");
+	return state->getDecoderDelay(index);
 }
 
 extern "C" double nav_tell(nav_t *state)
 {
 	nav::error::set("");
-	return state->getPosition();
+	return state->getReadPosition();
 }
 
 extern "C" double nav_duration(nav_t *state)
@@ -312,12 +666,17 @@ extern "C" double nav_duration(nav_t *state)
 
 extern "C" double nav_seek(nav_t *state, double position)
 {
-	return wrapcall(state, &nav::State::setPosition, -1., position);
+	return wrapcall(state, &nav::State::seek, -1., position, (uint32_t) NAV_SEEK_DEFAULT);
+}
+
+extern "C" double nav_seek_ex(nav_t *state, double position, uint32_t flags)
+{
+	return wrapcall(state, &nav::State::seek, -1., position, flags);
 }
 
 extern "C" bool nav_prepare(nav_t *state)
 {
-	return wrapcall(state, &nav::State::prepare, false);
+	return wrapcall(state, &nav::State::start, false);
 }
 
 extern "C" bool nav_is_prepared(const nav_t *state)
@@ -331,7 +690,66 @@ extern "C" nav_frame_t *nav_read(nav_t *state)
 	if (!nav_prepare(state))
 		return nullptr;
 
-	return wrapcall<nav_frame_t*>(state, &nav::State::read, nullptr);
+	return wrapcall<nav_frame_t*>(state, &nav::State::next, nullptr);
+}
+
+extern "C" nav_frame_t *nav_read_into(nav_t *state, uint8_t *const *planes, const ptrdiff_t *strides, size_t nplanes)
+{
+	if (planes == nullptr || strides == nullptr || nplanes == 0)
+	{
+		nav::error::set("Invalid destination planes");
+		return nullptr;
+	}
+
+	if (!nav_prepare(state))
+		return nullptr;
+
+	nav::FrameTarget target = {planes, strides, nplanes, nav::FrameTarget::ANY_STREAM};
+	return wrapcall<nav_frame_t*>(state, &nav::State::nextInto, nullptr, target);
+}
+
+extern "C" nav_bool nav_read_batch(nav_t *state, nav_frame_t **out, size_t max, size_t *count)
+{
+	if (count == nullptr)
+	{
+		nav::error::set("Invalid count pointer");
+		return false;
+	}
+
+	*count = 0;
+
+	if (out == nullptr && max > 0)
+	{
+		nav::error::set("Invalid destination array");
+		return false;
+	}
+
+	if (!nav_prepare(state))
+		return false;
+
+	return (nav_bool) wrapcall(state, &nav::State::nextBatch, false, out, max, count);
+}
+
+extern "C" nav_frame_t *nav_read_stream(nav_t *state, size_t index)
+{
+	if (!nav_prepare(state))
+		return nullptr;
+
+	return wrapcall<nav_frame_t*>(state, &nav::State::readStream, nullptr, index);
+}
+
+extern "C" size_t nav_read_audio(nav_t *state, size_t stream, void *dst, size_t nframes)
+{
+	if (dst == nullptr && nframes > 0)
+	{
+		nav::error::set("Invalid destination buffer");
+		return 0;
+	}
+
+	if (!nav_prepare(state))
+		return 0;
+
+	return wrapcall(state, &nav::State::readAudio, (size_t) 0, stream, dst, nframes);
 }
 
 extern "C" nav_streamtype nav_streaminfo_type(const nav_streaminfo_t *sinfo)
@@ -504,5 +922,5 @@ extern "C" void nav_frame_release(nav_frame_t *frame)
 extern "C" void nav_frame_free(nav_frame_t *frame)
 {
 	frame->release();
-	delete frame;
+	frame->dispose();
 }
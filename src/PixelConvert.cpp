@@ -0,0 +1,373 @@
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "PixelConvert.hpp"
+#include "PixelKernels.hpp"
+#include "CPUFeatures.hpp"
+#include "Common.hpp"
+#include "ThreadPool.hpp"
+
+namespace nav
+{
+
+// 6 fractional bits.
+static constexpr RGBMatrix BT601_LIMITED_RANGE = {16, 75, 102, 25, 52, 129};
+static constexpr RGBMatrix BT601_FULL_RANGE = {0, 64, 90, 22, 46, 113};
+static constexpr RGBMatrix BT709_LIMITED_RANGE = {16, 75, 115, 14, 34, 135};
+static constexpr RGBMatrix BT709_FULL_RANGE = {0, 64, 101, 12, 30, 119};
+
+namespace scalar
+{
+
+static inline int16_t sat16(int v) noexcept
+{
+	return (int16_t) std::clamp<int>(v, std::numeric_limits<int16_t>::min(), std::numeric_limits<int16_t>::max());
+}
+
+static inline uint8_t toPixel(int16_t v) noexcept
+{
+	return (uint8_t) std::clamp<int>(sat16(v + 32) >> 6, 0, 255);
+}
+
+void interleave(uint8_t *dst, const uint8_t *u, const uint8_t *v, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		dst[i * 2] = u[i];
+		dst[i * 2 + 1] = v[i];
+	}
+}
+
+void deinterleave(uint8_t *u, uint8_t *v, const uint8_t *src, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		u[i] = src[i * 2];
+		v[i] = src[i * 2 + 1];
+	}
+}
+
+void average(uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		dst[i] = (uint8_t) ((a[i] + b[i] + 1) >> 1);
+}
+
+void scale255(uint8_t *dst, const uint8_t *src, size_t n, uint16_t mul, uint16_t add)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		uint32_t t = (uint32_t) src[i] * mul + add;
+		dst[i] = (uint8_t) ((t + 1 + (t >> 8)) >> 8);
+	}
+}
+
+void narrow16(uint8_t *dst, const uint16_t *src, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		dst[i] = (uint8_t) (src[i] >> 8);
+}
+
+void yuvToRGB(uint8_t *dst, const uint8_t *y, const uint8_t *u, const uint8_t *v, size_t n, const RGBMatrix &m, RGBLayout layout)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		int16_t yy = (int16_t) ((y[i] - m.yOffset) * m.yMul);
+		int16_t uu = (int16_t) (u[i / 2] - 128);
+		int16_t vv = (int16_t) (v[i / 2] - 128);
+
+		uint8_t r = toPixel(sat16(yy + vv * m.vr));
+		uint8_t g = toPixel(sat16(sat16(yy - uu * m.ug) - vv * m.vg));
+		uint8_t b = toPixel(sat16(yy + uu * m.ub));
+
+		switch (layout)
+		{
+			case RGBLayout::RGB:
+				dst[0] = r;
+				dst[1] = g;
+				dst[2] = b;
+				dst += 3;
+				break;
+			case RGBLayout::RGBA:
+				dst[0] = r;
+				dst[1] = g;
+				dst[2] = b;
+				dst[3] = 255;
+				dst += 4;
+				break;
+			case RGBLayout::BGRA:
+				dst[0] = b;
+				dst[1] = g;
+				dst[2] = r;
+				dst[3] = 255;
+				dst += 4;
+				break;
+		}
+	}
+}
+
+}
+
+static const PixelKernels SCALAR_KERNELS = {
+	"scalar",
+	scalar::interleave,
+	scalar::deinterleave,
+	scalar::average,
+	scalar::scale255,
+	scalar::narrow16,
+	scalar::yuvToRGB
+};
+
+static const PixelKernels *selectKernels() noexcept
+{
+	const PixelKernels *kernels = nullptr;
+
+	if (cpu::hasAVX2())
+		kernels = getAVX2PixelKernels();
+	if (kernels == nullptr && cpu::hasSSE2())
+		kernels = getSSE2PixelKernels();
+	if (kernels == nullptr && cpu::hasNEON())
+		kernels = getNEONPixelKernels();
+
+	return kernels ? kernels : &SCALAR_KERNELS;
+}
+
+static const PixelKernels *getKernels() noexcept
+{
+	static const PixelKernels *kernels = selectKernels();
+	return kernels;
+}
+
+const char *getPixelKernelsName() noexcept
+{
+	return getKernels()->name;
+}
+
+PixelConverter::PixelConverter(SourcePixelFormat from, nav_pixelformat to) noexcept
+: from(from)
+, to(to)
+, kernels(getKernels())
+, scratch()
+, scratchCount(0)
+{}
+
+bool PixelConverter::isSupported(SourcePixelFormat from, nav_pixelformat to) noexcept
+{
+	switch (to)
+	{
+		case NAV_PIXELFORMAT_YUV420:
+			return from != SourcePixelFormat::YUV420P;
+		case NAV_PIXELFORMAT_NV12:
+			return from != SourcePixelFormat::NV12;
+		case NAV_PIXELFORMAT_RGB8:
+		case NAV_PIXELFORMAT_RGBA8:
+		case NAV_PIXELFORMAT_BGRA8:
+			return true;
+		default:
+			return false;
+	}
+}
+
+void PixelConverter::convert(
+	const uint8_t *const *src,
+	const ptrdiff_t *srcStrides,
+	uint8_t *const *dst,
+	const ptrdiff_t *dstStrides,
+	uint32_t width,
+	uint32_t height,
+	YUVMatrix matrix,
+	ThreadPool *pool,
+	int priority
+) const
+{
+	size_t nthreads = pool ? std::max<size_t>(pool->getThreadCount(), 1) : 1;
+	if (scratchCount < nthreads)
+	{
+		scratch = std::make_unique<AlignedBuffer[]>(nthreads);
+		scratchCount = nthreads;
+	}
+
+	// Small slices aren't worth the synchronization.
+	constexpr size_t MIN_SLICE_HEIGHT = 64;
+	size_t nslices = pool ? std::min<size_t>(nthreads, height / MIN_SLICE_HEIGHT) : 1;
+
+	if (nslices <= 1)
+	{
+		convertRows(src, srcStrides, dst, dstStrides, width, height, matrix, 0, height, scratch[0]);
+		return;
+	}
+
+	// Even, so slices don't share chroma rows.
+	size_t sliceHeight = ((height + nslices - 1) / nslices + 1) & ~(size_t) 1;
+	nslices = (height + sliceHeight - 1) / sliceHeight;
+
+	pool->parallelFor(nslices, [&](size_t i, size_t slot)
+	{
+		size_t y0 = i * sliceHeight;
+		size_t y1 = std::min<size_t>(y0 + sliceHeight, height);
+		convertRows(src, srcStrides, dst, dstStrides, width, height, matrix, y0, y1, scratch[slot]);
+	}, priority, scratchCount);
+}
+
+void PixelConverter::convertRows(
+	const uint8_t *const *src,
+	const ptrdiff_t *srcStrides,
+	uint8_t *const *dst,
+	const ptrdiff_t *dstStrides,
+	size_t width,
+	size_t height,
+	YUVMatrix matrix,
+	size_t y0,
+	size_t y1,
+	AlignedBuffer &temp
+) const
+{
+	const PixelKernels &k = *kernels;
+	size_t w = width, h = height;
+	size_t cw = (w + 1) / 2;
+	bool fullRange = from == SourcePixelFormat::YUVJ420P || from == SourcePixelFormat::YUVJ422P;
+	// 4:2:2 has a chroma row for every luma row.
+	bool chroma422 = from == SourcePixelFormat::YUV422P || from == SourcePixelFormat::YUVJ422P;
+
+	// Row scratch space, each one 64-byte aligned.
+	size_t lumaSize = (w + 63) & ~(size_t) 63, chromaSize = (cw + 63) & ~(size_t) 63;
+	temp.resize(lumaSize + chromaSize * 4);
+	uint8_t *tempY = temp.data();
+	uint8_t *tempUV = tempY + lumaSize;
+	uint8_t *tempU = tempUV + chromaSize * 2;
+	uint8_t *tempV = tempU + chromaSize;
+
+	auto row = [](auto *plane, ptrdiff_t stride, size_t index)
+	{
+		return plane + stride * (ptrdiff_t) index;
+	};
+
+	auto luma = [&](size_t y) -> const uint8_t*
+	{
+		const uint8_t *line = row(src[0], srcStrides[0], y);
+		if (from == SourcePixelFormat::P010)
+		{
+			k.narrow16(tempY, (const uint16_t*) line, w);
+			return tempY;
+		}
+
+		return line;
+	};
+
+	size_t lastChroma = std::numeric_limits<size_t>::max();
+	const uint8_t *u = nullptr, *v = nullptr;
+
+	auto chroma = [&](size_t index)
+	{
+		if (index == lastChroma)
+			return;
+
+		lastChroma = index;
+
+		switch (from)
+		{
+			case SourcePixelFormat::NV12:
+			case SourcePixelFormat::NV21:
+			case SourcePixelFormat::P010:
+			{
+				const uint8_t *line = row(src[1], srcStrides[1], index);
+				if (from == SourcePixelFormat::P010)
+				{
+					k.narrow16(tempUV, (const uint16_t*) line, cw * 2);
+					line = tempUV;
+				}
+
+				if (from == SourcePixelFormat::NV21)
+					k.deinterleave(tempV, tempU, line, cw);
+				else
+					k.deinterleave(tempU, tempV, line, cw);
+
+				u = tempU;
+				v = tempV;
+				break;
+			}
+			default:
+				u = row(src[1], srcStrides[1], index);
+				v = row(src[2], srcStrides[2], index);
+				break;
+		}
+	};
+
+	switch (to)
+	{
+		case NAV_PIXELFORMAT_RGB8:
+		case NAV_PIXELFORMAT_RGBA8:
+		case NAV_PIXELFORMAT_BGRA8:
+		{
+			const RGBMatrix &m = matrix == YUVMatrix::BT709
+				? (fullRange ? BT709_FULL_RANGE : BT709_LIMITED_RANGE)
+				: (fullRange ? BT601_FULL_RANGE : BT601_LIMITED_RANGE);
+			RGBLayout layout = to == NAV_PIXELFORMAT_RGB8
+				? RGBLayout::RGB
+				: (to == NAV_PIXELFORMAT_RGBA8 ? RGBLayout::RGBA : RGBLayout::BGRA);
+
+			for (size_t y = y0; y < y1; y++)
+			{
+				chroma(chroma422 ? y : y / 2);
+				k.yuvToRGB(row(dst[0], dstStrides[0], y), luma(y), u, v, w, m, layout);
+			}
+
+			break;
+		}
+		case NAV_PIXELFORMAT_YUV420:
+		case NAV_PIXELFORMAT_NV12:
+		{
+			for (size_t y = y0; y < y1; y++)
+			{
+				uint8_t *out = row(dst[0], dstStrides[0], y);
+				const uint8_t *in = row(src[0], srcStrides[0], y);
+
+				if (from == SourcePixelFormat::P010)
+					k.narrow16(out, (const uint16_t*) in, w);
+				else if (fullRange)
+					k.scale255(out, in, w, 219, 16 * 255 + 128);
+				else
+					std::copy(in, in + w, out);
+			}
+
+			for (size_t y = y0 / 2; y < (y1 + 1) / 2; y++)
+			{
+				if (chroma422)
+				{
+					// Vertically downsample 2 rows.
+					size_t y2 = std::min(y * 2 + 1, h - 1);
+					k.average(tempU, row(src[1], srcStrides[1], y * 2), row(src[1], srcStrides[1], y2), cw);
+					k.average(tempV, row(src[2], srcStrides[2], y * 2), row(src[2], srcStrides[2], y2), cw);
+					u = tempU;
+					v = tempV;
+				}
+				else
+					chroma(y);
+
+				if (fullRange)
+				{
+					// (C - 128) * 224 / 255 + 128
+					k.scale255(tempU, u, cw, 224, 16 * 256);
+					k.scale255(tempV, v, cw, 224, 16 * 256);
+					u = tempU;
+					v = tempV;
+				}
+
+				if (to == NAV_PIXELFORMAT_NV12)
+					k.interleave(row(dst[1], dstStrides[1], y), u, v, cw);
+				else
+				{
+					std::copy(u, u + cw, row(dst[1], dstStrides[1], y));
+					std::copy(v, v + cw, row(dst[2], dstStrides[2], y));
+				}
+			}
+
+			break;
+		}
+		default:
+			break;
+	}
+}
+
+}
@@ -0,0 +1,88 @@
+#ifndef _NAV_PIXEL_CONVERT_HPP_
+#define _NAV_PIXEL_CONVERT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "nav/types.h"
+
+#include "Common.hpp"
+
+namespace nav
+{
+
+struct PixelKernels;
+class ThreadPool;
+
+// Decoded layouts that the built-in conversion handles. "J" variants are full range.
+enum class SourcePixelFormat
+{
+	YUV420P,
+	YUVJ420P,
+	YUV422P,
+	YUVJ422P,
+	NV12,
+	NV21,
+	// 10-bit in the most significant bits of 16-bit little-endian samples, UV interleaved.
+	P010
+};
+
+// YUV to RGB coefficients.
+enum class YUVMatrix
+{
+	BT601,
+	BT709
+};
+
+// Same-size conversion from a decoded layout to a nav_pixelformat, without going through the backend converter.
+// The kernels are picked by the CPU features at runtime. Calls to convert() must not overlap, as they share the row
+// scratch space.
+class PixelConverter
+{
+public:
+	PixelConverter(SourcePixelFormat from, nav_pixelformat to) noexcept;
+	static bool isSupported(SourcePixelFormat from, nav_pixelformat to) noexcept;
+	// If `pool` is not null, the picture is split into horizontal slices which are converted in parallel. `priority` is
+	// passed to ThreadPool::parallelFor().
+	void convert(
+		const uint8_t *const *src,
+		const ptrdiff_t *srcStrides,
+		uint8_t *const *dst,
+		const ptrdiff_t *dstStrides,
+		uint32_t width,
+		uint32_t height,
+		YUVMatrix matrix,
+		ThreadPool *pool,
+		int priority = 0
+	) const;
+
+private:
+	// Converts rows [y0, y1). `y0` must be even.
+	void convertRows(
+		const uint8_t *const *src,
+		const ptrdiff_t *srcStrides,
+		uint8_t *const *dst,
+		const ptrdiff_t *dstStrides,
+		size_t width,
+		size_t height,
+		YUVMatrix matrix,
+		size_t y0,
+		size_t y1,
+		AlignedBuffer &temp
+	) const;
+
+	SourcePixelFormat from;
+	nav_pixelformat to;
+	const PixelKernels *kernels;
+	// One per thread slot of the pool, allocated on first use.
+	mutable std::unique_ptr<AlignedBuffer[]> scratch;
+	mutable size_t scratchCount;
+};
+
+// Name of the kernel set in use: "avx2", "sse2", "neon", or "scalar".
+const char *getPixelKernelsName() noexcept;
+
+}
+
+#endif /* _NAV_PIXEL_CONVERT_HPP_ */
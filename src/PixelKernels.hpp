@@ -0,0 +1,62 @@
+#ifndef _NAV_PIXEL_KERNELS_HPP_
+#define _NAV_PIXEL_KERNELS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace nav
+{
+
+// Fixed-point YUV to RGB coefficients with 6 fractional bits. Every kernel set must produce identical results, so
+// the SIMD variants saturate at the same steps as the scalar one:
+// R = clamp((sat(sat(Y' + V'*vr) + 32)) >> 6), G = clamp((sat(sat(sat(Y' - U'*ug) - V'*vg) + 32)) >> 6),
+// B = clamp((sat(sat(Y' + U'*ub) + 32)) >> 6) where Y' = (Y - yOffset) * yMul, U' = U - 128, V' = V - 128.
+struct RGBMatrix
+{
+	int16_t yOffset, yMul, vr, ug, vg, ub;
+};
+
+enum class RGBLayout
+{
+	RGB,
+	RGBA,
+	BGRA
+};
+
+// Row kernels. `n` is the amount of output samples.
+struct PixelKernels
+{
+	const char *name;
+	// UV interleaving, as in NV12.
+	void (*interleave)(uint8_t *dst, const uint8_t *u, const uint8_t *v, size_t n);
+	void (*deinterleave)(uint8_t *u, uint8_t *v, const uint8_t *src, size_t n);
+	// Rounded average of 2 rows.
+	void (*average)(uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t n);
+	// dst = (t + 1 + (t >> 8)) >> 8 where t = src * mul + add, which is a rounded division by 255.
+	void (*scale255)(uint8_t *dst, const uint8_t *src, size_t n, uint16_t mul, uint16_t add);
+	// Keep the most significant byte of 16-bit samples.
+	void (*narrow16)(uint8_t *dst, const uint16_t *src, size_t n);
+	// `u` and `v` are horizontally subsampled by 2.
+	void (*yuvToRGB)(uint8_t *dst, const uint8_t *y, const uint8_t *u, const uint8_t *v, size_t n, const RGBMatrix &m, RGBLayout layout);
+};
+
+namespace scalar
+{
+
+void interleave(uint8_t *dst, const uint8_t *u, const uint8_t *v, size_t n);
+void deinterleave(uint8_t *u, uint8_t *v, const uint8_t *src, size_t n);
+void average(uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t n);
+void scale255(uint8_t *dst, const uint8_t *src, size_t n, uint16_t mul, uint16_t add);
+void narrow16(uint8_t *dst, const uint16_t *src, size_t n);
+void yuvToRGB(uint8_t *dst, const uint8_t *y, const uint8_t *u, const uint8_t *v, size_t n, const RGBMatrix &m, RGBLayout layout);
+
+}
+
+// These return nullptr if the kernel set isn't compiled for the target architecture.
+const PixelKernels *getSSE2PixelKernels() noexcept;
+const PixelKernels *getAVX2PixelKernels() noexcept;
+const PixelKernels *getNEONPixelKernels() noexcept;
+
+}
+
+#endif /* _NAV_PIXEL_KERNELS_HPP_ */
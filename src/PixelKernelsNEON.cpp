@@ -0,0 +1,186 @@
+#include "PixelKernels.hpp"
+#include "CPUFeatures.hpp"
+
+#ifdef NAV_CPU_NEON
+
+#include <arm_neon.h>
+
+namespace nav
+{
+
+namespace neon
+{
+
+static void interleave(uint8_t *dst, const uint8_t *u, const uint8_t *v, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16)
+	{
+		uint8x16x2_t uv = {{vld1q_u8(u + i), vld1q_u8(v + i)}};
+		vst2q_u8(dst + i * 2, uv);
+	}
+
+	scalar::interleave(dst + i * 2, u + i, v + i, n - i);
+}
+
+static void deinterleave(uint8_t *u, uint8_t *v, const uint8_t *src, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16)
+	{
+		uint8x16x2_t uv = vld2q_u8(src + i * 2);
+		vst1q_u8(u + i, uv.val[0]);
+		vst1q_u8(v + i, uv.val[1]);
+	}
+
+	scalar::deinterleave(u + i, v + i, src + i * 2, n - i);
+}
+
+static void average(uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16)
+		vst1q_u8(dst + i, vrhaddq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+
+	scalar::average(dst + i, a + i, b + i, n - i);
+}
+
+static inline uint8x8_t divide255(uint8x8_t x, uint16_t mul, uint16_t add)
+{
+	uint16x8_t t = vmlaq_n_u16(vdupq_n_u16(add), vmovl_u8(x), mul);
+	return vmovn_u16(vshrq_n_u16(vaddq_u16(vaddq_u16(t, vdupq_n_u16(1)), vshrq_n_u16(t, 8)), 8));
+}
+
+static void scale255(uint8_t *dst, const uint8_t *src, size_t n, uint16_t mul, uint16_t add)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16)
+	{
+		uint8x16_t x = vld1q_u8(src + i);
+		vst1q_u8(dst + i, vcombine_u8(divide255(vget_low_u8(x), mul, add), divide255(vget_high_u8(x), mul, add)));
+	}
+
+	scalar::scale255(dst + i, src + i, n - i, mul, add);
+}
+
+static void narrow16(uint8_t *dst, const uint16_t *src, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16)
+		vst1q_u8(dst + i, vcombine_u8(vshrn_n_u16(vld1q_u16(src + i), 8), vshrn_n_u16(vld1q_u16(src + i + 8), 8)));
+
+	scalar::narrow16(dst + i, src + i, n - i);
+}
+
+// 8 pixels in 16-bit lanes.
+static inline void yuvToRGB8(uint8x8_t y, uint8x8_t u, uint8x8_t v, const RGBMatrix &m, uint8x8_t &r, uint8x8_t &g, uint8x8_t &b)
+{
+	const int16x8_t bias = vdupq_n_s16(128);
+	const int16x8_t round = vdupq_n_s16(32);
+	int16x8_t yy = vmulq_n_s16(vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(y)), vdupq_n_s16(m.yOffset)), m.yMul);
+	int16x8_t uu = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(u)), bias);
+	int16x8_t vv = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(v)), bias);
+
+	int16x8_t r16 = vqaddq_s16(yy, vmulq_n_s16(vv, m.vr));
+	int16x8_t g16 = vqsubq_s16(vqsubq_s16(yy, vmulq_n_s16(uu, m.ug)), vmulq_n_s16(vv, m.vg));
+	int16x8_t b16 = vqaddq_s16(yy, vmulq_n_s16(uu, m.ub));
+
+	r = vqmovun_s16(vshrq_n_s16(vqaddq_s16(r16, round), 6));
+	g = vqmovun_s16(vshrq_n_s16(vqaddq_s16(g16, round), 6));
+	b = vqmovun_s16(vshrq_n_s16(vqaddq_s16(b16, round), 6));
+}
+
+static void yuvToRGB(
+	uint8_t *dst,
+	const uint8_t *y,
+	const uint8_t *u,
+	const uint8_t *v,
+	size_t n,
+	const RGBMatrix &matrix,
+	RGBLayout layout
+)
+{
+	const uint8x16_t alpha = vdupq_n_u8(255);
+	size_t bpp = layout == RGBLayout::RGB ? 3 : 4;
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16)
+	{
+		uint8x16_t y8 = vld1q_u8(y + i);
+		uint8x8_t u8 = vld1_u8(u + i / 2);
+		uint8x8_t v8 = vld1_u8(v + i / 2);
+		uint8x8x2_t uu = vzip_u8(u8, u8);
+		uint8x8x2_t vv = vzip_u8(v8, v8);
+
+		uint8x8_t rl, gl, bl, rh, gh, bh;
+		yuvToRGB8(vget_low_u8(y8), uu.val[0], vv.val[0], matrix, rl, gl, bl);
+		yuvToRGB8(vget_high_u8(y8), uu.val[1], vv.val[1], matrix, rh, gh, bh);
+
+		uint8x16_t r = vcombine_u8(rl, rh);
+		uint8x16_t g = vcombine_u8(gl, gh);
+		uint8x16_t b = vcombine_u8(bl, bh);
+		uint8_t *out = dst + i * bpp;
+
+		switch (layout)
+		{
+			case RGBLayout::RGB:
+			{
+				uint8x16x3_t rgb = {{r, g, b}};
+				vst3q_u8(out, rgb);
+				break;
+			}
+			case RGBLayout::RGBA:
+			{
+				uint8x16x4_t rgba = {{r, g, b, alpha}};
+				vst4q_u8(out, rgba);
+				break;
+			}
+			case RGBLayout::BGRA:
+			{
+				uint8x16x4_t bgra = {{b, g, r, alpha}};
+				vst4q_u8(out, bgra);
+				break;
+			}
+		}
+	}
+
+	scalar::yuvToRGB(dst + i * bpp, y + i, u + i / 2, v + i / 2, n - i, matrix, layout);
+}
+
+}
+
+static const PixelKernels NEON_KERNELS = {
+	"neon",
+	neon::interleave,
+	neon::deinterleave,
+	neon::average,
+	neon::scale255,
+	neon::narrow16,
+	neon::yuvToRGB
+};
+
+const PixelKernels *getNEONPixelKernels() noexcept
+{
+	return &NEON_KERNELS;
+}
+
+}
+
+#else
+
+namespace nav
+{
+
+const PixelKernels *getNEONPixelKernels() noexcept
+{
+	return nullptr;
+}
+
+}
+
+#endif /* NAV_CPU_NEON */
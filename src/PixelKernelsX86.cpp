@@ -0,0 +1,432 @@
+#include "PixelKernels.hpp"
+#include "CPUFeatures.hpp"
+
+#ifdef NAV_CPU_X86
+
+#include <cstring>
+#include <immintrin.h>
+
+namespace nav
+{
+
+namespace sse2
+{
+
+NAV_TARGET_SSE2 static void interleave(uint8_t *dst, const uint8_t *u, const uint8_t *v, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*) (u + i));
+		__m128i b = _mm_loadu_si128((const __m128i*) (v + i));
+		_mm_storeu_si128((__m128i*) (dst + i * 2), _mm_unpacklo_epi8(a, b));
+		_mm_storeu_si128((__m128i*) (dst + i * 2 + 16), _mm_unpackhi_epi8(a, b));
+	}
+
+	scalar::interleave(dst + i * 2, u + i, v + i, n - i);
+}
+
+NAV_TARGET_SSE2 static void deinterleave(uint8_t *u, uint8_t *v, const uint8_t *src, size_t n)
+{
+	const __m128i mask = _mm_set1_epi16(0x00FF);
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*) (src + i * 2));
+		__m128i b = _mm_loadu_si128((const __m128i*) (src + i * 2 + 16));
+		_mm_storeu_si128((__m128i*) (u + i), _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+		_mm_storeu_si128((__m128i*) (v + i), _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+	}
+
+	scalar::deinterleave(u + i, v + i, src + i * 2, n - i);
+}
+
+NAV_TARGET_SSE2 static void average(uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i*) (a + i));
+		__m128i y = _mm_loadu_si128((const __m128i*) (b + i));
+		_mm_storeu_si128((__m128i*) (dst + i), _mm_avg_epu8(x, y));
+	}
+
+	scalar::average(dst + i, a + i, b + i, n - i);
+}
+
+NAV_TARGET_SSE2 static inline __m128i divide255(__m128i x, __m128i mul, __m128i add)
+{
+	__m128i t = _mm_add_epi16(_mm_mullo_epi16(x, mul), add);
+	return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(t, _mm_set1_epi16(1)), _mm_srli_epi16(t, 8)), 8);
+}
+
+NAV_TARGET_SSE2 static void scale255(uint8_t *dst, const uint8_t *src, size_t n, uint16_t mul, uint16_t add)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i vmul = _mm_set1_epi16((short) mul);
+	const __m128i vadd = _mm_set1_epi16((short) add);
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i*) (src + i));
+		__m128i lo = divide255(_mm_unpacklo_epi8(x, zero), vmul, vadd);
+		__m128i hi = divide255(_mm_unpackhi_epi8(x, zero), vmul, vadd);
+		_mm_storeu_si128((__m128i*) (dst + i), _mm_packus_epi16(lo, hi));
+	}
+
+	scalar::scale255(dst + i, src + i, n - i, mul, add);
+}
+
+NAV_TARGET_SSE2 static void narrow16(uint8_t *dst, const uint16_t *src, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*) (src + i));
+		__m128i b = _mm_loadu_si128((const __m128i*) (src + i + 8));
+		_mm_storeu_si128((__m128i*) (dst + i), _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+	}
+
+	scalar::narrow16(dst + i, src + i, n - i);
+}
+
+struct Matrix
+{
+	__m128i yOffset, yMul, vr, ug, vg, ub, round, bias;
+
+	NAV_TARGET_SSE2 Matrix(const RGBMatrix &m)
+	: yOffset(_mm_set1_epi16(m.yOffset))
+	, yMul(_mm_set1_epi16(m.yMul))
+	, vr(_mm_set1_epi16(m.vr))
+	, ug(_mm_set1_epi16(m.ug))
+	, vg(_mm_set1_epi16(m.vg))
+	, ub(_mm_set1_epi16(m.ub))
+	, round(_mm_set1_epi16(32))
+	, bias(_mm_set1_epi16(128))
+	{}
+};
+
+// 8 pixels in 16-bit lanes.
+NAV_TARGET_SSE2 static inline void yuvToRGB8(__m128i y, __m128i u, __m128i v, const Matrix &m, __m128i &r, __m128i &g, __m128i &b)
+{
+	__m128i yy = _mm_mullo_epi16(_mm_sub_epi16(y, m.yOffset), m.yMul);
+	__m128i uu = _mm_sub_epi16(u, m.bias);
+	__m128i vv = _mm_sub_epi16(v, m.bias);
+
+	r = _mm_adds_epi16(yy, _mm_mullo_epi16(vv, m.vr));
+	g = _mm_subs_epi16(_mm_subs_epi16(yy, _mm_mullo_epi16(uu, m.ug)), _mm_mullo_epi16(vv, m.vg));
+	b = _mm_adds_epi16(yy, _mm_mullo_epi16(uu, m.ub));
+
+	r = _mm_srai_epi16(_mm_adds_epi16(r, m.round), 6);
+	g = _mm_srai_epi16(_mm_adds_epi16(g, m.round), 6);
+	b = _mm_srai_epi16(_mm_adds_epi16(b, m.round), 6);
+}
+
+// Store 16 pixels of 4 channels.
+NAV_TARGET_SSE2 static inline void store4(uint8_t *dst, __m128i c0, __m128i c1, __m128i c2, __m128i c3)
+{
+	__m128i lo01 = _mm_unpacklo_epi8(c0, c1), hi01 = _mm_unpackhi_epi8(c0, c1);
+	__m128i lo23 = _mm_unpacklo_epi8(c2, c3), hi23 = _mm_unpackhi_epi8(c2, c3);
+	_mm_storeu_si128((__m128i*) dst, _mm_unpacklo_epi16(lo01, lo23));
+	_mm_storeu_si128((__m128i*) (dst + 16), _mm_unpackhi_epi16(lo01, lo23));
+	_mm_storeu_si128((__m128i*) (dst + 32), _mm_unpacklo_epi16(hi01, hi23));
+	_mm_storeu_si128((__m128i*) (dst + 48), _mm_unpackhi_epi16(hi01, hi23));
+}
+
+NAV_TARGET_SSE2 static void yuvToRGB(
+	uint8_t *dst,
+	const uint8_t *y,
+	const uint8_t *u,
+	const uint8_t *v,
+	size_t n,
+	const RGBMatrix &matrix,
+	RGBLayout layout
+)
+{
+	const Matrix m(matrix);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alpha = _mm_set1_epi8((char) 255);
+	size_t bpp = layout == RGBLayout::RGB ? 3 : 4;
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16)
+	{
+		__m128i y8 = _mm_loadu_si128((const __m128i*) (y + i));
+		__m128i u8 = _mm_loadl_epi64((const __m128i*) (u + i / 2));
+		__m128i v8 = _mm_loadl_epi64((const __m128i*) (v + i / 2));
+		u8 = _mm_unpacklo_epi8(u8, u8);
+		v8 = _mm_unpacklo_epi8(v8, v8);
+
+		__m128i rl, gl, bl, rh, gh, bh;
+		yuvToRGB8(_mm_unpacklo_epi8(y8, zero), _mm_unpacklo_epi8(u8, zero), _mm_unpacklo_epi8(v8, zero), m, rl, gl, bl);
+		yuvToRGB8(_mm_unpackhi_epi8(y8, zero), _mm_unpackhi_epi8(u8, zero), _mm_unpackhi_epi8(v8, zero), m, rh, gh, bh);
+
+		__m128i r = _mm_packus_epi16(rl, rh);
+		__m128i g = _mm_packus_epi16(gl, gh);
+		__m128i b = _mm_packus_epi16(bl, bh);
+		uint8_t *out = dst + i * bpp;
+
+		switch (layout)
+		{
+			case RGBLayout::RGB:
+			{
+				// No byte shuffle in SSE2.
+				alignas(16) uint8_t rgb[3][16];
+				_mm_store_si128((__m128i*) rgb[0], r);
+				_mm_store_si128((__m128i*) rgb[1], g);
+				_mm_store_si128((__m128i*) rgb[2], b);
+
+				for (size_t j = 0; j < 16; j++)
+				{
+					out[j * 3] = rgb[0][j];
+					out[j * 3 + 1] = rgb[1][j];
+					out[j * 3 + 2] = rgb[2][j];
+				}
+
+				break;
+			}
+			case RGBLayout::RGBA:
+				store4(out, r, g, b, alpha);
+				break;
+			case RGBLayout::BGRA:
+				store4(out, b, g, r, alpha);
+				break;
+		}
+	}
+
+	scalar::yuvToRGB(dst + i * bpp, y + i, u + i / 2, v + i / 2, n - i, matrix, layout);
+}
+
+}
+
+namespace avx2
+{
+
+NAV_TARGET_AVX2 static void interleave(uint8_t *dst, const uint8_t *u, const uint8_t *v, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 32 <= n; i += 32)
+	{
+		__m256i a = _mm256_loadu_si256((const __m256i*) (u + i));
+		__m256i b = _mm256_loadu_si256((const __m256i*) (v + i));
+		__m256i lo = _mm256_unpacklo_epi8(a, b);
+		__m256i hi = _mm256_unpackhi_epi8(a, b);
+		_mm256_storeu_si256((__m256i*) (dst + i * 2), _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i*) (dst + i * 2 + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+
+	sse2::interleave(dst + i * 2, u + i, v + i, n - i);
+}
+
+NAV_TARGET_AVX2 static void deinterleave(uint8_t *u, uint8_t *v, const uint8_t *src, size_t n)
+{
+	const __m256i mask = _mm256_set1_epi16(0x00FF);
+	size_t i = 0;
+
+	for (; i + 32 <= n; i += 32)
+	{
+		__m256i a = _mm256_loadu_si256((const __m256i*) (src + i * 2));
+		__m256i b = _mm256_loadu_si256((const __m256i*) (src + i * 2 + 32));
+		__m256i ue = _mm256_packus_epi16(_mm256_and_si256(a, mask), _mm256_and_si256(b, mask));
+		__m256i ve = _mm256_packus_epi16(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+		// Pack works per 128-bit lane.
+		_mm256_storeu_si256((__m256i*) (u + i), _mm256_permute4x64_epi64(ue, 0xD8));
+		_mm256_storeu_si256((__m256i*) (v + i), _mm256_permute4x64_epi64(ve, 0xD8));
+	}
+
+	sse2::deinterleave(u + i, v + i, src + i * 2, n - i);
+}
+
+NAV_TARGET_AVX2 static void average(uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 32 <= n; i += 32)
+	{
+		__m256i x = _mm256_loadu_si256((const __m256i*) (a + i));
+		__m256i y = _mm256_loadu_si256((const __m256i*) (b + i));
+		_mm256_storeu_si256((__m256i*) (dst + i), _mm256_avg_epu8(x, y));
+	}
+
+	sse2::average(dst + i, a + i, b + i, n - i);
+}
+
+NAV_TARGET_AVX2 static inline __m256i divide255(__m256i x, __m256i mul, __m256i add)
+{
+	__m256i t = _mm256_add_epi16(_mm256_mullo_epi16(x, mul), add);
+	return _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(t, _mm256_set1_epi16(1)), _mm256_srli_epi16(t, 8)), 8);
+}
+
+NAV_TARGET_AVX2 static void scale255(uint8_t *dst, const uint8_t *src, size_t n, uint16_t mul, uint16_t add)
+{
+	const __m256i vmul = _mm256_set1_epi16((short) mul);
+	const __m256i vadd = _mm256_set1_epi16((short) add);
+	size_t i = 0;
+
+	for (; i + 32 <= n; i += 32)
+	{
+		__m256i lo = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (src + i)));
+		__m256i hi = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (src + i + 16)));
+		__m256i packed = _mm256_packus_epi16(divide255(lo, vmul, vadd), divide255(hi, vmul, vadd));
+		_mm256_storeu_si256((__m256i*) (dst + i), _mm256_permute4x64_epi64(packed, 0xD8));
+	}
+
+	sse2::scale255(dst + i, src + i, n - i, mul, add);
+}
+
+NAV_TARGET_AVX2 static void narrow16(uint8_t *dst, const uint16_t *src, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 32 <= n; i += 32)
+	{
+		__m256i a = _mm256_loadu_si256((const __m256i*) (src + i));
+		__m256i b = _mm256_loadu_si256((const __m256i*) (src + i + 16));
+		__m256i packed = _mm256_packus_epi16(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+		_mm256_storeu_si256((__m256i*) (dst + i), _mm256_permute4x64_epi64(packed, 0xD8));
+	}
+
+	sse2::narrow16(dst + i, src + i, n - i);
+}
+
+NAV_TARGET_AVX2 static inline __m128i packTo8(__m256i x)
+{
+	return _mm_packus_epi16(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+}
+
+// Store 4 RGBA pixels as RGB.
+NAV_TARGET_AVX2 static inline void storeRGB4(uint8_t *dst, __m128i rgba)
+{
+	const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	__m128i rgb = _mm_shuffle_epi8(rgba, shuffle);
+	uint32_t last = (uint32_t) _mm_cvtsi128_si32(_mm_srli_si128(rgb, 8));
+	_mm_storel_epi64((__m128i*) dst, rgb);
+	memcpy(dst + 8, &last, sizeof(uint32_t));
+}
+
+NAV_TARGET_AVX2 static void yuvToRGB(
+	uint8_t *dst,
+	const uint8_t *y,
+	const uint8_t *u,
+	const uint8_t *v,
+	size_t n,
+	const RGBMatrix &matrix,
+	RGBLayout layout
+)
+{
+	const __m256i yOffset = _mm256_set1_epi16(matrix.yOffset);
+	const __m256i yMul = _mm256_set1_epi16(matrix.yMul);
+	const __m256i vr = _mm256_set1_epi16(matrix.vr);
+	const __m256i ug = _mm256_set1_epi16(matrix.ug);
+	const __m256i vg = _mm256_set1_epi16(matrix.vg);
+	const __m256i ub = _mm256_set1_epi16(matrix.ub);
+	const __m256i round = _mm256_set1_epi16(32);
+	const __m256i bias = _mm256_set1_epi16(128);
+	const __m128i alpha = _mm_set1_epi8((char) 255);
+	size_t bpp = layout == RGBLayout::RGB ? 3 : 4;
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16)
+	{
+		__m128i u8 = _mm_loadl_epi64((const __m128i*) (u + i / 2));
+		__m128i v8 = _mm_loadl_epi64((const __m128i*) (v + i / 2));
+		__m256i yy = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (y + i)));
+		__m256i uu = _mm256_cvtepu8_epi16(_mm_unpacklo_epi8(u8, u8));
+		__m256i vv = _mm256_cvtepu8_epi16(_mm_unpacklo_epi8(v8, v8));
+
+		yy = _mm256_mullo_epi16(_mm256_sub_epi16(yy, yOffset), yMul);
+		uu = _mm256_sub_epi16(uu, bias);
+		vv = _mm256_sub_epi16(vv, bias);
+
+		__m256i r = _mm256_adds_epi16(yy, _mm256_mullo_epi16(vv, vr));
+		__m256i g = _mm256_subs_epi16(_mm256_subs_epi16(yy, _mm256_mullo_epi16(uu, ug)), _mm256_mullo_epi16(vv, vg));
+		__m256i b = _mm256_adds_epi16(yy, _mm256_mullo_epi16(uu, ub));
+
+		__m128i r8 = packTo8(_mm256_srai_epi16(_mm256_adds_epi16(r, round), 6));
+		__m128i g8 = packTo8(_mm256_srai_epi16(_mm256_adds_epi16(g, round), 6));
+		__m128i b8 = packTo8(_mm256_srai_epi16(_mm256_adds_epi16(b, round), 6));
+		uint8_t *out = dst + i * bpp;
+
+		switch (layout)
+		{
+			case RGBLayout::RGB:
+			{
+				__m128i rg = _mm_unpacklo_epi8(r8, g8), ba = _mm_unpacklo_epi8(b8, alpha);
+				storeRGB4(out, _mm_unpacklo_epi16(rg, ba));
+				storeRGB4(out + 12, _mm_unpackhi_epi16(rg, ba));
+				rg = _mm_unpackhi_epi8(r8, g8);
+				ba = _mm_unpackhi_epi8(b8, alpha);
+				storeRGB4(out + 24, _mm_unpacklo_epi16(rg, ba));
+				storeRGB4(out + 36, _mm_unpackhi_epi16(rg, ba));
+				break;
+			}
+			case RGBLayout::RGBA:
+				sse2::store4(out, r8, g8, b8, alpha);
+				break;
+			case RGBLayout::BGRA:
+				sse2::store4(out, b8, g8, r8, alpha);
+				break;
+		}
+	}
+
+	scalar::yuvToRGB(dst + i * bpp, y + i, u + i / 2, v + i / 2, n - i, matrix, layout);
+}
+
+}
+
+static const PixelKernels SSE2_KERNELS = {
+	"sse2",
+	sse2::interleave,
+	sse2::deinterleave,
+	sse2::average,
+	sse2::scale255,
+	sse2::narrow16,
+	sse2::yuvToRGB
+};
+
+static const PixelKernels AVX2_KERNELS = {
+	"avx2",
+	avx2::interleave,
+	avx2::deinterleave,
+	avx2::average,
+	avx2::scale255,
+	avx2::narrow16,
+	avx2::yuvToRGB
+};
+
+const PixelKernels *getSSE2PixelKernels() noexcept
+{
+	return &SSE2_KERNELS;
+}
+
+const PixelKernels *getAVX2PixelKernels() noexcept
+{
+	return &AVX2_KERNELS;
+}
+
+}
+
+#else
+
+namespace nav
+{
+
+const PixelKernels *getSSE2PixelKernels() noexcept
+{
+	return nullptr;
+}
+
+const PixelKernels *getAVX2PixelKernels() noexcept
+{
+	return nullptr;
+}
+
+}
+
+#endif /* NAV_CPU_X86 */
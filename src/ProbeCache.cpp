@@ -0,0 +1,325 @@
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "ProbeCache.hpp"
+#include "Common.hpp"
+
+namespace nav
+{
+
+static constexpr char MAGIC[8] = {'N', 'A', 'V', 'P', 'R', 'O', 'B', 'E'};
+static constexpr uint32_t FILE_VERSION = 1;
+
+void ProbeWriter::writeBytes(const void *src, size_t size)
+{
+	const uint8_t *bytes = (const uint8_t*) src;
+	data.insert(data.end(), bytes, bytes + size);
+}
+
+void ProbeWriter::writeString(const std::string &str)
+{
+	write<uint32_t>((uint32_t) str.size());
+	writeBytes(str.data(), str.size());
+}
+
+ProbeReader::ProbeReader(const std::vector<uint8_t> &data) noexcept
+: data(data)
+, pos(0)
+{}
+
+const uint8_t *ProbeReader::readBytes(size_t size)
+{
+	if (size > data.size() - pos)
+		throw std::runtime_error("Truncated probe data");
+
+	const uint8_t *result = data.data() + pos;
+	pos += size;
+	return result;
+}
+
+std::string ProbeReader::readString()
+{
+	uint32_t size = read<uint32_t>();
+	const uint8_t *str = readBytes(size);
+	return std::string((const char*) str, size);
+}
+
+bool ProbeReader::atEnd() const noexcept
+{
+	return pos == data.size();
+}
+
+static FILE *openFile(const std::string &path, const char *mode)
+{
+#ifdef _WIN32
+	try
+	{
+		std::wstring widePath = fromUTF8(path);
+		std::wstring wideMode = fromUTF8(mode);
+		return _wfopen(widePath.c_str(), wideMode.c_str());
+	}
+	catch (const std::exception &)
+	{
+		return nullptr;
+	}
+#else
+	return fopen(path.c_str(), mode);
+#endif
+}
+
+static bool replaceFile(const std::string &from, const std::string &to)
+{
+#ifdef _WIN32
+	try
+	{
+		return MoveFileExW(fromUTF8(from).c_str(), fromUTF8(to).c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+	}
+	catch (const std::exception &)
+	{
+		return false;
+	}
+#else
+	return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+static void removeFile(const std::string &path)
+{
+#ifdef _WIN32
+	try
+	{
+		_wremove(fromUTF8(path).c_str());
+	}
+	catch (const std::exception &)
+	{}
+#else
+	std::remove(path.c_str());
+#endif
+}
+
+ProbeCache::ProbeCache()
+: mutex()
+, entries()
+, order()
+, directory()
+{}
+
+bool ProbeCache::find(const std::string &key, Entry &entry)
+{
+	std::string path;
+
+	{
+		std::lock_guard lg(mutex);
+		auto it = entries.find(key);
+
+		if (it != entries.end())
+		{
+			entry = it->second;
+			return true;
+		}
+
+		if (directory.empty())
+			return false;
+
+		path = getPath(key);
+	}
+
+	// Disk access is done without the lock.
+	if (!load(path, key, entry))
+		return false;
+
+	std::lock_guard lg(mutex);
+	insert(key, entry);
+	return true;
+}
+
+void ProbeCache::store(const std::string &key, const Entry &entry)
+{
+	std::string path;
+
+	{
+		std::lock_guard lg(mutex);
+		insert(key, entry);
+
+		if (directory.empty())
+			return;
+
+		path = getPath(key);
+	}
+
+	save(path, key, entry);
+}
+
+void ProbeCache::setDirectory(const std::string &dir)
+{
+	std::lock_guard lg(mutex);
+	directory = dir;
+}
+
+void ProbeCache::clear()
+{
+	std::lock_guard lg(mutex);
+	entries.clear();
+	order.clear();
+}
+
+std::string ProbeCache::makeFileKey(const char *filename, uint64_t size)
+{
+	if (filename == nullptr)
+		return std::string();
+
+	std::stringstream key;
+
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+
+	try
+	{
+		if (!GetFileAttributesExW(fromUTF8(filename).c_str(), GetFileExInfoStandard, &attributes))
+			return std::string();
+	}
+	catch (const std::exception &)
+	{
+		return std::string();
+	}
+
+	uint64_t fileSize = (uint64_t(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+	uint64_t mtime = (uint64_t(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+
+	if ((attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || fileSize != size)
+		return std::string();
+
+	key << "file:" << filename;
+#else
+	struct stat st;
+	if (stat(filename, &st) != 0 || !S_ISREG(st.st_mode) || (uint64_t) st.st_size != size)
+		return std::string();
+
+#ifdef __APPLE__
+	int64_t mtime = int64_t(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+	int64_t mtime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+
+	// Same file through a different relative path shares the entry.
+	char *resolved = realpath(filename, nullptr);
+	key << "file:" << (resolved ? resolved : filename);
+	free(resolved);
+#endif /* _WIN32 */
+
+	key << "\n" << size << "\n" << mtime;
+	return key.str();
+}
+
+void ProbeCache::insert(const std::string &key, const Entry &entry)
+{
+	auto it = entries.find(key);
+
+	if (it != entries.end())
+	{
+		it->second = entry;
+		return;
+	}
+
+	if (entries.size() >= MAX_ENTRIES)
+	{
+		entries.erase(order.front());
+		order.pop_front();
+	}
+
+	entries.emplace(key, entry);
+	order.push_back(key);
+}
+
+std::string ProbeCache::getPath(const std::string &key) const
+{
+	// 64-bit FNV-1a. Collisions are caught by the key stored in the file.
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (char c: key)
+		hash = (hash ^ (uint8_t) c) * 0x100000001b3ULL;
+
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.navprobe", (unsigned long long) hash);
+	return directory + "/" + name;
+}
+
+bool ProbeCache::load(const std::string &path, const std::string &key, Entry &entry) const
+{
+	FILE *f = openFile(path, "rb");
+	if (!f)
+		return false;
+
+	std::vector<uint8_t> contents;
+	uint8_t buf[4096];
+
+	for (size_t readed = fread(buf, 1, sizeof(buf), f); readed > 0; readed = fread(buf, 1, sizeof(buf), f))
+		contents.insert(contents.end(), buf, buf + readed);
+
+	fclose(f);
+
+	try
+	{
+		ProbeReader reader(contents);
+
+		if (std::memcmp(reader.readBytes(sizeof(MAGIC)), MAGIC, sizeof(MAGIC)) != 0)
+			return false;
+		if (reader.read<uint32_t>() != FILE_VERSION)
+			return false;
+		if (reader.readString() != key)
+			return false;
+
+		Entry result;
+		result.backend = reader.readString();
+		uint32_t size = reader.read<uint32_t>();
+		const uint8_t *data = reader.readBytes(size);
+		result.data.assign(data, data + size);
+
+		if (!reader.atEnd())
+			return false;
+
+		entry = std::move(result);
+		return true;
+	}
+	catch (const std::exception &)
+	{
+		return false;
+	}
+}
+
+void ProbeCache::save(const std::string &path, const std::string &key, const Entry &entry) const
+{
+	ProbeWriter writer;
+	writer.writeBytes(MAGIC, sizeof(MAGIC));
+	writer.write<uint32_t>(FILE_VERSION);
+	writer.writeString(key);
+	writer.writeString(entry.backend);
+	writer.write<uint32_t>((uint32_t) entry.data.size());
+	writer.writeBytes(entry.data.data(), entry.data.size());
+
+	// Written to a temporary file first, so concurrent readers never see a partial file.
+	std::stringstream temp;
+	temp << path << "." << std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp";
+	std::string tempPath = temp.str();
+
+	FILE *f = openFile(tempPath, "wb");
+	if (!f)
+		return;
+
+	bool ok = fwrite(writer.data.data(), 1, writer.data.size(), f) == writer.data.size();
+	ok = fclose(f) == 0 && ok;
+
+	if (!ok || !replaceFile(tempPath, path))
+		removeFile(tempPath);
+}
+
+}
@@ -0,0 +1,96 @@
+#ifndef _NAV_PROBE_CACHE_HPP_
+#define _NAV_PROBE_CACHE_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace nav
+{
+
+// Serializes backend probe data. Values are stored in native byte order, as the cache never leaves the machine.
+class ProbeWriter
+{
+public:
+	template<typename T>
+	void write(T value)
+	{
+		writeBytes(&value, sizeof(T));
+	}
+
+	void writeBytes(const void *src, size_t size);
+	void writeString(const std::string &str);
+
+	std::vector<uint8_t> data;
+};
+
+// Counterpart of ProbeWriter. Throws std::runtime_error on truncated data.
+class ProbeReader
+{
+public:
+	ProbeReader(const std::vector<uint8_t> &data) noexcept;
+
+	template<typename T>
+	T read()
+	{
+		T value;
+		std::memcpy(&value, readBytes(sizeof(T)), sizeof(T));
+		return value;
+	}
+
+	const uint8_t *readBytes(size_t size);
+	std::string readString();
+	bool atEnd() const noexcept;
+
+private:
+	const std::vector<uint8_t> &data;
+	size_t pos;
+};
+
+// Remembers which backend opened an input, along with backend-specific data that lets it skip most of the probing the
+// next time. Entries live in memory and, if a directory is set, on disk.
+class ProbeCache
+{
+public:
+	static constexpr size_t MAX_ENTRIES = 256;
+
+	struct Entry
+	{
+		std::string backend;
+		std::vector<uint8_t> data;
+	};
+
+	ProbeCache();
+	ProbeCache(const ProbeCache &) = delete;
+	bool find(const std::string &key, Entry &entry);
+	void store(const std::string &key, const Entry &entry);
+	// Empty string disables the on-disk cache.
+	void setDirectory(const std::string &dir);
+	// Only forgets the in-memory entries.
+	void clear();
+
+	// Key made of the path, size and modification time of `filename`. Empty if `filename` is not an existing file of
+	// `size` bytes, as it's only a hint of the input.
+	static std::string makeFileKey(const char *filename, uint64_t size);
+
+private:
+	void insert(const std::string &key, const Entry &entry);
+	std::string getPath(const std::string &key) const;
+	bool load(const std::string &path, const std::string &key, Entry &entry) const;
+	void save(const std::string &path, const std::string &key, const Entry &entry) const;
+
+	std::mutex mutex;
+	std::unordered_map<std::string, Entry> entries;
+	// Insertion order, for eviction.
+	std::deque<std::string> order;
+	std::string directory;
+};
+
+}
+
+#endif /* _NAV_PROBE_CACHE_HPP_ */
@@ -0,0 +1,282 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include "Sniffer.hpp"
+
+namespace nav
+{
+
+// Enough to find the second frame of the largest MPEG audio frames.
+static constexpr size_t HEAD_SIZE = 4096;
+
+static size_t readHead(nav_input *input, uint64_t offset, uint8_t *dest, size_t size)
+{
+	size_t total = 0;
+
+	if (input->canReadAt())
+	{
+		while (total < size)
+		{
+			size_t readed = input->readAtf(offset + total, dest + total, size - total);
+			if (readed == 0)
+				break;
+
+			total += readed;
+		}
+
+		return total;
+	}
+
+	uint64_t pos = input->tellf();
+
+	if (input->seekf(offset))
+	{
+		while (total < size)
+		{
+			size_t readed = input->readf(dest + total, size - total);
+			if (readed == 0)
+				break;
+
+			total += readed;
+		}
+	}
+
+	input->seekf(pos);
+	return total;
+}
+
+// Returns the size of the MPEG audio frame starting at `h`, or 0 if it's not a valid frame header.
+static size_t getMPEGAudioFrameSize(const uint8_t *h)
+{
+	static constexpr uint16_t BITRATES[5][15] = {
+		{0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448}, // V1 L1
+		{0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384}, // V1 L2
+		{0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320}, // V1 L3
+		{0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256}, // V2 L1
+		{0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160}, // V2 L2 & L3
+	};
+	static constexpr uint32_t SAMPLE_RATES[3] = {44100, 48000, 32000};
+
+	if (h[0] != 0xFF || (h[1] & 0xE0) != 0xE0)
+		return 0;
+
+	uint32_t version = (h[1] >> 3) & 3; // 0 = 2.5, 2 = 2, 3 = 1
+	uint32_t layer = 4 - ((h[1] >> 1) & 3);
+	uint32_t bitrateIndex = h[2] >> 4;
+	uint32_t rateIndex = (h[2] >> 2) & 3;
+	uint32_t padding = (h[2] >> 1) & 1;
+
+	// Free format bitrate is valid, but its frame size can't be known from the header alone.
+	if (version == 1 || layer == 4 || bitrateIndex == 0 || bitrateIndex == 15 || rateIndex == 3)
+		return 0;
+
+	bool v1 = version == 3;
+	uint32_t bitrate = BITRATES[v1 ? layer - 1 : (layer == 1 ? 3 : 4)][bitrateIndex] * 1000;
+	uint32_t sampleRate = SAMPLE_RATES[rateIndex] >> (v1 ? 0 : (version == 2 ? 1 : 2));
+
+	if (layer == 1)
+		return (12 * bitrate / sampleRate + padding) * 4;
+	if (layer == 3 && !v1)
+		return 72 * bitrate / sampleRate + padding;
+	return 144 * bitrate / sampleRate + padding;
+}
+
+// Returns the size of the ADTS frame starting at `h`, or 0 if it's not a valid frame header.
+static size_t getADTSFrameSize(const uint8_t *h)
+{
+	if (h[0] != 0xFF || (h[1] & 0xF6) != 0xF0 || ((h[2] >> 2) & 0xF) >= 13)
+		return 0;
+
+	size_t size = (size_t(h[3] & 3) << 11) | (size_t(h[4]) << 3) | (h[5] >> 5);
+	return size >= 7 ? size : 0;
+}
+
+// Checks the frame at the start of `buf`. If `confirm` is set, the next frame must follow it too.
+static ContainerType sniffAudioFrame(const uint8_t *buf, size_t size, bool confirm)
+{
+	if (size < 6)
+		return ContainerType::UNKNOWN;
+
+	if (size_t frameSize = getADTSFrameSize(buf))
+	{
+		if (!confirm || (frameSize + 6 <= size && getADTSFrameSize(buf + frameSize)))
+			return ContainerType::ADTS;
+	}
+	else if (size_t frameSize = getMPEGAudioFrameSize(buf))
+	{
+		if (!confirm || (frameSize + 4 <= size && getMPEGAudioFrameSize(buf + frameSize)))
+			return ContainerType::MP3;
+	}
+
+	return ContainerType::UNKNOWN;
+}
+
+static bool isTSPackets(const uint8_t *buf, size_t size, size_t offset, size_t packetSize)
+{
+	for (size_t i = 0; i < 3; i++)
+	{
+		size_t pos = offset + i * packetSize;
+		if (pos >= size || buf[pos] != 0x47)
+			return false;
+	}
+
+	return true;
+}
+
+ContainerType sniffContainer(nav_input *input)
+{
+	static constexpr uint8_t MATROSKA_MAGIC[4] = {0x1A, 0x45, 0xDF, 0xA3};
+	static constexpr uint8_t MPEGPS_MAGIC[4] = {0x00, 0x00, 0x01, 0xBA};
+	static constexpr uint8_t ASF_MAGIC[16] = {
+		0x30, 0x26, 0xB2, 0x75, 0x8E, 0x66, 0xCF, 0x11, 0xA6, 0xD9, 0x00, 0xAA, 0x00, 0x62, 0xCE, 0x6C
+	};
+	static constexpr const char *ISOBMFF_BOXES[] = {"ftyp", "moov", "mdat", "free", "skip", "wide", "pnot"};
+
+	uint8_t buf[HEAD_SIZE];
+	size_t size = readHead(input, 0, buf, HEAD_SIZE);
+
+	if (size < 12)
+		return ContainerType::UNKNOWN;
+
+	if (std::memcmp(buf, MATROSKA_MAGIC, 4) == 0)
+		return ContainerType::MATROSKA;
+	if (std::memcmp(buf, "OggS", 4) == 0)
+		return ContainerType::OGG;
+	if (std::memcmp(buf, "fLaC", 4) == 0)
+		return ContainerType::FLAC;
+	if (std::memcmp(buf, MPEGPS_MAGIC, 4) == 0)
+		return ContainerType::MPEGPS;
+	if (std::memcmp(buf, "FLV\x01", 4) == 0)
+		return ContainerType::FLV;
+	if (size >= sizeof(ASF_MAGIC) && std::memcmp(buf, ASF_MAGIC, sizeof(ASF_MAGIC)) == 0)
+		return ContainerType::ASF;
+
+	if (std::memcmp(buf, "RIFF", 4) == 0)
+	{
+		if (std::memcmp(buf + 8, "WAVE", 4) == 0)
+			return ContainerType::WAVE;
+		if (std::memcmp(buf + 8, "AVI ", 4) == 0)
+			return ContainerType::AVI;
+	}
+	else if ((std::memcmp(buf, "RF64", 4) == 0 || std::memcmp(buf, "BW64", 4) == 0) && std::memcmp(buf + 8, "WAVE", 4) == 0)
+		return ContainerType::WAVE;
+
+	for (const char *box: ISOBMFF_BOXES)
+	{
+		if (std::memcmp(buf + 4, box, 4) == 0)
+			return ContainerType::ISOBMFF;
+	}
+
+	// Plain and M2TS (timecode-prefixed) transport streams.
+	if (isTSPackets(buf, size, 0, 188) || isTSPackets(buf, size, 4, 192))
+		return ContainerType::MPEGTS;
+
+	if (std::memcmp(buf, "ID3", 3) == 0)
+	{
+		// ID3v2 tag. Its size is a 28-bit syncsafe integer. The tag is followed by the actual stream.
+		uint64_t tagSize = 10
+			+ ((uint64_t(buf[6] & 0x7F) << 21) | (uint64_t(buf[7] & 0x7F) << 14) | ((buf[8] & 0x7F) << 7) | (buf[9] & 0x7F))
+			+ ((buf[5] & 0x10) ? 10 : 0);
+
+		size = readHead(input, tagSize, buf, HEAD_SIZE);
+		if (size >= 4 && std::memcmp(buf, "fLaC", 4) == 0)
+			return ContainerType::FLAC;
+
+		// The tag makes it unlikely to be anything else.
+		return sniffAudioFrame(buf, size, false);
+	}
+
+	// A lone sync word is too weak, so the next frame has to be there too.
+	return sniffAudioFrame(buf, size, true);
+}
+
+ContainerType containerFromExtension(const char *filename)
+{
+	static constexpr std::pair<const char*, ContainerType> EXTENSIONS[] = {
+		{"3g2", ContainerType::ISOBMFF},
+		{"3gp", ContainerType::ISOBMFF},
+		{"aac", ContainerType::ADTS},
+		{"asf", ContainerType::ASF},
+		{"avi", ContainerType::AVI},
+		{"flac", ContainerType::FLAC},
+		{"flv", ContainerType::FLV},
+		{"m2ts", ContainerType::MPEGTS},
+		{"m4a", ContainerType::ISOBMFF},
+		{"m4v", ContainerType::ISOBMFF},
+		{"mka", ContainerType::MATROSKA},
+		{"mkv", ContainerType::MATROSKA},
+		{"mov", ContainerType::ISOBMFF},
+		{"mp3", ContainerType::MP3},
+		{"mp4", ContainerType::ISOBMFF},
+		{"mpeg", ContainerType::MPEGPS},
+		{"mpg", ContainerType::MPEGPS},
+		{"mts", ContainerType::MPEGTS},
+		{"oga", ContainerType::OGG},
+		{"ogg", ContainerType::OGG},
+		{"ogv", ContainerType::OGG},
+		{"opus", ContainerType::OGG},
+		{"ts", ContainerType::MPEGTS},
+		{"vob", ContainerType::MPEGPS},
+		{"wav", ContainerType::WAVE},
+		{"webm", ContainerType::MATROSKA},
+		{"wma", ContainerType::ASF},
+		{"wmv", ContainerType::ASF},
+	};
+
+	if (filename == nullptr)
+		return ContainerType::UNKNOWN;
+
+	const char *dot = std::strrchr(filename, '.');
+	if (dot == nullptr || std::strpbrk(dot, "/\\") != nullptr)
+		return ContainerType::UNKNOWN;
+
+	std::string ext = dot + 1;
+	std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char) std::tolower(c); });
+
+	for (const auto &[name, container]: EXTENSIONS)
+	{
+		if (ext == name)
+			return container;
+	}
+
+	return ContainerType::UNKNOWN;
+}
+
+const char *getContainerName(ContainerType container) noexcept
+{
+	switch (container)
+	{
+		default:
+		case ContainerType::UNKNOWN:
+			return "unknown";
+		case ContainerType::ISOBMFF:
+			return "ISO BMFF";
+		case ContainerType::MATROSKA:
+			return "Matroska";
+		case ContainerType::OGG:
+			return "Ogg";
+		case ContainerType::WAVE:
+			return "WAVE";
+		case ContainerType::AVI:
+			return "AVI";
+		case ContainerType::FLAC:
+			return "FLAC";
+		case ContainerType::MP3:
+			return "MP3";
+		case ContainerType::ADTS:
+			return "ADTS";
+		case ContainerType::MPEGTS:
+			return "MPEG-TS";
+		case ContainerType::MPEGPS:
+			return "MPEG-PS";
+		case ContainerType::FLV:
+			return "FLV";
+		case ContainerType::ASF:
+			return "ASF";
+	}
+}
+
+}
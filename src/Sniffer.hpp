@@ -0,0 +1,34 @@
+#ifndef _NAV_SNIFFER_HPP_
+#define _NAV_SNIFFER_HPP_
+
+#include "nav/input.h"
+
+namespace nav
+{
+
+enum class ContainerType
+{
+	UNKNOWN,
+	ISOBMFF, // MP4, MOV, 3GP
+	MATROSKA, // Including WebM
+	OGG,
+	WAVE,
+	AVI,
+	FLAC,
+	MP3,
+	ADTS,
+	MPEGTS,
+	MPEGPS,
+	FLV,
+	ASF,
+};
+
+// Identifies the container from its signature at the start of the input. The input position is left unchanged.
+ContainerType sniffContainer(nav_input *input);
+// Guesses the container from the extension of `filename`. Less reliable than sniffContainer().
+ContainerType containerFromExtension(const char *filename);
+const char *getContainerName(ContainerType container) noexcept;
+
+}
+
+#endif /* _NAV_SNIFFER_HPP_ */
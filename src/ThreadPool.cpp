@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+#include "ThreadPool.hpp"
+
+namespace nav
+{
+
+struct ThreadPool::Job
+{
+	const std::function<void(size_t, size_t)> *func;
+	size_t count, maxSlots;
+	int priority;
+	std::atomic<size_t> next, finished, slots;
+	// Guarded by the pool mutex.
+	std::exception_ptr error;
+	std::condition_variable done;
+};
+
+ThreadPool::ThreadPool(size_t nthreads)
+: nthreads(std::max<size_t>(nthreads, 1))
+, mutex()
+, cond()
+, jobs()
+, workers()
+, stopping(false)
+{}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lg(mutex);
+		stopping = true;
+	}
+
+	cond.notify_all();
+
+	for (std::thread &t: workers)
+		t.join();
+}
+
+size_t ThreadPool::getThreadCount() const noexcept
+{
+	return nthreads;
+}
+
+std::shared_ptr<ThreadPool> ThreadPool::getShared()
+{
+	static std::shared_ptr<ThreadPool> shared = std::make_shared<ThreadPool>(std::thread::hardware_concurrency());
+	return shared;
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)> &func, int priority)
+{
+	parallelFor(count, [&func](size_t i, size_t) { func(i); }, priority);
+}
+
+void ThreadPool::parallelFor(
+	size_t count,
+	const std::function<void(size_t, size_t)> &func,
+	int priority,
+	size_t maxSlots
+)
+{
+	if (nthreads == 1 || count <= 1 || maxSlots <= 1)
+	{
+		for (size_t i = 0; i < count; i++)
+			func(i, 0);
+
+		return;
+	}
+
+	auto job = std::make_shared<Job>();
+	job->func = &func;
+	job->count = count;
+	job->maxSlots = maxSlots;
+	job->priority = priority;
+	job->next = 0;
+	job->finished = 0;
+	job->slots = 0;
+
+	{
+		std::lock_guard lg(mutex);
+
+		if (workers.empty())
+		{
+			for (size_t i = 1; i < nthreads; i++)
+				workers.emplace_back(&ThreadPool::worker, this);
+		}
+
+		auto pos = std::find_if(jobs.begin(), jobs.end(), [priority](const std::shared_ptr<Job> &j)
+		{
+			return j->priority < priority;
+		});
+		jobs.insert(pos, job);
+	}
+
+	cond.notify_all();
+	work(*job);
+
+	std::unique_lock lock(mutex);
+	job->done.wait(lock, [&job]() { return job->finished == job->count; });
+
+	auto it = std::find(jobs.begin(), jobs.end(), job);
+	if (it != jobs.end())
+		jobs.erase(it);
+
+	if (job->error)
+		std::rethrow_exception(job->error);
+}
+
+void ThreadPool::work(Job &job)
+{
+	// A thread only enters a job once, as findJob() skips it afterwards, so at most `nthreads` threads do.
+	size_t slot = job.slots++;
+	if (slot >= job.maxSlots)
+		return;
+
+	for (size_t i = job.next++; i < job.count; i = job.next++)
+	{
+		try
+		{
+			(*job.func)(i, slot);
+		}
+		catch (...)
+		{
+			std::lock_guard lg(mutex);
+			if (!job.error)
+				job.error = std::current_exception();
+		}
+
+		if (++job.finished == job.count)
+		{
+			std::lock_guard lg(mutex);
+			job.done.notify_all();
+		}
+	}
+}
+
+void ThreadPool::worker()
+{
+	std::unique_lock lock(mutex);
+
+	while (true)
+	{
+		std::shared_ptr<Job> job;
+		cond.wait(lock, [this, &job]() { return stopping || (job = findJob()) != nullptr; });
+
+		if (stopping)
+			return;
+
+		lock.unlock();
+		work(*job);
+		lock.lock();
+	}
+}
+
+std::shared_ptr<ThreadPool::Job> ThreadPool::findJob()
+{
+	for (auto it = jobs.begin(); it != jobs.end();)
+	{
+		Job &job = **it;
+
+		if (job.next >= job.count)
+			// Every iteration is taken. The submitter waits for the rest.
+			it = jobs.erase(it);
+		else if (job.slots >= job.maxSlots)
+			// Enough threads are on it already. Leave it to them.
+			++it;
+		else
+			return *it;
+	}
+
+	return nullptr;
+}
+
+}
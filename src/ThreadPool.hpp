@@ -0,0 +1,60 @@
+#ifndef _NAV_THREAD_POOL_HPP_
+#define _NAV_THREAD_POOL_HPP_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nav
+{
+
+// Runs parallel loops. The calling thread takes part in its own loop, so a pool of N threads has N - 1 workers, which
+// are only started on first use. Loops submitted from different threads can run at the same time.
+class ThreadPool
+{
+public:
+	ThreadPool(size_t nthreads);
+	ThreadPool(const ThreadPool &) = delete;
+	~ThreadPool();
+	size_t getThreadCount() const noexcept;
+	// Calls func(i) for every i in [0, count) and waits for all of them. Rethrows the first exception thrown by func.
+	// Idle workers take iterations of loops with higher `priority` first.
+	void parallelFor(size_t count, const std::function<void(size_t)> &func, int priority = 0);
+	// Same as above, but func(i, slot) also gets the slot of the thread calling it. Slots are below `maxSlots` and
+	// getThreadCount(), and are never shared by threads that run iterations of the same loop, so they can index
+	// per-thread scratch space.
+	void parallelFor(
+		size_t count,
+		const std::function<void(size_t, size_t)> &func,
+		int priority = 0,
+		size_t maxSlots = SIZE_MAX
+	);
+
+	// Pool shared by every instance that opts in, with a thread for each CPU thread. Created on first use.
+	static std::shared_ptr<ThreadPool> getShared();
+
+private:
+	struct Job;
+
+	void work(Job &job);
+	void worker();
+	// Must be called with the mutex held. Highest priority job that still has iterations and slots left.
+	std::shared_ptr<Job> findJob();
+
+	size_t nthreads;
+	std::mutex mutex;
+	std::condition_variable cond;
+	// Sorted by descending priority, then by submission.
+	std::deque<std::shared_ptr<Job>> jobs;
+	std::vector<std::thread> workers;
+	bool stopping;
+};
+
+}
+
+#endif /* _NAV_THREAD_POOL_HPP_ */
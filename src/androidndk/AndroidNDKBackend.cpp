@@ -180,11 +180,19 @@ AMediaDataSource *MediaSourceWrapper::get() const noexcept
 ssize_t MediaSourceWrapper::readAt(void *userdata, off64_t offset, void *buffer, size_t size)
 {
 	nav_input *input = (nav_input*) userdata;
-	if (input->tellf() != (uint64_t) offset)
-		if (!input->seekf((uint64_t) offset))
-			return -1;
-	
-	size_t readed = input->readf(buffer, size);
+	size_t readed = 0;
+
+	if (input->canReadAt())
+		readed = input->readAtf((uint64_t) offset, buffer, size);
+	else
+	{
+		if (input->tellf() != (uint64_t) offset)
+			if (!input->seekf((uint64_t) offset))
+				return -1;
+
+		readed = input->readf(buffer, size);
+	}
+
 	return readed > 0 ? ((ssize_t) readed) : (-1);
 }
 
@@ -217,6 +225,7 @@ AndroidNDKState::AndroidNDKState(AndroidNDKBackend *backend, UniqueMediaExtracto
 , hasEOS()
 , streamInfo()
 , decoders()
+, framePools()
 , extractor(std::move(ext))
 , dataSource(std::move(ds))
 {
@@ -225,10 +234,12 @@ AndroidNDKState::AndroidNDKState(AndroidNDKBackend *backend, UniqueMediaExtracto
 	hasEOS.resize(tracks);
 	streamInfo.resize(tracks);
 	decoders.reserve(tracks);
+	framePools.reserve(tracks);
 
 	for (size_t i = 0; i < tracks; i++)
 	{
 		decoders.emplace_back(nullptr, NAV_FFCALL(AMediaCodec_delete));
+		framePools.push_back(std::make_shared<FramePool>());
 
 		// Most of these keys are taken from:
 		// https://developer.android.com/reference/android/media/MediaFormat
@@ -495,7 +506,7 @@ nav_frame_t *AndroidNDKState::read()
 				FrameVector *result = nullptr;
 				try
 				{
-					result = new FrameVector(
+					result = framePools[index]->make<FrameVector>(
 						&streamInfo[index],
 						index,
 						derationalize(bufferInfo.presentationTimeUs, MICROSECOND),
@@ -600,11 +611,13 @@ const char *AndroidNDKBackend::getInfo()
 	return nullptr;
 }
 
-Backend *create()
+static bool isDisabled()
 {
-	if (checkBackendDisabled("ANDROIDNDK"))
-		return nullptr;
+	return checkBackendDisabled("ANDROIDNDK");
+}
 
+Backend *create()
+{
 	try
 	{
 		return new AndroidNDKBackend();
@@ -616,6 +629,8 @@ Backend *create()
 	}
 }
 
+const BackendDescriptor descriptor = {"android", NAV_BACKENDTYPE_OS_API, false, isDisabled, create};
+
 }
 
 
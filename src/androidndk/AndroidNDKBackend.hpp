@@ -11,6 +11,7 @@
 namespace nav::androidndk
 {
 
+extern const BackendDescriptor descriptor;
 Backend *create();
 
 }
@@ -11,6 +11,7 @@
 #include <media/NdkMediaExtractor.h>
 
 #include "Backend.hpp"
+#include "Common.hpp"
 #include "DynLib.hpp"
 
 namespace nav::androidndk
@@ -68,6 +69,7 @@ private:
 	std::vector<bool> activeStream, hasEOS;
 	std::vector<nav_streaminfo_t> streamInfo;
 	std::vector<UniqueMediaCodec> decoders;
+	std::vector<std::shared_ptr<FramePool>> framePools;
 
 	UniqueMediaExtractor extractor;
 	MediaSourceWrapper dataSource;
@@ -3,7 +3,10 @@
 #include "NAVConfig.hpp"
 
 #include <algorithm>
+#include <climits>
+#include <cstring>
 #include <numeric>
+#include <optional>
 #include <set>
 #include <sstream>
 #include <stdexcept>
@@ -15,6 +18,7 @@ extern "C"
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 #include <libavutil/avutil.h>
+#include <libavutil/opt.h>
 #include <libswresample/swresample.h>
 #include <libswscale/swscale.h>
 }
@@ -24,6 +28,7 @@ extern "C"
 #include "Error.hpp"
 #include "FFmpegBackend.hpp"
 #include "FFmpegInternal.hpp"
+#include "ProbeCache.hpp"
 
 #define NAV_FFCALL(name) f->func_##name
 
@@ -57,10 +62,18 @@ static ptrdiff_t getHWDevicePriority(AVHWDeviceType type)
         return ptrdiff_t((devicePreference.size()) + (size_t) type);
 }
 
-static int inputRead(void *nav_input, uint8_t *buf, int buf_size)
+static int inputRead(void *opaque, uint8_t *buf, int buf_size)
 {
-	struct nav_input *input = (struct nav_input*) nav_input;
-	size_t readed = input->readf(buf, buf_size);
+	auto *ctx = (nav::_NAV_FFMPEG_NAMESPACE::InputContext*) opaque;
+	size_t readed;
+
+	if (ctx->input.canReadAt())
+	{
+		readed = ctx->input.readAtf(ctx->position, buf, buf_size);
+		ctx->position += readed;
+	}
+	else
+		readed = ctx->input.readf(buf, buf_size);
 
 	if (readed == 0)
 		return AVERROR_EOF;
@@ -68,11 +81,10 @@ static int inputRead(void *nav_input, uint8_t *buf, int buf_size)
 	return (int) readed;
 }
 
-static int64_t inputSeek(void *nav_input, int64_t offset, int origin)
+static int64_t inputSeek(void *opaque, int64_t offset, int origin)
 {
-	struct nav_input *input = (struct nav_input*) nav_input;
-	
-	int64_t filesize = (int64_t) input->sizef();
+	auto *ctx = (nav::_NAV_FFMPEG_NAMESPACE::InputContext*) opaque;
+	int64_t filesize = (int64_t) ctx->size;
 
 	if (origin & AVSEEK_SIZE)
 		return filesize;
@@ -85,7 +97,7 @@ static int64_t inputSeek(void *nav_input, int64_t offset, int origin)
 			realoff = offset;
 			break;
 		case SEEK_CUR:
-			realoff = ((int64_t) input->tellf()) + offset;
+			realoff = (int64_t) (ctx->input.canReadAt() ? ctx->position : ctx->input.tellf()) + offset;
 			break;
 		case SEEK_END:
 			realoff = filesize + offset;
@@ -94,12 +106,115 @@ static int64_t inputSeek(void *nav_input, int64_t offset, int origin)
 			return AVERROR(EINVAL);
 	}
 
-	if (!input->seekf((uint64_t) std::min<int64_t>(std::max<int64_t>(realoff, 0LL), filesize)))
+	uint64_t newpos = (uint64_t) std::min<int64_t>(std::max<int64_t>(realoff, 0LL), filesize);
+
+	if (ctx->input.canReadAt())
+		ctx->position = newpos;
+	else if (!ctx->input.seekf(newpos))
 		return AVERROR_UNKNOWN;
 
 	return realoff;
 }
 
+// Whether the demuxer already knows everything FFmpegState needs, without decoding anything.
+static bool hasCompleteHeaders(const AVFormatContext *formatContext)
+{
+	if (formatContext->nb_streams == 0 || formatContext->duration == AV_NOPTS_VALUE)
+		return false;
+
+	for (unsigned int i = 0; i < formatContext->nb_streams; i++)
+	{
+		const AVStream *stream = formatContext->streams[i];
+		const AVCodecParameters *codecpar = stream->codecpar;
+
+		switch (codecpar->codec_type)
+		{
+			case AVMEDIA_TYPE_VIDEO:
+			{
+				if (
+					codecpar->codec_id == AV_CODEC_ID_NONE ||
+					codecpar->format < 0 ||
+					codecpar->width <= 0 ||
+					codecpar->height <= 0 ||
+					stream->avg_frame_rate.num <= 0
+				)
+					return false;
+
+				break;
+			}
+			case AVMEDIA_TYPE_AUDIO:
+			{
+#if _NAV_FFMPEG_VERSION >= 6
+				int nchannels = codecpar->ch_layout.nb_channels;
+#else
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+				int nchannels = codecpar->channels;
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+#endif
+				if (
+					codecpar->codec_id == AV_CODEC_ID_NONE ||
+					codecpar->format < 0 ||
+					codecpar->sample_rate <= 0 ||
+					nchannels <= 0
+				)
+					return false;
+
+				break;
+			}
+			default:
+				break;
+		}
+	}
+
+	return true;
+}
+
+// Whether decoders set up for streams of `a` can decode streams of `b` as-is.
+static bool hasSameCodecParameters(const AVFormatContext *a, const AVFormatContext *b)
+{
+	if (a->nb_streams != b->nb_streams)
+		return false;
+
+	for (unsigned int i = 0; i < a->nb_streams; i++)
+	{
+		const AVCodecParameters *x = a->streams[i]->codecpar;
+		const AVCodecParameters *y = b->streams[i]->codecpar;
+
+#if _NAV_FFMPEG_VERSION >= 6
+		bool sameChannels = x->ch_layout.nb_channels == y->ch_layout.nb_channels;
+#else
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+		bool sameChannels = x->channels == y->channels;
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+		if (
+			x->codec_type != y->codec_type ||
+			x->codec_id != y->codec_id ||
+			x->format != y->format ||
+			x->width != y->width ||
+			x->height != y->height ||
+			x->sample_rate != y->sample_rate ||
+			!sameChannels ||
+			x->extradata_size != y->extradata_size ||
+			(x->extradata_size > 0 && std::memcmp(x->extradata, y->extradata, (size_t) x->extradata_size) != 0)
+		)
+			return false;
+	}
+
+	return true;
+}
+
 [[noreturn]] static void throwFromAVError(decltype(&av_strerror) func_av_strerror, int code) noexcept(false)
 {
 	constexpr size_t BUFSIZE = 256;
@@ -138,6 +253,26 @@ static nav_audioformat audioFormatFromAVSampleFormat(AVSampleFormat format)
 	}
 }
 
+static AVSampleFormat toAVSampleFormat(nav_audioformat format)
+{
+	constexpr AVSampleFormat candidates[] = {
+		AV_SAMPLE_FMT_U8,
+		AV_SAMPLE_FMT_S16,
+		AV_SAMPLE_FMT_S32,
+		AV_SAMPLE_FMT_S64,
+		AV_SAMPLE_FMT_FLT,
+		AV_SAMPLE_FMT_DBL
+	};
+
+	for (AVSampleFormat candidate: candidates)
+	{
+		if (audioFormatFromAVSampleFormat(candidate) == format)
+			return candidate;
+	}
+
+	return AV_SAMPLE_FMT_NONE;
+}
+
 static std::tuple<nav_pixelformat, AVPixelFormat> getBestPixelFormat(AVPixelFormat pixfmt)
 {
 	switch (pixfmt)
@@ -431,6 +566,28 @@ static std::tuple<nav_pixelformat, AVPixelFormat> getBestPixelFormat(AVPixelForm
 	}
 }
 
+static AVPixelFormat toAVPixelFormat(nav_pixelformat pixfmt)
+{
+	switch (pixfmt)
+	{
+		case NAV_PIXELFORMAT_UNKNOWN:
+		default:
+			return AV_PIX_FMT_NONE;
+		case NAV_PIXELFORMAT_RGB8:
+			return AV_PIX_FMT_RGB24;
+		case NAV_PIXELFORMAT_YUV420:
+			return AV_PIX_FMT_YUV420P;
+		case NAV_PIXELFORMAT_YUV444:
+			return AV_PIX_FMT_YUV444P;
+		case NAV_PIXELFORMAT_NV12:
+			return AV_PIX_FMT_NV12;
+		case NAV_PIXELFORMAT_RGBA8:
+			return AV_PIX_FMT_RGBA;
+		case NAV_PIXELFORMAT_BGRA8:
+			return AV_PIX_FMT_BGRA;
+	}
+}
+
 constexpr std::tuple<unsigned int, unsigned int> extractVersion(unsigned int ver)
 {
 	return std::make_tuple(ver >> 16, (ver >> 8) & 0xFF);
@@ -461,20 +618,239 @@ struct CallOnLeave
 	T *ptr;
 };
 
+// Higher runs first in the thread pool.
+static int getPoolPriority(nav_priority priority)
+{
+	switch (priority)
+	{
+		case NAV_PRIORITY_HIGH:
+			return 1;
+		case NAV_PRIORITY_LOW:
+			return -1;
+		default:
+			return 0;
+	}
+}
+
 namespace nav::_NAV_FFMPEG_NAMESPACE
 {
 
-FFmpegFrame::FFmpegFrame(FFmpegBackend *f, nav_streaminfo_t *sinfo, AVFrame *frame, const AVCodecContext *cctx, double pts, size_t si)
+Converter::Converter(
+	FFmpegBackend *backend,
+	const std::shared_ptr<ThreadPool> &pool,
+	int priority,
+	SwsContext *rescaler,
+	SwrContext *resampler
+) noexcept
+: f(backend)
+, mutex()
+, pool(pool)
+, priority(priority)
+, rescaler(rescaler)
+, resampler(resampler)
+, destination(nullptr)
+, targetWidth(0)
+, targetHeight(0)
+, targetFormat(AV_PIX_FMT_NONE)
+, fastFormat(AV_PIX_FMT_NONE)
+, fast()
+, sampleSource(AV_SAMPLE_FMT_NONE)
+, packer()
+{}
+
+Converter::~Converter()
+{
+	NAV_FFCALL(av_frame_free)(&destination);
+	NAV_FFCALL(swr_free)(&resampler);
+	NAV_FFCALL(sws_freeContext)(rescaler);
+}
+
+#if _NAV_FFMPEG_VERSION >= 5
+static void freeNothing(void *, uint8_t *)
+{}
+#endif
+
+void Converter::rescale(const AVFrame *source, uint8_t *const *planes, const ptrdiff_t *strides, size_t nplanes)
+{
+	std::lock_guard lg(mutex);
+
+	if (fast && source->format == fastFormat)
+	{
+		ptrdiff_t sourceStrides[AV_NUM_DATA_POINTERS] = {0};
+		for (size_t i = 0; i < AV_NUM_DATA_POINTERS; i++)
+			sourceStrides[i] = source->linesize[i];
+
+		fast->convert(
+			source->data,
+			sourceStrides,
+			planes,
+			strides,
+			(uint32_t) source->width,
+			(uint32_t) source->height,
+			// Unspecified colorspaces are BT.601, like swscale.
+			source->colorspace == AVCOL_SPC_BT709 ? YUVMatrix::BT709 : YUVMatrix::BT601,
+			pool.get(),
+			priority
+		);
+		return;
+	}
+
+#if _NAV_FFMPEG_VERSION >= 5
+	// Only the frame API uses the rescaler threads. It allocates its own buffer unless the destination has one, so
+	// wrap ours in a buffer that's never freed.
+	if (destination == nullptr)
+	{
+		destination = NAV_FFCALL(av_frame_alloc)();
+		if (destination == nullptr)
+			throw std::runtime_error("Cannot allocate AVFrame");
+	}
+
+	CallOnLeave<AVFrame> unrefDestination(NAV_FFCALL(av_frame_unref), destination);
+	destination->format = targetFormat;
+	destination->width = targetWidth;
+	destination->height = targetHeight;
+
+	for (size_t i = 0; i < nplanes; i++)
+	{
+		destination->data[i] = planes[i];
+		destination->linesize[i] = (int) strides[i];
+	}
+
+	destination->buf[0] = NAV_FFCALL(av_buffer_create)(planes[0], 0, freeNothing, nullptr, 0);
+	if (destination->buf[0] == nullptr)
+		throw std::runtime_error("Cannot allocate AVBufferRef");
+
+	// Rescale handles flip.
+	checkError(NAV_FFCALL(av_strerror), NAV_FFCALL(sws_scale_frame)(rescaler, destination, source));
+#else
+	uint8_t *bufferSetup[AV_NUM_DATA_POINTERS] = {nullptr};
+	int linesizeSetup[AV_NUM_DATA_POINTERS] = {0};
+
+	for (size_t i = 0; i < nplanes; i++)
+	{
+		bufferSetup[i] = planes[i];
+		linesizeSetup[i] = (int) strides[i];
+	}
+
+	// Rescale handles flip.
+	checkError(
+		NAV_FFCALL(av_strerror),
+		NAV_FFCALL(sws_scale)(rescaler, source->data, source->linesize, 0, source->height, bufferSetup, linesizeSetup)
+	);
+#endif
+}
+
+void Converter::resample(const AVFrame *source, uint8_t *dest)
+{
+	uint8_t *tempBuffer[AV_NUM_DATA_POINTERS] = {dest, nullptr};
+
+	std::lock_guard lg(mutex);
+
+	if (packer)
+	{
+		if (source->format != sampleSource)
+			throw std::runtime_error("Decoder changed the sample format");
+
+		packer->convert(source->extended_data, dest, (size_t) source->nb_samples);
+		return;
+	}
+
+	checkError(
+		NAV_FFCALL(av_strerror),
+		NAV_FFCALL(swr_convert)(resampler, tempBuffer, source->nb_samples, (const uint8_t**) source->data, source->nb_samples)
+	);
+}
+
+void Converter::setTarget(AVPixelFormat from, const nav_streaminfo_t::VideoStreamInfo &to, bool sameSize) noexcept
+{
+	std::optional<SourcePixelFormat> source;
+	targetWidth = (int) to.width;
+	targetHeight = (int) to.height;
+	targetFormat = toAVPixelFormat(to.format);
+
+	switch (from)
+	{
+		case AV_PIX_FMT_YUV420P:
+			source = SourcePixelFormat::YUV420P;
+			break;
+		case AV_PIX_FMT_YUVJ420P:
+			source = SourcePixelFormat::YUVJ420P;
+			break;
+		case AV_PIX_FMT_YUV422P:
+			source = SourcePixelFormat::YUV422P;
+			break;
+		case AV_PIX_FMT_YUVJ422P:
+			source = SourcePixelFormat::YUVJ422P;
+			break;
+		case AV_PIX_FMT_NV12:
+			source = SourcePixelFormat::NV12;
+			break;
+		case AV_PIX_FMT_NV21:
+			source = SourcePixelFormat::NV21;
+			break;
+		case AV_PIX_FMT_P010LE:
+			source = SourcePixelFormat::P010;
+			break;
+		default:
+			break;
+	}
+
+	if (rescaler && sameSize && source && PixelConverter::isSupported(*source, to.format))
+	{
+		fastFormat = from;
+		fast.emplace(*source, to.format);
+	}
+	else
+	{
+		fastFormat = AV_PIX_FMT_NONE;
+		fast.reset();
+	}
+}
+
+FFmpegFrame::FFmpegFrame(
+	FFmpegBackend *f,
+	nav_streaminfo_t *sinfo,
+	AVFrame *frame,
+	const AVCodecContext *cctx,
+	double pts,
+	size_t si,
+	const std::shared_ptr<Converter> &conv
+)
 : f(f) // must be first
 , acquireData()
 , pts(pts)
-, frame(NAV_FFCALL(av_frame_clone)(frame))
+, frame(NAV_FFCALL(av_frame_alloc)())
+, swFrame(nullptr)
 , streamInfo(sinfo)
 , index(si)
 , codecContext(cctx)
+, converter()
+, converted()
 {
 	if (this->frame == nullptr)
-		throw std::runtime_error("Cannot clone AVFrame");
+		throw std::runtime_error("Cannot allocate AVFrame");
+
+	reset(f, sinfo, frame, cctx, pts, si, conv);
+}
+
+void FFmpegFrame::reset(
+	FFmpegBackend *f,
+	nav_streaminfo_t *sinfo,
+	AVFrame *frame,
+	const AVCodecContext *cctx,
+	double pts,
+	size_t si,
+	const std::shared_ptr<Converter> &conv
+)
+{
+	this->f = f;
+	this->pts = pts;
+	streamInfo = sinfo;
+	index = si;
+	codecContext = cctx;
+	converter = conv;
+	// Take over the buffer references, no need to clone.
+	NAV_FFCALL(av_frame_move_ref)(this->frame, frame);
 }
 
 size_t FFmpegFrame::getStreamIndex() const noexcept
@@ -497,24 +873,43 @@ const uint8_t *const *FFmpegFrame::acquire(ptrdiff_t **strides, size_t *nplanes)
 	if (acquireData.source == nullptr)
 	{
 		AVFrame *targetFrame = frame;
+		std::optional<CallOnLeave<AVFrame>> transferGuard;
 
-		if (codecContext->hw_device_ctx)
+		// Not set if detach() downloaded it already.
+		if (frame->hw_frames_ctx)
 		{
 			// Hardware accelerated. Download the frame to CPU.
-			AVFrame *swFrame = NAV_FFCALL(av_frame_alloc)();
 			if (swFrame == nullptr)
 			{
-				nav::error::set("Cannot allocate CPU frame.");
-				return nullptr;
+				swFrame = NAV_FFCALL(av_frame_alloc)();
+				if (swFrame == nullptr)
+				{
+					nav::error::set("Cannot allocate CPU frame.");
+					return nullptr;
+				}
 			}
 
 			if (int r = NAV_FFCALL(av_hwframe_transfer_data)(swFrame, frame, 0); r < 0)
 			{
-				NAV_FFCALL(av_frame_free)(&swFrame);
+				NAV_FFCALL(av_frame_unref)(swFrame);
 				throwFromAVError(NAV_FFCALL(av_strerror), r);
 			}
 
 			targetFrame = swFrame;
+
+			// The downloaded frame is only needed until it's converted.
+			if (converter)
+				transferGuard.emplace(NAV_FFCALL(av_frame_unref), swFrame);
+		}
+
+		if (converter)
+		{
+			convert(targetFrame);
+
+			if (nplanes)
+				*nplanes = acquireData.planes.size();
+			*strides = acquireData.strides.data();
+			return acquireData.planes.data();
 		}
 
 		// AVFrame is already in CPU
@@ -526,6 +921,10 @@ const uint8_t *const *FFmpegFrame::acquire(ptrdiff_t **strides, size_t *nplanes)
 			acquireData.strides.push_back(targetFrame->linesize[i]);
 		}
 
+		// Audio linesize includes padding. Report the actual size instead.
+		if (streamInfo->type == NAV_STREAMTYPE_AUDIO && !acquireData.strides.empty())
+			acquireData.strides[0] = (ptrdiff_t) (((size_t) targetFrame->nb_samples) * streamInfo->audio.size());
+
 		acquireData.source = (uint8_t*) targetFrame;
 	}
 
@@ -537,16 +936,79 @@ const uint8_t *const *FFmpegFrame::acquire(ptrdiff_t **strides, size_t *nplanes)
 
 void FFmpegFrame::release() noexcept
 {
-	if (codecContext->hw_device_ctx && acquireData.source)
+	// Only downloaded hardware frames need to be released.
+	if (swFrame && acquireData.source == (uint8_t*) swFrame)
 	{
-		AVFrame *swFrame = (AVFrame *) acquireData.source;
-		NAV_FFCALL(av_frame_free)(&swFrame);
+		NAV_FFCALL(av_frame_unref)(swFrame);
 		acquireData.source = nullptr;
 	}
 }
 
+void FFmpegFrame::recycle() noexcept
+{
+	release();
+	acquireData.source = nullptr;
+	converter.reset();
+	NAV_FFCALL(av_frame_unref)(frame);
+}
+
+void FFmpegFrame::detach() noexcept
+{
+	if (frame->hw_frames_ctx == nullptr)
+		return;
+
+	AVFrame *downloaded = NAV_FFCALL(av_frame_alloc)();
+	if (downloaded == nullptr)
+		return;
+
+	// Keep the hardware frame if it can't be downloaded. The decoder may stall, but nothing is lost.
+	if (NAV_FFCALL(av_hwframe_transfer_data)(downloaded, frame, 0) >= 0)
+	{
+		NAV_FFCALL(av_frame_unref)(frame);
+		NAV_FFCALL(av_frame_move_ref)(frame, downloaded);
+	}
+
+	NAV_FFCALL(av_frame_free)(&downloaded);
+}
+
+void FFmpegFrame::convert(const AVFrame *source)
+{
+	acquireData.planes.clear();
+	acquireData.strides.clear();
+
+	if (streamInfo->type == NAV_STREAMTYPE_AUDIO)
+	{
+		size_t size = ((size_t) source->nb_samples) * streamInfo->audio.size();
+		converted.resize(size);
+		acquireData.planes.push_back(converted.data());
+		acquireData.strides.push_back((ptrdiff_t) size);
+		converter->resample(source, converted.data());
+	}
+	else
+	{
+		// Partition the same way as FrameVector, no padding.
+		converted.resize(streamInfo->video.size());
+		uint8_t *start = converted.data();
+
+		for (size_t i = 0; i < planeCount(streamInfo->video.format); i++)
+		{
+			acquireData.planes.push_back(start);
+			acquireData.strides.push_back((ptrdiff_t) streamInfo->plane_width(i));
+			start += streamInfo->plane_width(i) * streamInfo->plane_height(i);
+		}
+
+		converter->rescale(source, acquireData.planes.data(), acquireData.strides.data(), acquireData.planes.size());
+	}
+
+	acquireData.source = converted.data();
+}
+
 nav_hwacceltype FFmpegFrame::getHWAccelType() const noexcept
 {
+	// The hardware surface is in the decoded format, not the converted one.
+	if (converter)
+		return NAV_HWACCELTYPE_NONE;
+
 	switch ((AVPixelFormat) frame->format)
 	{
 		case AV_PIX_FMT_D3D11:
@@ -564,6 +1026,12 @@ nav_hwacceltype FFmpegFrame::getHWAccelType() const noexcept
 
 void *FFmpegFrame::getHWAccelHandle()
 {
+	if (converter)
+	{
+		nav::error::set("Not hardware accelerated");
+		return nullptr;
+	}
+
 	switch ((AVPixelFormat) frame->format)
 	{
 		case AV_PIX_FMT_D3D11:
@@ -582,41 +1050,76 @@ void *FFmpegFrame::getHWAccelHandle()
 
 FFmpegFrame::~FFmpegFrame()
 {
-	if (frame)
-	{
-		release();
-		NAV_FFCALL(av_frame_unref)(frame);
-		NAV_FFCALL(av_frame_free)(&frame);
-	}
+	release();
+	NAV_FFCALL(av_frame_free)(&swFrame);
+	NAV_FFCALL(av_frame_free)(&frame);
 }
 
 
 
-FFmpegState::FFmpegState(FFmpegBackend *backend, UniqueAVFormatContext &fmtctx, UniqueAVIOContext &ioctx, const nav_settings &settings)
+FFmpegState::FFmpegState(
+	FFmpegBackend *backend,
+	std::unique_ptr<InputContext> &inputctx,
+	UniqueAVFormatContext &fmtctx,
+	UniqueAVIOContext &ioctx,
+	const nav_settings &settings,
+	const std::vector<uint8_t> &probeData
+)
 : f(backend)
+, inputContext(std::move(inputctx))
 , formatContext(std::move(fmtctx))
 , ioContext(std::move(ioctx))
 , tempPacket(NAV_FFCALL(av_packet_alloc)(), {NAV_FFCALL(av_packet_free)})
 , tempFrame(NAV_FFCALL(av_frame_alloc)(), {NAV_FFCALL(av_frame_free)})
+, hwTransferFrame(nullptr, {NAV_FFCALL(av_frame_free)})
 , position(0.0)
 , eof(false)
 , prepared(false)
+, maxThreads(settings.shared_thread_pool ? 1 : settings.max_threads)
+, sharedPool(settings.shared_thread_pool)
+, conversionPool(
+	settings.shared_thread_pool
+		? ThreadPool::getShared()
+		: (settings.max_threads > 1 ? std::make_shared<ThreadPool>(settings.max_threads) : nullptr)
+)
+, poolPriority(getPoolPriority(settings.priority))
 , streamInfo()
 , decoders()
-, resamplers()
-, rescalers()
+, converters()
+, sourceFormats()
+, scaleFlags()
 , streamEofs()
+, prerolling()
+, awaitingKeyframe()
+, seekTarget(0.0)
+, prerollFrames()
+, prerollPositions()
+, pendingFrame(NAV_FFCALL(av_frame_alloc)(), {NAV_FFCALL(av_frame_free)})
+, pendingIndex(0)
+, pendingPosition(0.0)
+, framePools()
 {
 	if (!tempPacket)
 		throw std::runtime_error("Cannot allocate AVPacket");
+	if (!pendingFrame)
+		throw std::runtime_error("Cannot allocate AVFrame");
+
+	bool probed = !probeData.empty() && applyProbeData(probeData);
 
-	checkError(NAV_FFCALL(av_strerror), NAV_FFCALL(avformat_find_stream_info)(formatContext.get(), nullptr));
+	if (!probed && (!settings.trust_headers || !hasCompleteHeaders(formatContext.get())))
+		checkError(NAV_FFCALL(av_strerror), NAV_FFCALL(avformat_find_stream_info)(formatContext.get(), nullptr));
 
 	streamInfo.reserve(formatContext->nb_streams);
 	decoders.reserve(formatContext->nb_streams);
-	resamplers.reserve(formatContext->nb_streams);
-	rescalers.reserve(formatContext->nb_streams);
+	converters.reserve(formatContext->nb_streams);
+	sourceFormats.reserve(formatContext->nb_streams);
+	scaleFlags.reserve(formatContext->nb_streams);
+	prerolling.reserve(formatContext->nb_streams);
+	awaitingKeyframe.reserve(formatContext->nb_streams);
+	prerollFrames.reserve(formatContext->nb_streams);
+	prerollPositions.reserve(formatContext->nb_streams);
 	streamEofs.resize(formatContext->nb_streams);
+	framePools.reserve(formatContext->nb_streams);
 
 	for (unsigned int i = 0; i < formatContext->nb_streams; i++)
 	{
@@ -625,7 +1128,8 @@ FFmpegState::FFmpegState(FFmpegBackend *backend, UniqueAVFormatContext &fmtctx,
 		const AVCodec *codec = nullptr;
 		AVCodecContext *codecContext = nullptr;
 		SwsContext *rescaler = nullptr;
-		SwrContext *resampler = nullptr;
+		AVPixelFormat sourceFormat = AV_PIX_FMT_NONE;
+		AVSampleFormat sampleFormat = AV_SAMPLE_FMT_NONE;
 		bool good = true;
 
 		switch (stream->codecpar->codec_type)
@@ -701,59 +1205,56 @@ FFmpegState::FFmpegState(FFmpegBackend *backend, UniqueAVFormatContext &fmtctx,
 					if (!codecContext->hw_device_ctx)
 						codecContext->get_format = oldFormat;
 
-					codecContext->thread_count = (int) settings.max_threads;
+					// Audio decoders gain little from threads.
+					if (stream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
+						codecContext->thread_count = 1;
+					else if (sharedPool)
+					{
+						// Opening still starts thread_count - 1 slice threads that stay idle, so keep it small. It's
+						// also the most slices of a frame that run in the pool at once. Frame threads can't run in it.
+						constexpr size_t MAX_SHARED_SLICE_THREADS = 4;
+						codecContext->thread_count = (int) std::min(
+							conversionPool->getThreadCount(),
+							MAX_SHARED_SLICE_THREADS
+						);
+						codecContext->thread_type = FF_THREAD_SLICE;
+					}
+					else
+						codecContext->thread_count = (int) settings.max_threads;
+
+					if (settings.low_latency)
+					{
+						// Frame threads delay the output by a frame for each thread.
+						codecContext->thread_type = FF_THREAD_SLICE;
+
+						// Low delay outputs frames in decode order, which would break streams that reorder them.
+						if (stream->codecpar->video_delay == 0)
+							codecContext->flags |= AV_CODEC_FLAG_LOW_DELAY;
+					}
+
 					good = NAV_FFCALL(avcodec_open2)(codecContext, codec, nullptr) >= 0;
 				}
 
+				if (good && sharedPool && (codecContext->active_thread_type & FF_THREAD_SLICE))
+				{
+					// Opening replaced the hooks with ones that use its own slice threads. Those stay idle now,
+					// except for the few codecs that drive them directly.
+					codecContext->opaque = this;
+					codecContext->execute = executeInPool;
+					codecContext->execute2 = executeInPool2;
+				}
+
 				if (good)
 				{
 					if (stream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
 					{
-						AVSampleFormat originalFormat = (AVSampleFormat) stream->codecpar->format;
-						AVSampleFormat packedFormat = NAV_FFCALL(av_get_packed_sample_fmt)(originalFormat);
-						if (packedFormat != originalFormat)
-						{
-							// Need to resample
-#if _NAV_FFMPEG_VERSION >= 6
-							good = NAV_FFCALL(swr_alloc_set_opts2)(
-								&resampler,
-								&stream->codecpar->ch_layout,
-								packedFormat,
-								stream->codecpar->sample_rate,
-								&stream->codecpar->ch_layout,
-								originalFormat,
-								stream->codecpar->sample_rate,
-								0, nullptr
-							) >= 0;
-#else
-#ifdef __GNUC__
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
-#endif
-							resampler = NAV_FFCALL(swr_alloc_set_opts)(
-								nullptr,
-								stream->codecpar->channel_layout,
-								packedFormat,
-								stream->codecpar->sample_rate,
-								stream->codecpar->channel_layout,
-								originalFormat,
-								stream->codecpar->sample_rate,
-								0, nullptr
-							);
-#ifdef __GNUC__
-#pragma GCC diagnostic pop
-#endif
-							good = resampler;
-#endif
-						}
-
-						if (good)
-							good = NAV_FFCALL(swr_init)(resampler) >= 0;
+						// Planar audio is interleaved by setupResampler() below.
+						sampleFormat = NAV_FFCALL(av_get_packed_sample_fmt)((AVSampleFormat) stream->codecpar->format);
 
 						if (good)
 						{
 							// Audio stream
-							sinfo.audio.format = audioFormatFromAVSampleFormat(packedFormat);
+							sinfo.audio.format = audioFormatFromAVSampleFormat(sampleFormat);
 							sinfo.audio.sample_rate = stream->codecpar->sample_rate;
 #if _NAV_FFMPEG_VERSION >= 6
 							sinfo.audio.nchannels = stream->codecpar->ch_layout.nb_channels;
@@ -777,6 +1278,7 @@ FFmpegState::FFmpegState(FFmpegBackend *backend, UniqueAVFormatContext &fmtctx,
 							: ((AVPixelFormat) stream->codecpar->format);
 						AVPixelFormat rescaleFormat = originalFormat;
 						std::tie(sinfo.video.format, rescaleFormat) = getBestPixelFormat(originalFormat);
+						sourceFormat = originalFormat;
 
 						// Need to rescale
 						if (rescaleFormat != originalFormat)
@@ -786,14 +1288,14 @@ FFmpegState::FFmpegState(FFmpegBackend *backend, UniqueAVFormatContext &fmtctx,
 								good = false;
 							else
 							{
-								rescaler = NAV_FFCALL(sws_getContext)(
+								rescaler = createRescaler(
 									stream->codecpar->width,
 									stream->codecpar->height,
 									originalFormat,
 									stream->codecpar->width,
 									stream->codecpar->height,
 									rescaleFormat,
-									SWS_BICUBIC, nullptr, nullptr, nullptr
+									SWS_BICUBIC
 								);
 								good = rescaler != nullptr;
 							}
@@ -825,7 +1327,6 @@ FFmpegState::FFmpegState(FFmpegBackend *backend, UniqueAVFormatContext &fmtctx,
 
 			if (rescaler)
 			{
-				NAV_FFCALL(swr_free)(&resampler);
 				NAV_FFCALL(sws_freeContext)(rescaler);
 				rescaler = nullptr;
 			}
@@ -833,8 +1334,20 @@ FFmpegState::FFmpegState(FFmpegBackend *backend, UniqueAVFormatContext &fmtctx,
 
 		streamInfo.push_back(sinfo);
 		decoders.push_back(codecContext);
-		resamplers.push_back(resampler);
-		rescalers.push_back(rescaler);
+		converters.push_back(std::make_shared<Converter>(f, conversionPool, poolPriority, rescaler, nullptr));
+		if (sinfo.type == NAV_STREAMTYPE_VIDEO)
+			converters.back()->setTarget(sourceFormat, sinfo.video, true);
+		sourceFormats.push_back(sourceFormat);
+		scaleFlags.push_back(SWS_BICUBIC);
+		prerolling.push_back(false);
+		awaitingKeyframe.push_back(false);
+		prerollFrames.emplace_back(nullptr, ffmpeg_common::DoublePointerDeleter<AVFrame> {NAV_FFCALL(av_frame_free)});
+		prerollPositions.push_back(0.0);
+		framePools.push_back(std::make_shared<FramePool>());
+
+		// Interleaving never needs the resampler, so this can't fail.
+		if (sinfo.type == NAV_STREAMTYPE_AUDIO)
+			setupResampler(i, sampleFormat);
 	}
 }
 
@@ -842,10 +1355,10 @@ FFmpegState::~FFmpegState()
 {
 	for (AVCodecContext *&decoder: decoders)
 		NAV_FFCALL(avcodec_free_context)(&decoder);
-	for (SwrContext *&resampler: resamplers)
-		NAV_FFCALL(swr_free)(&resampler);
-	for (SwsContext *&rescaler: rescalers)
-		NAV_FFCALL(sws_freeContext)(rescaler);
+
+	// The input is owned since nav_open succeeded.
+	if (inputContext->input.userdata)
+		inputContext->input.closef();
 }
 
 Backend *FFmpegState::getBackend() const noexcept
@@ -898,42 +1411,182 @@ bool FFmpegState::setStreamEnabled(size_t index, bool enabled)
 	return true;
 }
 
-double FFmpegState::getDuration() noexcept
+bool FFmpegState::setPixelFormat(size_t index, nav_pixelformat format)
 {
-	return derationalize<int64_t>(formatContext->duration, AV_TIME_BASE);
-}
+	if (!canReconfigure(index, NAV_STREAMTYPE_VIDEO))
+		return false;
 
-double FFmpegState::getPosition() noexcept
-{
-	return position;
+	if (toAVPixelFormat(format) == AV_PIX_FMT_NONE)
+	{
+		nav::error::set("Unsupported pixel format");
+		return false;
+	}
+
+	nav_streaminfo_t::VideoStreamInfo video = streamInfo[index].video;
+	video.format = format;
+	return setupRescaler(index, video, scaleFlags[index]);
 }
 
-double FFmpegState::setPosition(double off)
+bool FFmpegState::setVideoSize(size_t index, uint32_t width, uint32_t height, nav_scaler scaler)
 {
-	int64_t pos = int64_t(off * AV_TIME_BASE);
+	if (!canReconfigure(index, NAV_STREAMTYPE_VIDEO))
+		return false;
 
-	checkError(NAV_FFCALL(av_strerror), NAV_FFCALL(avformat_flush)(formatContext.get()));
-	checkError(
-		NAV_FFCALL(av_strerror),
-		NAV_FFCALL(avformat_seek_file)(
-			formatContext.get(),
-			-1,
-			std::numeric_limits<int64_t>::min(),
-			pos,
-			std::numeric_limits<int64_t>::max(),
-			0
-		)
-	);
+	AVCodecParameters *codecpar = formatContext->streams[index]->codecpar;
+	nav_streaminfo_t::VideoStreamInfo video = streamInfo[index].video;
+	video.width = width ? width : (uint32_t) codecpar->width;
+	video.height = height ? height : (uint32_t) codecpar->height;
 
-	for (AVCodecContext *decoder: decoders)
+	int flags = SWS_BICUBIC;
+	switch (scaler)
 	{
-		if (decoder)
-			NAV_FFCALL(avcodec_flush_buffers)(decoder);
-	}
-	// No need to flush swr as we're not doing sample-rate conversion.
+		case NAV_SCALER_DEFAULT:
+		case NAV_SCALER_BICUBIC:
+		default:
+			break;
+		case NAV_SCALER_FAST_BILINEAR:
+			flags = SWS_FAST_BILINEAR;
+			break;
+		case NAV_SCALER_BILINEAR:
+			flags = SWS_BILINEAR;
+			break;
+	}
+
+	return setupRescaler(index, video, flags);
+}
+
+bool FFmpegState::setAudioFormat(size_t index, nav_audioformat format)
+{
+	if (!canReconfigure(index, NAV_STREAMTYPE_AUDIO))
+		return false;
+
+	AVSampleFormat sampleFormat = toAVSampleFormat(format);
+	if (sampleFormat == AV_SAMPLE_FMT_NONE)
+	{
+		nav::error::set("Unsupported audio format");
+		return false;
+	}
+
+	return setupResampler(index, sampleFormat);
+}
+
+bool FFmpegState::setKeyframesOnly(size_t index, bool keyframesOnly)
+{
+	if (index >= streamInfo.size())
+	{
+		nav::error::set("Stream index out of range");
+		return false;
+	}
+
+	if (streamInfo[index].type != NAV_STREAMTYPE_VIDEO)
+	{
+		nav::error::set("Not a video stream");
+		return false;
+	}
+
+	if (decoders[index] == nullptr)
+	{
+		nav::error::set("Stream is not decoded");
+		return false;
+	}
+
+	AVCodecContext *decoder = decoders[index];
+
+	if (keyframesOnly)
+	{
+		// The decoder also skips non-keyframes, in case the container doesn't flag keyframe packets.
+		decoder->skip_frame = AVDISCARD_NONKEY;
+		awaitingKeyframe[index] = false;
+	}
+	else if (decoder->skip_frame == AVDISCARD_NONKEY && !awaitingKeyframe[index])
+	{
+		// The decoder has no references for the packets that follow, so start over at the next keyframe. The packet
+		// loop switches back to full decoding once it's there.
+		NAV_FFCALL(avcodec_flush_buffers)(decoder);
+		awaitingKeyframe[index] = true;
+	}
+
+	return true;
+}
+
+uint32_t FFmpegState::getDecoderDelay(size_t index) const noexcept
+{
+	if (index >= decoders.size() || decoders[index] == nullptr)
+		return 0;
+
+	const AVCodecContext *decoder = decoders[index];
+	int delay = decoder->has_b_frames;
+	if (decoder->active_thread_type & FF_THREAD_FRAME)
+		delay += decoder->thread_count - 1;
+
+	return (uint32_t) std::max(delay, 0);
+}
+
+double FFmpegState::getDuration() noexcept
+{
+	return derationalize<int64_t>(formatContext->duration, AV_TIME_BASE);
+}
+
+double FFmpegState::getPosition() noexcept
+{
+	return position;
+}
+
+double FFmpegState::setPosition(double off)
+{
+	return seekTo(off, false);
+}
+
+double FFmpegState::setPositionAccurate(double off)
+{
+	seekTo(off, true);
+
+	for (size_t i = 0; i < decoders.size(); i++)
+		prerolling[i] = decoders[i] != nullptr;
+
+	seekTarget = off;
+	position = off;
+	return position;
+}
+
+double FFmpegState::seekTo(double off, bool accurate)
+{
+	int64_t pos = int64_t(off * AV_TIME_BASE);
+	int err = -1;
+
+	checkError(NAV_FFCALL(av_strerror), NAV_FFCALL(avformat_flush)(formatContext.get()));
+
+	// A keyframe after the target would make the frames before it unreachable.
+	if (accurate)
+		err = NAV_FFCALL(avformat_seek_file)(formatContext.get(), -1, std::numeric_limits<int64_t>::min(), pos, pos, 0);
+
+	// No keyframe before the target. The nearest one is the best there is.
+	if (err < 0)
+	{
+		checkError(
+			NAV_FFCALL(av_strerror),
+			NAV_FFCALL(avformat_seek_file)(
+				formatContext.get(),
+				-1,
+				std::numeric_limits<int64_t>::min(),
+				pos,
+				std::numeric_limits<int64_t>::max(),
+				0
+			)
+		);
+	}
+
+	for (AVCodecContext *decoder: decoders)
+	{
+		if (decoder)
+			NAV_FFCALL(avcodec_flush_buffers)(decoder);
+	}
+	// No need to flush swr as we're not doing sample-rate conversion.
 
 	position = derationalize<int64_t>(pos, AV_TIME_BASE);
 	eof = false;
+	prerolling.assign(prerolling.size(), false);
+	dropPrerollFrames();
 	return position;
 }
 
@@ -947,8 +1600,7 @@ bool FFmpegState::prepare()
 			if (formatContext->streams[i]->discard == AVDISCARD_ALL)
 			{
 				NAV_FFCALL(avcodec_free_context)(&decoders[i]);
-				NAV_FFCALL(swr_free)(&resamplers[i]);
-				NAV_FFCALL(sws_freeContext)(rescalers[i]);
+				converters[i] = std::make_shared<Converter>(f, nullptr, 0, nullptr, nullptr);
 				// Leave the streaminfo intact though, don't modify it.
 			}
 		}
@@ -966,211 +1618,622 @@ bool FFmpegState::isPrepared() const noexcept
 
 nav_frame_t *FFmpegState::read()
 {
-	while (true)
+	return readFrame(nullptr);
+}
+
+nav_frame_t *FFmpegState::readInto(const FrameTarget &target)
+{
+	return readFrame(&target);
+}
+
+bool FFmpegState::readBatch(nav_frame_t **out, size_t max, size_t *count)
+{
+	*count = 0;
+
+	if (max > 0 && (out[0] = readFrame(nullptr)) != nullptr)
+	{
+		// Collect frames the decoders already have without demuxing more packets.
+		for (*count = 1; *count < max; ++*count)
+		{
+			out[*count] = receiveFrame(nullptr);
+			if (out[*count] == nullptr)
+				break;
+		}
+	}
+
+	return true;
+}
+
+// Bumped whenever the layout below changes.
+static constexpr uint32_t PROBE_DATA_VERSION = 1;
+
+std::vector<uint8_t> FFmpegState::getProbeData()
+{
+	ProbeWriter writer;
+	writer.write<uint32_t>(PROBE_DATA_VERSION);
+	writer.write<uint32_t>(formatContext->nb_streams);
+	writer.write<int64_t>(formatContext->duration);
+
+	for (unsigned int i = 0; i < formatContext->nb_streams; i++)
+	{
+		const AVStream *stream = formatContext->streams[i];
+		const AVCodecParameters *codecpar = stream->codecpar;
+
+#if _NAV_FFMPEG_VERSION >= 6
+		int32_t nchannels = codecpar->ch_layout.nb_channels;
+		uint64_t channelMask = codecpar->ch_layout.order == AV_CHANNEL_ORDER_NATIVE ? codecpar->ch_layout.u.mask : 0;
+#else
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+		int32_t nchannels = codecpar->channels;
+		uint64_t channelMask = codecpar->channel_layout;
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+		writer.write<int32_t>(codecpar->codec_type);
+		writer.write<int32_t>(codecpar->codec_id);
+		writer.write<int32_t>(codecpar->format);
+		writer.write<int32_t>(codecpar->width);
+		writer.write<int32_t>(codecpar->height);
+		writer.write<int32_t>(codecpar->sample_rate);
+		writer.write<int32_t>(nchannels);
+		writer.write<uint64_t>(channelMask);
+		writer.write<int32_t>(stream->avg_frame_rate.num);
+		writer.write<int32_t>(stream->avg_frame_rate.den);
+
+		uint32_t extradataSize = codecpar->extradata ? (uint32_t) std::max(codecpar->extradata_size, 0) : 0;
+		writer.write<uint32_t>(extradataSize);
+		writer.writeBytes(codecpar->extradata, extradataSize);
+	}
+
+	return std::move(writer.data);
+}
+
+bool FFmpegState::setInput(nav_input *input, const char *filename)
+{
+	const nav_settings &settings = getSettings();
+	std::unique_ptr<InputContext> newInputContext;
+	UniqueAVIOContext newIOContext(nullptr, {NAV_FFCALL(avio_context_free)});
+	UniqueAVFormatContext newFormatContext(nullptr, NAV_FFCALL(avformat_free_context));
+
+	// Nothing is modified until the new input is known to be compatible.
+	f->openFormat(input, filename, settings, newInputContext, newIOContext, newFormatContext);
+
+	if (!settings.trust_headers || !hasCompleteHeaders(newFormatContext.get()))
+		checkError(NAV_FFCALL(av_strerror), NAV_FFCALL(avformat_find_stream_info)(newFormatContext.get(), nullptr));
+
+	if (!hasSameCodecParameters(formatContext.get(), newFormatContext.get()))
+		return false;
+
+	for (unsigned int i = 0; i < formatContext->nb_streams; i++)
+	{
+		AVStream *stream = newFormatContext->streams[i];
+		stream->discard = formatContext->streams[i]->discard;
+
+		if (streamInfo[i].type == NAV_STREAMTYPE_VIDEO)
+			streamInfo[i].video.fps = ffmpeg_common::derationalize(stream->avg_frame_rate);
+
+		if (decoders[i])
+			NAV_FFCALL(avcodec_flush_buffers)(decoders[i]);
+	}
+
+	std::swap(formatContext, newFormatContext);
+	std::swap(ioContext, newIOContext);
+	std::swap(inputContext, newInputContext);
+
+	// The format context refers to the I/O context, which refers to the input. That one is our own copy, so it's
+	// closed even if the caller refilled the same struct for the new input.
+	newFormatContext.reset();
+	newIOContext.reset();
+	if (newInputContext->input.userdata)
+		newInputContext->input.closef();
+
+	position = 0.0;
+	eof = false;
+	streamEofs.assign(streamEofs.size(), false);
+	prerolling.assign(prerolling.size(), false);
+	dropPrerollFrames();
+	seekTarget = 0.0;
+	return true;
+}
+
+bool FFmpegState::applyProbeData(const std::vector<uint8_t> &probeData)
+{
+	struct StreamRecord
+	{
+		AVMediaType codecType;
+		AVCodecID codecId;
+		int32_t format, width, height, sampleRate, nchannels;
+		uint64_t channelMask;
+		AVRational frameRate;
+		uint32_t extradataSize;
+		const uint8_t *extradata;
+	};
+
+	int64_t duration = 0;
+	std::vector<StreamRecord> records;
+
+	// Every record is checked first, so a mismatch doesn't leave the stream parameters half-modified.
+	try
 	{
-		int err = 0;
+		ProbeReader reader(probeData);
 
-		// We have existing packet lingering around?
-		if (tempPacket->buf)
+		if (reader.read<uint32_t>() != PROBE_DATA_VERSION)
+			return false;
+		// The container changed in a way the cache key didn't catch.
+		if (reader.read<uint32_t>() != formatContext->nb_streams)
+			return false;
+
+		duration = reader.read<int64_t>();
+		records.reserve(formatContext->nb_streams);
+
+		for (unsigned int i = 0; i < formatContext->nb_streams; i++)
 		{
-			// Pull frames
-			err = NAV_FFCALL(avcodec_receive_frame)(decoders[tempPacket->stream_index], tempFrame.get());
-			if (err >= 0)
+			const AVCodecParameters *codecpar = formatContext->streams[i]->codecpar;
+			StreamRecord record;
+
+			record.codecType = (AVMediaType) reader.read<int32_t>();
+			record.codecId = (AVCodecID) reader.read<int32_t>();
+			record.format = reader.read<int32_t>();
+			record.width = reader.read<int32_t>();
+			record.height = reader.read<int32_t>();
+			record.sampleRate = reader.read<int32_t>();
+			record.nchannels = reader.read<int32_t>();
+			record.channelMask = reader.read<uint64_t>();
+			record.frameRate = {reader.read<int32_t>(), reader.read<int32_t>()};
+			record.extradataSize = reader.read<uint32_t>();
+			record.extradata = reader.readBytes(record.extradataSize);
+
+			if (codecpar->codec_type != record.codecType)
+				return false;
+			if (codecpar->codec_id != AV_CODEC_ID_NONE && codecpar->codec_id != record.codecId)
+				return false;
+
+			records.push_back(record);
+		}
+
+		if (!reader.atEnd())
+			return false;
+	}
+	catch (const std::runtime_error &)
+	{
+		return false;
+	}
+
+	// Allocated before anything is modified too.
+	std::vector<uint8_t*> extradataCopies(records.size(), nullptr);
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		const AVCodecParameters *codecpar = formatContext->streams[i]->codecpar;
+		const StreamRecord &record = records[i];
+
+		if ((codecpar->extradata == nullptr || codecpar->extradata_size <= 0) && record.extradataSize > 0)
+		{
+			uint8_t *copy = (uint8_t*) NAV_FFCALL(av_mallocz)(size_t(record.extradataSize) + AV_INPUT_BUFFER_PADDING_SIZE);
+			if (copy == nullptr)
 			{
-				// Has frame
-				CallOnLeave<AVFrame> frameGuard(NAV_FFCALL(av_frame_unref), tempFrame.get());
-				position = ffmpeg_common::derationalize(
-					tempFrame->pts,
-					formatContext->streams[tempPacket->stream_index]->time_base
-				);
-				return decode(tempFrame.get(), tempPacket->stream_index);
+				for (uint8_t *&p: extradataCopies)
+					NAV_FFCALL(av_free)(p);
+				return false;
 			}
-			else
+
+			std::copy(record.extradata, record.extradata + record.extradataSize, copy);
+			extradataCopies[i] = copy;
+		}
+	}
+
+	if (formatContext->duration == AV_NOPTS_VALUE)
+		formatContext->duration = duration;
+
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		AVStream *stream = formatContext->streams[i];
+		AVCodecParameters *codecpar = stream->codecpar;
+		const StreamRecord &record = records[i];
+
+		// Only fill what the headers left out. Anything the demuxer did read takes precedence.
+		codecpar->codec_id = record.codecId;
+
+		if (codecpar->format < 0)
+			codecpar->format = record.format;
+
+		if (record.codecType == AVMEDIA_TYPE_VIDEO)
+		{
+			if (codecpar->width <= 0 || codecpar->height <= 0)
+			{
+				codecpar->width = record.width;
+				codecpar->height = record.height;
+			}
+
+			if (stream->avg_frame_rate.num <= 0)
+				stream->avg_frame_rate = record.frameRate;
+		}
+		else if (record.codecType == AVMEDIA_TYPE_AUDIO)
+		{
+			if (codecpar->sample_rate <= 0)
+				codecpar->sample_rate = record.sampleRate;
+
+#if _NAV_FFMPEG_VERSION >= 6
+			if (codecpar->ch_layout.nb_channels <= 0 && record.nchannels > 0)
+			{
+				if (
+					record.channelMask == 0 ||
+					NAV_FFCALL(av_channel_layout_from_mask)(&codecpar->ch_layout, record.channelMask) < 0
+				)
+					NAV_FFCALL(av_channel_layout_default)(&codecpar->ch_layout, record.nchannels);
+			}
+#else
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+			if (codecpar->channels <= 0 && record.nchannels > 0)
 			{
-				// No frame for now
+				codecpar->channels = record.nchannels;
+				codecpar->channel_layout = record.channelMask;
+			}
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+#endif
+		}
+
+		if (extradataCopies[i])
+		{
+			NAV_FFCALL(av_free)(codecpar->extradata);
+			codecpar->extradata = extradataCopies[i];
+			codecpar->extradata_size = (int) record.extradataSize;
+		}
+	}
+
+	return hasCompleteHeaders(formatContext.get());
+}
+
+nav_frame_t *FFmpegState::readFrame(const FrameTarget *target)
+{
+	while (true)
+	{
+		if (nav_frame_t *frame = receiveFrame(target))
+			return frame;
+
+		if (eof)
+			// This will be reached after all codecs are flushed.
+			return nullptr;
+
+		// Read packet
+		int err = NAV_FFCALL(av_read_frame)(formatContext.get(), tempPacket.get());
+		if (err == 0)
+		{
+			AVCodecContext *decoder = decoders[tempPacket->stream_index];
+
+			if (
+				formatContext->streams[tempPacket->stream_index]->discard == AVDISCARD_ALL ||
+				// Don't bother sending packets that the decoder will skip anyway.
+				(decoder->skip_frame == AVDISCARD_NONKEY && (tempPacket->flags & AV_PKT_FLAG_KEY) == 0)
+			)
 				NAV_FFCALL(av_packet_unref)(tempPacket.get());
+			else
+			{
+				if (awaitingKeyframe[tempPacket->stream_index])
+				{
+					decoder->skip_frame = AVDISCARD_DEFAULT;
+					awaitingKeyframe[tempPacket->stream_index] = false;
+				}
+
+				checkError(NAV_FFCALL(av_strerror), NAV_FFCALL(avcodec_send_packet)(decoder, tempPacket.get()));
+			}
+		}
+		else if (err == AVERROR_EOF)
+		{
+			// No more frames
+			for (AVCodecContext *decoder: decoders)
+			{
+				if (decoder)
+					NAV_FFCALL(avcodec_send_packet)(decoder, nullptr);
+			}
+
+			eof = true;
+		}
+		else
+			checkError(NAV_FFCALL(av_strerror), err);
+	}
+}
+
+nav_frame_t *FFmpegState::receiveFrame(const FrameTarget *target)
+{
+	int err = 0;
+
+	if (pendingFrame->buf[0])
+	{
+		CallOnLeave<AVFrame> frameGuard(NAV_FFCALL(av_frame_unref), pendingFrame.get());
+		position = pendingPosition;
+		return decode(pendingFrame.get(), pendingIndex, target);
+	}
+
+	// We have existing packet lingering around?
+	while (tempPacket->buf)
+	{
+		// Pull frames
+		err = NAV_FFCALL(avcodec_receive_frame)(decoders[tempPacket->stream_index], tempFrame.get());
+		if (err >= 0)
+		{
+			// Has frame
+			CallOnLeave<AVFrame> frameGuard(NAV_FFCALL(av_frame_unref), tempFrame.get());
+			position = getFramePosition(tempFrame.get(), tempPacket->stream_index);
+			if (!skipPreroll(tempFrame.get(), tempPacket->stream_index))
+				continue;
+
+			return decode(tempFrame.get(), tempPacket->stream_index, target);
+		}
+		else
+		{
+			// No frame for now
+			NAV_FFCALL(av_packet_unref)(tempPacket.get());
+
+			if (err != AVERROR_EOF && err != AVERROR(EAGAIN))
+				// Other error
+				checkError(NAV_FFCALL(av_strerror), err);
+		}
+	}
+
+	if (eof)
+	{
+		// Drain codec context
+		for (size_t i = 0; i < decoders.size(); i++)
+		{
+			AVCodecContext *codecContext = decoders[i];
+
+			while (codecContext && !streamEofs[i])
+			{
+				err = NAV_FFCALL(avcodec_receive_frame)(codecContext, tempFrame.get());
+				if (err >= 0)
+				{
+					// Has frame
+					CallOnLeave<AVFrame> frameGuard(NAV_FFCALL(av_frame_unref), tempFrame.get());
+					position = getFramePosition(tempFrame.get(), i);
+					if (!skipPreroll(tempFrame.get(), i))
+						continue;
 
-				if (err != AVERROR_EOF && err != AVERROR(EAGAIN))
-					// Other error
+					return decode(tempFrame.get(), i, target);
+				}
+				else if (err == AVERROR_EOF)
+				{
+					// No more frames
+					streamEofs[i] = true;
+
+					if (prerolling[i] && prerollFrames[i] && prerollFrames[i]->buf[0])
+					{
+						// The last frame is the one visible at the target.
+						CallOnLeave<AVFrame> frameGuard(NAV_FFCALL(av_frame_unref), prerollFrames[i].get());
+						prerolling[i] = false;
+						position = prerollPositions[i];
+						return decode(prerollFrames[i].get(), i, target);
+					}
+				}
+				else
+					// Unhandled error
 					checkError(NAV_FFCALL(av_strerror), err);
 			}
 		}
+	}
 
-		if (eof)
+	return nullptr;
+}
+
+bool FFmpegState::skipPreroll(AVFrame *frame, size_t index)
+{
+	if (!prerolling[index])
+		return true;
+
+	const nav_streaminfo_t &sinfo = streamInfo[index];
+
+	switch (sinfo.type)
+	{
+		case NAV_STREAMTYPE_AUDIO:
 		{
-			// Drain codec context
-			for (size_t i = 0; i < decoders.size(); i++)
+			// Trim to the exact sample. The decoder isn't resampling so the rate is the stream rate.
+			double skipped = (seekTarget - position) * sinfo.audio.sample_rate + 0.5;
+			if (skipped >= (double) frame->nb_samples)
+				return false;
+
+			if (skipped >= 1.0)
 			{
-				AVCodecContext *codecContext = decoders[i];
+				int nskip = (int) skipped;
+				AVSampleFormat format = (AVSampleFormat) frame->format;
+				size_t stride = (size_t) NAV_FFCALL(av_get_bytes_per_sample)(format) * nskip;
 
-				if (codecContext && !streamEofs[i])
+				if (NAV_FFCALL(av_sample_fmt_is_planar)(format))
 				{
-					err = NAV_FFCALL(avcodec_receive_frame)(codecContext, tempFrame.get());
-					if (err >= 0)
+					for (uint32_t i = 0; i < sinfo.audio.nchannels; i++)
 					{
-						// Has frame
-						CallOnLeave<AVFrame> frameGuard(NAV_FFCALL(av_frame_unref), tempFrame.get());
-						position = ffmpeg_common::derationalize(tempFrame->pts, formatContext->streams[i]->time_base);
-						return decode(tempFrame.get(), i);
+						frame->extended_data[i] += stride;
+						if (i < AV_NUM_DATA_POINTERS)
+							frame->data[i] = frame->extended_data[i];
 					}
-					else if (err == AVERROR_EOF)
-						// No more frames
-						streamEofs[i] = true;
-					else
-						// Unhandled error
-						checkError(NAV_FFCALL(av_strerror), err);
 				}
+				else
+				{
+					frame->data[0] += stride * sinfo.audio.nchannels;
+					frame->extended_data = frame->data;
+				}
+
+				frame->nb_samples -= nskip;
+				position = seekTarget;
 			}
 
-			// This will be reached after all codecs are flushed.
-			return nullptr;
+			break;
 		}
-		else
+		case NAV_STREAMTYPE_VIDEO:
 		{
-			// Read packet
-			err = NAV_FFCALL(av_read_frame)(formatContext.get(), tempPacket.get());
-			if (err == 0)
+			// Keep the frame that's visible at the target.
+			double duration = getFrameDuration(frame, index);
+			if (duration > 0.0)
 			{
-				if (formatContext->streams[tempPacket->stream_index]->discard == AVDISCARD_ALL)
-					NAV_FFCALL(av_packet_unref)(tempPacket.get());
-				else
-					checkError(NAV_FFCALL(av_strerror), NAV_FFCALL(avcodec_send_packet)(decoders[tempPacket->stream_index], tempPacket.get()));
+				if (position + duration <= seekTarget)
+					return false;
 			}
-			else if (err == AVERROR_EOF)
+			else
 			{
-				// No more frames
-				for (AVCodecContext *decoder: decoders)
+				UniqueAVFrame &held = prerollFrames[index];
+
+				if (position < seekTarget)
 				{
-					if (decoder)
-						NAV_FFCALL(avcodec_send_packet)(decoder, nullptr);
+					if (!held)
+					{
+						held.reset(NAV_FFCALL(av_frame_alloc)());
+						if (!held)
+							throw std::runtime_error("Cannot allocate AVFrame");
+					}
+
+					NAV_FFCALL(av_frame_unref)(held.get());
+					NAV_FFCALL(av_frame_move_ref)(held.get(), frame);
+					prerollPositions[index] = position;
+					return false;
 				}
 
-				eof = true;
+				if (position > seekTarget && held && held->buf[0])
+				{
+					// The held frame is still visible at the target. This one is returned after it.
+					NAV_FFCALL(av_frame_move_ref)(pendingFrame.get(), frame);
+					pendingIndex = index;
+					pendingPosition = position;
+					NAV_FFCALL(av_frame_move_ref)(frame, held.get());
+					position = prerollPositions[index];
+				}
 			}
-			else
-				checkError(NAV_FFCALL(av_strerror), err);
+
+			break;
 		}
+		default:
+			break;
+	}
+
+	prerolling[index] = false;
+	if (prerollFrames[index])
+		NAV_FFCALL(av_frame_unref)(prerollFrames[index].get());
+	return true;
+}
+
+double FFmpegState::getFramePosition(const AVFrame *frame, size_t index) const noexcept
+{
+	int64_t pts = frame->pts != AV_NOPTS_VALUE ? frame->pts : frame->best_effort_timestamp;
+	if (pts == AV_NOPTS_VALUE)
+		return position;
+
+	return ffmpeg_common::derationalize(pts, formatContext->streams[index]->time_base);
+}
+
+double FFmpegState::getFrameDuration(const AVFrame *frame, size_t index) const noexcept
+{
+#if _NAV_FFMPEG_VERSION >= 6
+	int64_t duration = frame->duration;
+#else
+	int64_t duration = frame->pkt_duration;
+#endif
+
+	if (duration <= 0)
+		return 0.0;
+
+	return ffmpeg_common::derationalize(duration, formatContext->streams[index]->time_base);
+}
+
+void FFmpegState::dropPrerollFrames() noexcept
+{
+	for (UniqueAVFrame &frame: prerollFrames)
+	{
+		if (frame)
+			NAV_FFCALL(av_frame_unref)(frame.get());
 	}
+
+	NAV_FFCALL(av_frame_unref)(pendingFrame.get());
 }
 
-nav_frame_t *FFmpegState::decode(AVFrame *frame, size_t index)
+nav_frame_t *FFmpegState::decode(AVFrame *frame, size_t index, const FrameTarget *target)
 {
 	nav_streaminfo_t *streamInfo = &this->streamInfo[index];
+	const std::shared_ptr<Converter> &converter = converters[index];
 
 	switch (streamInfo->type)
 	{
 		case NAV_STREAMTYPE_AUDIO:
 		{
+			if (frame->format != converter->sampleSource)
+			{
+				// The stream parameters came from the headers or the probe cache, and the decoder disagrees. Frames
+				// decoded so far keep the old converter.
+				converters[index] = std::make_shared<Converter>(f, conversionPool, poolPriority, nullptr, nullptr);
+				if (!setupResampler(index, toAVSampleFormat(streamInfo->audio.format), (AVSampleFormat) frame->format))
+					throw std::runtime_error(nav::error::get());
+			}
+
 			// Decode audio
-			SwrContext *resampler = resamplers[index];
-			if (resampler == nullptr)
+			if (converter->resampler == nullptr && !converter->packer)
+			{
 				// Skipping conversion
-				return new FFmpegFrame(f, streamInfo, tempFrame.get(), decoders[index], position, index);
-
-#ifdef __GNUC__
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
-#endif
-			std::unique_ptr<FrameVector> result(new FrameVector(
-				streamInfo,
-				index,
-				position,
-				resampler ? nullptr : frame->data[0],
-				(
-					((size_t) frame->nb_samples)
-#if _NAV_FFMPEG_VERSION >= 6
-					* frame->ch_layout.nb_channels
-#else
-					* frame->channels
-#endif
-					* NAV_AUDIOFORMAT_BYTESIZE(streamInfo->audio.format)
-				)
-			));
-#ifdef __GNUC__
-#pragma GCC diagnostic pop
-#endif
+				nav_frame_t *result = framePools[index]->make<FFmpegFrame>(f, streamInfo, frame, decoders[index], position, index, nullptr);
+				return target ? copyFrameToTarget(result, *target) : result;
+			}
 
-			if (resampler)
-			{
-				uint8_t *tempBuffer[AV_NUM_DATA_POINTERS] = {result->pointer(), nullptr};
+			if (target == nullptr)
+				// Convert on first acquire, so frames that are dropped unacquired are cheap.
+				return framePools[index]->make<FFmpegFrame>(f, streamInfo, frame, decoders[index], position, index, converter);
 
-				checkError(
-					NAV_FFCALL(av_strerror),
-					NAV_FFCALL(swr_convert)(resampler, tempBuffer, frame->nb_samples, (const uint8_t**) frame->data, frame->nb_samples)
-				);
-			}
+			size_t needSize = ((size_t) frame->nb_samples) * streamInfo->audio.size();
+			std::unique_ptr<FrameVector> result(
+				target->fits(index, streamInfo, needSize)
+				? framePools[index]->make<FrameVector>(streamInfo, index, position, *target, needSize)
+				: framePools[index]->make<FrameVector>(streamInfo, index, position, nullptr, needSize)
+			);
 
+			converter->resample(frame, result->pointer());
 			return result.release();
 		}
 		case NAV_STREAMTYPE_VIDEO:
 		{
 			// Decode video
-			SwsContext *rescaler = rescalers[index];
-			if (rescaler == nullptr)
+			if (converter->rescaler == nullptr)
+			{
 				// Skipping conversion
-				return new FFmpegFrame(f, streamInfo, tempFrame.get(), decoders[index], position, index);
+				nav_frame_t *result = framePools[index]->make<FFmpegFrame>(f, streamInfo, frame, decoders[index], position, index, nullptr);
+				return target ? copyFrameToTarget(result, *target) : result;
+			}
 
-			size_t needSize = streamInfo->video.size();
-			uint8_t *bufferSetup[AV_NUM_DATA_POINTERS] = {nullptr};
-			size_t dimension = ((size_t) streamInfo->video.width) * streamInfo->video.height;
-			int linesizeSetup[AV_NUM_DATA_POINTERS] = {0};
-			std::unique_ptr<FrameVector> result(new FrameVector(streamInfo, index, position, nullptr, needSize));
+			if (target == nullptr)
+				// Convert (and download hardware frames) on first acquire.
+				return framePools[index]->make<FFmpegFrame>(f, streamInfo, frame, decoders[index], position, index, converter);
 
-			// Setup buffers and linesize
-			switch (streamInfo->video.format)
+			// Converting hardware frames needs them downloaded first.
+			AVFrame *source = frame;
+			std::optional<CallOnLeave<AVFrame>> transferGuard;
+			if (frame->hw_frames_ctx)
 			{
-				default:
-					throw std::runtime_error("internal error @ " __FILE__ ":" NAV_STRINGIZE(__LINE__) ". Please report!");
-				case NAV_PIXELFORMAT_RGB8:
+				if (!hwTransferFrame)
 				{
-					bufferSetup[0] = result->pointer();
-					linesizeSetup[0] = (int) streamInfo->video.width * 3;
-					break;
-				}
-				case NAV_PIXELFORMAT_YUV420:
-				{
-					size_t halfdim = ((size_t) (streamInfo->video.width + 1) / 2) * ((streamInfo->video.height + 1) / 2);
-					bufferSetup[0] = result->pointer();
-					linesizeSetup[0] = streamInfo->video.width;
-					bufferSetup[1] = bufferSetup[0] + dimension;
-					linesizeSetup[1] = (streamInfo->video.width + 1) / 2;
-					bufferSetup[2] = bufferSetup[1] + halfdim;
-					linesizeSetup[2] = linesizeSetup[1];
-					break;
-				}
-				case NAV_PIXELFORMAT_YUV444:
-				{
-					bufferSetup[0] = result->pointer();
-					linesizeSetup[0] = streamInfo->video.width;
-					bufferSetup[1] = bufferSetup[0] + dimension;
-					linesizeSetup[1] = streamInfo->video.width;
-					bufferSetup[2] = bufferSetup[1] + dimension;
-					linesizeSetup[2] = linesizeSetup[1];
-					break;
-				}
-				case NAV_PIXELFORMAT_NV12:
-				{
-					bufferSetup[0] = result->pointer();
-					linesizeSetup[0] = streamInfo->video.width;
-					bufferSetup[1] = bufferSetup[0] + dimension;
-					linesizeSetup[1] = ((streamInfo->video.width + 1) / 2) * 2;
-					break;
+					hwTransferFrame.reset(NAV_FFCALL(av_frame_alloc)());
+					if (!hwTransferFrame)
+						throw std::runtime_error("Cannot allocate AVFrame");
 				}
+
+				checkError(NAV_FFCALL(av_strerror), NAV_FFCALL(av_hwframe_transfer_data)(hwTransferFrame.get(), frame, 0));
+				transferGuard.emplace(NAV_FFCALL(av_frame_unref), hwTransferFrame.get());
+				source = hwTransferFrame.get();
 			}
 
-			// Rescale handles flip.
-			checkError(
-				NAV_FFCALL(av_strerror),
-				NAV_FFCALL(sws_scale)(
-					rescaler,
-					frame->data,
-					frame->linesize,
-					0,
-					streamInfo->video.height,
-					bufferSetup,
-					linesizeSetup
-				)
+			std::unique_ptr<FrameVector> result(
+				target->fits(index, streamInfo, 0)
+				? framePools[index]->make<FrameVector>(streamInfo, index, position, *target, 0)
+				: framePools[index]->make<FrameVector>(streamInfo, index, position, nullptr, streamInfo->video.size())
 			);
+
+			// Setup buffers and linesize
+			ptrdiff_t *strides = nullptr;
+			size_t nplanes = 0;
+			const uint8_t *const *planes = result->acquire(&strides, &nplanes);
+			converter->rescale(source, (uint8_t *const *) planes, strides, nplanes);
 			return result.release();
 		}
 		default:
@@ -1178,6 +2241,192 @@ nav_frame_t *FFmpegState::decode(AVFrame *frame, size_t index)
 	}
 }
 
+bool FFmpegState::canReconfigure(size_t index, nav_streamtype type)
+{
+	if (index >= streamInfo.size())
+	{
+		nav::error::set("Stream index out of range");
+		return false;
+	}
+
+	if (prepared)
+	{
+		nav::error::set("Decoder already initialized");
+		return false;
+	}
+
+	if (streamInfo[index].type != type)
+	{
+		nav::error::set(type == NAV_STREAMTYPE_VIDEO ? "Not a video stream" : "Not an audio stream");
+		return false;
+	}
+
+	return true;
+}
+
+SwsContext *FFmpegState::createRescaler(
+	int srcWidth,
+	int srcHeight,
+	AVPixelFormat srcFormat,
+	int dstWidth,
+	int dstHeight,
+	AVPixelFormat dstFormat,
+	int flags
+)
+{
+#if _NAV_FFMPEG_VERSION >= 5
+	SwsContext *rescaler = NAV_FFCALL(sws_alloc_context)();
+	if (rescaler == nullptr)
+		return nullptr;
+
+	NAV_FFCALL(av_opt_set_int)(rescaler, "srcw", srcWidth, 0);
+	NAV_FFCALL(av_opt_set_int)(rescaler, "srch", srcHeight, 0);
+	NAV_FFCALL(av_opt_set_int)(rescaler, "src_format", srcFormat, 0);
+	NAV_FFCALL(av_opt_set_int)(rescaler, "dstw", dstWidth, 0);
+	NAV_FFCALL(av_opt_set_int)(rescaler, "dsth", dstHeight, 0);
+	NAV_FFCALL(av_opt_set_int)(rescaler, "dst_format", dstFormat, 0);
+	NAV_FFCALL(av_opt_set_int)(rescaler, "sws_flags", flags, 0);
+	// Slice threads
+	NAV_FFCALL(av_opt_set_int)(rescaler, "threads", maxThreads, 0);
+
+	if (NAV_FFCALL(sws_init_context)(rescaler, nullptr, nullptr) < 0)
+	{
+		NAV_FFCALL(sws_freeContext)(rescaler);
+		return nullptr;
+	}
+
+	return rescaler;
+#else
+	return NAV_FFCALL(sws_getContext)(
+		srcWidth,
+		srcHeight,
+		srcFormat,
+		dstWidth,
+		dstHeight,
+		dstFormat,
+		flags, nullptr, nullptr, nullptr
+	);
+#endif
+}
+
+bool FFmpegState::setupRescaler(size_t index, const nav_streaminfo_t::VideoStreamInfo &video, int flags)
+{
+	AVCodecParameters *codecpar = formatContext->streams[index]->codecpar;
+	AVPixelFormat targetFormat = toAVPixelFormat(video.format);
+	SwsContext *rescaler = nullptr;
+
+	if (
+		targetFormat != sourceFormats[index] ||
+		video.width != (uint32_t) codecpar->width ||
+		video.height != (uint32_t) codecpar->height
+	)
+	{
+		rescaler = createRescaler(
+			codecpar->width,
+			codecpar->height,
+			sourceFormats[index],
+			(int) video.width,
+			(int) video.height,
+			targetFormat,
+			flags
+		);
+
+		if (rescaler == nullptr)
+		{
+			nav::error::set("Cannot convert to the requested pixel format or dimensions");
+			return false;
+		}
+	}
+
+	{
+		std::lock_guard lg(converters[index]->mutex);
+		NAV_FFCALL(sws_freeContext)(converters[index]->rescaler);
+		converters[index]->rescaler = rescaler;
+		converters[index]->setTarget(
+			sourceFormats[index],
+			video,
+			video.width == (uint32_t) codecpar->width && video.height == (uint32_t) codecpar->height
+		);
+	}
+
+	streamInfo[index].video = video;
+	scaleFlags[index] = flags;
+	return true;
+}
+
+bool FFmpegState::setupResampler(size_t index, AVSampleFormat format, AVSampleFormat source)
+{
+	AVCodecParameters *codecpar = formatContext->streams[index]->codecpar;
+	AVSampleFormat sourceFormat = source != AV_SAMPLE_FMT_NONE ? source : (AVSampleFormat) codecpar->format;
+	size_t nchannels = streamInfo[index].audio.nchannels;
+	bool planar = NAV_FFCALL(av_sample_fmt_is_planar)(sourceFormat);
+	std::optional<AudioConverter> packer;
+	SwrContext *resampler = nullptr;
+
+	// The common cases don't need a resampler.
+	if (format == AV_SAMPLE_FMT_S16 && NAV_FFCALL(av_get_packed_sample_fmt)(sourceFormat) == AV_SAMPLE_FMT_FLT)
+		packer = AudioConverter::floatToS16(nchannels, planar);
+	else if (format == NAV_FFCALL(av_get_packed_sample_fmt)(sourceFormat))
+	{
+		if (planar)
+			packer = AudioConverter::interleave((size_t) NAV_FFCALL(av_get_bytes_per_sample)(sourceFormat), nchannels);
+	}
+	else
+	{
+#if _NAV_FFMPEG_VERSION >= 6
+		if (NAV_FFCALL(swr_alloc_set_opts2)(
+			&resampler,
+			&codecpar->ch_layout,
+			format,
+			codecpar->sample_rate,
+			&codecpar->ch_layout,
+			sourceFormat,
+			codecpar->sample_rate,
+			0, nullptr
+		) < 0)
+			resampler = nullptr;
+#else
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+		resampler = NAV_FFCALL(swr_alloc_set_opts)(
+			nullptr,
+			codecpar->channel_layout,
+			format,
+			codecpar->sample_rate,
+			codecpar->channel_layout,
+			sourceFormat,
+			codecpar->sample_rate,
+			0, nullptr
+		);
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+		if (resampler && NAV_FFCALL(swr_init)(resampler) < 0)
+			NAV_FFCALL(swr_free)(&resampler);
+
+		if (resampler == nullptr)
+		{
+			nav::error::set("Cannot convert to the requested audio format");
+			return false;
+		}
+	}
+
+	{
+		std::lock_guard lg(converters[index]->mutex);
+		NAV_FFCALL(swr_free)(&converters[index]->resampler);
+		converters[index]->resampler = resampler;
+		converters[index]->sampleSource = sourceFormat;
+		converters[index]->packer = std::move(packer);
+	}
+
+	streamInfo[index].audio.format = audioFormatFromAVSampleFormat(format);
+	return true;
+}
+
 bool FFmpegState::canDecode(size_t index)
 {
 	return streamInfo[index].type != NAV_STREAMTYPE_UNKNOWN && formatContext->streams[index]->discard == AVDISCARD_ALL;
@@ -1210,6 +2459,62 @@ AVPixelFormat FFmpegState::pickPixelFormat(AVCodecContext *s, const AVPixelForma
 	return AV_PIX_FMT_NONE;
 }
 
+int FFmpegState::executeInPool(
+	AVCodecContext *c,
+	int (*func)(AVCodecContext *c2, void *arg),
+	void *arg,
+	int *ret,
+	int count,
+	int size
+) noexcept
+{
+	FFmpegState *self = (FFmpegState*) c->opaque;
+
+	try
+	{
+		self->conversionPool->parallelFor((size_t) std::max(count, 0), [&](size_t i)
+		{
+			int r = func(c, (uint8_t*) arg + i * size);
+			if (ret)
+				ret[i] = r;
+		}, self->poolPriority);
+	}
+	catch (const std::exception &)
+	{
+		return AVERROR(ENOMEM);
+	}
+
+	return 0;
+}
+
+int FFmpegState::executeInPool2(
+	AVCodecContext *c,
+	int (*func)(AVCodecContext *c2, void *arg, int jobnr, int threadnr),
+	void *arg,
+	int *ret,
+	int count
+) noexcept
+{
+	FFmpegState *self = (FFmpegState*) c->opaque;
+
+	try
+	{
+		// Decoders index their per-thread data with threadnr, which must be below thread_count.
+		self->conversionPool->parallelFor((size_t) std::max(count, 0), [&](size_t i, size_t slot)
+		{
+			int r = func(c, arg, (int) i, (int) slot);
+			if (ret)
+				ret[i] = r;
+		}, self->poolPriority, (size_t) std::max(c->thread_count, 1));
+	}
+	catch (const std::exception &)
+	{
+		return AVERROR(ENOMEM);
+	}
+
+	return 0;
+}
+
 #undef NAV_FFCALL
 #define NAV_FFCALL(n) this->func_##n
 
@@ -1249,23 +2554,51 @@ FFmpegBackend::~FFmpegBackend()
 
 State *FFmpegBackend::open(nav_input *input, const char *filename, const nav_settings *settings)
 {
-	constexpr int BUFSIZE = 4096;
+	return openCached(input, filename, settings, std::vector<uint8_t>());
+}
+
+State *FFmpegBackend::openCached(
+	nav_input *input,
+	const char *filename,
+	const nav_settings *settings,
+	const std::vector<uint8_t> &probeData
+)
+{
+	std::unique_ptr<InputContext> inputContext;
+	UniqueAVIOContext ioContext(nullptr, {NAV_FFCALL(avio_context_free)});
+	UniqueAVFormatContext formatContext(nullptr, NAV_FFCALL(avformat_free_context));
 
-	UniqueAVFormatContext formatContext(NAV_FFCALL(avformat_alloc_context)(), NAV_FFCALL(avformat_free_context));
+	openFormat(input, filename, *settings, inputContext, ioContext, formatContext);
+	return new FFmpegState(this, inputContext, formatContext, ioContext, *settings, probeData);
+}
+
+void FFmpegBackend::openFormat(
+	nav_input *input,
+	const char *filename,
+	const nav_settings &settings,
+	std::unique_ptr<InputContext> &inputContext,
+	UniqueAVIOContext &ioContext,
+	UniqueAVFormatContext &formatContext
+)
+{
+	int bufsize = (int) std::min<uint32_t>(settings.io_buffer_size, INT_MAX);
+
+	inputContext.reset(new InputContext {*input, input->sizef(), input->tellf()});
+
+	formatContext.reset(NAV_FFCALL(avformat_alloc_context)());
 	if (!formatContext)
 		throw std::runtime_error("Cannot allocate AVFormatContext");
 
-	UniqueAVIOContext ioContext(
+	ioContext.reset(
 		NAV_FFCALL(avio_alloc_context)(
-			(unsigned char*) NAV_FFCALL(av_malloc)(BUFSIZE),
-			BUFSIZE,
+			(unsigned char*) NAV_FFCALL(av_malloc)(bufsize),
+			bufsize,
 			0,
-			input,
+			inputContext.get(),
 			inputRead,
 			nullptr,
 			inputSeek
-		),
-		{NAV_FFCALL(avio_context_free)}
+		)
 	);
 	if (!ioContext)
 		throw std::runtime_error("Cannot allocate AVIOContext");
@@ -1273,6 +2606,12 @@ State *FFmpegBackend::open(nav_input *input, const char *filename, const nav_set
 	formatContext->pb = ioContext.get();
 	formatContext->flags |= AVFMT_FLAG_CUSTOM_IO;
 
+	// Both must be set before probing the format. FFmpeg wants a probe size of at least 32 bytes.
+	if (settings.probe_size > 0)
+		formatContext->probesize = (int64_t) std::clamp<uint64_t>(settings.probe_size, 32, INT64_MAX);
+	if (settings.analyze_duration > 0.0)
+		formatContext->max_analyze_duration = (int64_t) (std::min(settings.analyze_duration, 1e9) * AV_TIME_BASE);
+
 	AVFormatContext *tempFormatContext = formatContext.get();
 	int errcode = 0;
 
@@ -1281,8 +2620,6 @@ State *FFmpegBackend::open(nav_input *input, const char *filename, const nav_set
 		formatContext.release(); // prevent double-free
 		throwFromAVError(NAV_FFCALL(av_strerror), errcode);
 	}
-
-	return new FFmpegState(this, formatContext, ioContext, *settings);
 }
 
 const char *FFmpegBackend::getName() const noexcept
@@ -1330,11 +2667,63 @@ const char *FFmpegBackend::getInfo()
 	return info.c_str();
 }
 
-Backend *create()
+bool FFmpegBackend::canOpen(ContainerType container)
 {
-	if (checkBackendDisabled(_NAV_FFMPEG_DISABLEMENT) || checkBackendDisabled("FFMPEG"))
-		return nullptr;
+	const char *demuxer = nullptr;
 
+	switch (container)
+	{
+		default:
+			break;
+		case ContainerType::ISOBMFF:
+			demuxer = "mov";
+			break;
+		case ContainerType::MATROSKA:
+			demuxer = "matroska";
+			break;
+		case ContainerType::OGG:
+			demuxer = "ogg";
+			break;
+		case ContainerType::WAVE:
+			demuxer = "wav";
+			break;
+		case ContainerType::AVI:
+			demuxer = "avi";
+			break;
+		case ContainerType::FLAC:
+			demuxer = "flac";
+			break;
+		case ContainerType::MP3:
+			demuxer = "mp3";
+			break;
+		case ContainerType::ADTS:
+			demuxer = "aac";
+			break;
+		case ContainerType::MPEGTS:
+			demuxer = "mpegts";
+			break;
+		case ContainerType::MPEGPS:
+			demuxer = "mpeg";
+			break;
+		case ContainerType::FLV:
+			demuxer = "flv";
+			break;
+		case ContainerType::ASF:
+			demuxer = "asf";
+			break;
+	}
+
+	// Builds can leave out demuxers.
+	return demuxer == nullptr || NAV_FFCALL(av_find_input_format)(demuxer) != nullptr;
+}
+
+static bool isDisabled()
+{
+	return checkBackendDisabled(_NAV_FFMPEG_DISABLEMENT) || checkBackendDisabled("FFMPEG");
+}
+
+Backend *create()
+{
 	try
 	{
 		return new FFmpegBackend();
@@ -1346,6 +2735,14 @@ Backend *create()
 	}
 }
 
+const BackendDescriptor descriptor = {
+	NAV_STRINGIZE(_NAV_FFMPEG_NAMESPACE),
+	NAV_BACKENDTYPE_3RD_PARTY,
+	false,
+	isDisabled,
+	create
+};
+
 }
 
 #endif /* _NAV_FFMPEG_VERSION */
@@ -13,6 +13,7 @@
 namespace nav::_NAV_FFMPEG_NAMESPACE
 {
 
+extern const BackendDescriptor descriptor;
 Backend *create();
 
 }
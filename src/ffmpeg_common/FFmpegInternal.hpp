@@ -4,14 +4,20 @@
 #define _NAV_BACKEND_FFMPEG_INTERNAL_
 
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <vector>
 
 #include "Internal.hpp"
 #include "Backend.hpp"
+#include "Common.hpp"
 #include "FFmpegBackend.hpp"
 #include "FFmpegCommon.hpp"
+#include "AudioConvert.hpp"
 #include "DynLib.hpp"
+#include "PixelConvert.hpp"
+#include "ThreadPool.hpp"
 
 namespace nav::_NAV_FFMPEG_NAMESPACE
 {
@@ -24,6 +30,53 @@ using UniqueAVFrame = std::unique_ptr<AVFrame, ffmpeg_common::DoublePointerDelet
 
 class FFmpegBackend;
 
+// Opaque of the AVIOContext. The size is queried once. With read_at, the position is tracked here too, so seeking
+// doesn't touch the input at all.
+struct InputContext
+{
+	// Copied, as the caller's struct is undefined after a successful open and may be reused.
+	nav_input input;
+	uint64_t size, position;
+};
+
+// Conversion contexts of a stream. Frames share it to convert on their first acquire, which can happen on any thread,
+// so the contexts must only be used with the mutex held.
+struct Converter
+{
+	Converter(
+		FFmpegBackend *backend,
+		const std::shared_ptr<ThreadPool> &pool,
+		int priority,
+		SwsContext *rescaler,
+		SwrContext *resampler
+	) noexcept;
+	Converter(const Converter &) = delete;
+	~Converter();
+	void rescale(const AVFrame *source, uint8_t *const *planes, const ptrdiff_t *strides, size_t nplanes);
+	void resample(const AVFrame *source, uint8_t *dest);
+	// Records the output of the rescaler, and uses the built-in converter instead for same-size conversions it
+	// supports. Caller must hold the mutex if frames may already be converting.
+	void setTarget(AVPixelFormat from, const nav_streaminfo_t::VideoStreamInfo &to, bool sameSize) noexcept;
+
+	FFmpegBackend *f;
+	std::mutex mutex;
+	// Splits the built-in conversion into slices. Rescaler has its own threads, except with the shared pool.
+	std::shared_ptr<ThreadPool> pool;
+	int priority;
+	SwsContext *rescaler;
+	SwrContext *resampler;
+	// Wraps the output buffer for the rescaler.
+	AVFrame *destination;
+	int targetWidth, targetHeight;
+	AVPixelFormat targetFormat;
+	AVPixelFormat fastFormat;
+	std::optional<PixelConverter> fast;
+	// Decoded sample format that the resampler or packer is set up for.
+	AVSampleFormat sampleSource;
+	// Replaces the resampler when only interleaving or float to 16-bit conversion is needed.
+	std::optional<AudioConverter> packer;
+};
+
 class FFmpegFrame: public Frame
 {
 public:
@@ -33,9 +86,19 @@ public:
 		AVFrame *frame,
 		const AVCodecContext *cctx,
 		double pts,
-		size_t si
+		size_t si,
+		const std::shared_ptr<Converter> &conv
 	);
 	~FFmpegFrame() override;
+	void reset(
+		FFmpegBackend *backend,
+		nav_streaminfo_t *sinfo,
+		AVFrame *frame,
+		const AVCodecContext *cctx,
+		double pts,
+		size_t si,
+		const std::shared_ptr<Converter> &conv
+	);
 	size_t getStreamIndex() const noexcept override;
 	const nav_streaminfo_t *getStreamInfo() const noexcept override;
 	double tell() const noexcept override;
@@ -43,54 +106,148 @@ public:
 	void release() noexcept override;
 	nav_hwacceltype getHWAccelType() const noexcept override;
 	void *getHWAccelHandle() override;
+	void recycle() noexcept override;
+	void detach() noexcept override;
 
 private:
+	void convert(const AVFrame *source);
+
 	AcquireData acquireData;
-	AVFrame *frame;
+	AVFrame *frame, *swFrame;
 	const AVCodecContext *codecContext;
 	FFmpegBackend *f;
 	nav_streaminfo_t *streamInfo;
 	double pts;
 	size_t index;
+	// If set, `frame` is converted to `streamInfo` format on first acquire.
+	std::shared_ptr<Converter> converter;
+	AlignedBuffer converted;
 };
 
 class FFmpegState: public State
 {
 public:
-	FFmpegState(FFmpegBackend *backend, UniqueAVFormatContext &formatContext, UniqueAVIOContext &ioContext, const nav_settings &settings);
+	FFmpegState(
+		FFmpegBackend *backend,
+		std::unique_ptr<InputContext> &inputContext,
+		UniqueAVFormatContext &formatContext,
+		UniqueAVIOContext &ioContext,
+		const nav_settings &settings,
+		const std::vector<uint8_t> &probeData
+	);
 	~FFmpegState() override;
 	Backend *getBackend() const noexcept override;
 	size_t getStreamCount() const noexcept override;
 	const nav_streaminfo_t *getStreamInfo(size_t index) const noexcept override;
 	bool isStreamEnabled(size_t index) const noexcept override;
 	bool setStreamEnabled(size_t index, bool enabled) override;
+	bool setPixelFormat(size_t index, nav_pixelformat format) override;
+	bool setVideoSize(size_t index, uint32_t width, uint32_t height, nav_scaler scaler) override;
+	bool setKeyframesOnly(size_t index, bool keyframesOnly) override;
+	bool setAudioFormat(size_t index, nav_audioformat format) override;
+	uint32_t getDecoderDelay(size_t index) const noexcept override;
 	double getDuration() noexcept override;
 	double getPosition() noexcept override;
 	double setPosition(double off) override;
+	double setPositionAccurate(double off) override;
 	bool prepare() override;
 	bool isPrepared() const noexcept override;
 	nav_frame_t *read() override;
+	nav_frame_t *readInto(const FrameTarget &target) override;
+	bool readBatch(nav_frame_t **out, size_t max, size_t *count) override;
+	std::vector<uint8_t> getProbeData() override;
+	bool setInput(nav_input *input, const char *filename) override;
 
 private:
-	nav_frame_t *decode(AVFrame *frame, size_t index);
+	// Fills stream parameters missing from the headers using data of getProbeData(). Returns true if no stream info
+	// probing is needed afterwards.
+	bool applyProbeData(const std::vector<uint8_t> &probeData);
+	nav_frame_t *readFrame(const FrameTarget *target);
+	// Returns frame that's ready without reading more packets, or NULL.
+	nav_frame_t *receiveFrame(const FrameTarget *target);
+	nav_frame_t *decode(AVFrame *frame, size_t index, const FrameTarget *target);
 	bool canDecode(size_t index);
+	// Returns false if the whole frame is before the accurate seek target. Otherwise audio is trimmed to start there.
+	// A video frame of unknown duration is held until the next one shows whether it's visible at the target.
+	bool skipPreroll(AVFrame *frame, size_t index);
+	// Seeks the demuxer to the keyframe nearest to `off`, or with `accurate`, the last one not after it.
+	double seekTo(double off, bool accurate);
+	// Timestamp of the frame in seconds, or the current position if it has none.
+	double getFramePosition(const AVFrame *frame, size_t index) const noexcept;
+	// 0 if the frame duration is unknown.
+	double getFrameDuration(const AVFrame *frame, size_t index) const noexcept;
+	void dropPrerollFrames() noexcept;
+	bool canReconfigure(size_t index, nav_streamtype type);
+	// Converts from the decoded format and dimensions to `video` format and dimensions in one pass.
+	bool setupRescaler(size_t index, const nav_streaminfo_t::VideoStreamInfo &video, int flags);
+	// Uses `maxThreads` slice threads where supported.
+	SwsContext *createRescaler(
+		int srcWidth,
+		int srcHeight,
+		AVPixelFormat srcFormat,
+		int dstWidth,
+		int dstHeight,
+		AVPixelFormat dstFormat,
+		int flags
+	);
+	// Converts from `source` to packed `format`, keeping the sample rate and channel layout. `source` defaults to the
+	// sample format in the stream parameters.
+	bool setupResampler(size_t index, AVSampleFormat format, AVSampleFormat source = AV_SAMPLE_FMT_NONE);
 	std::vector<AVHWDeviceType> getHWAccels();
 	static AVPixelFormat pickPixelFormat(AVCodecContext *s, const AVPixelFormat *fmt) noexcept;
+	// AVCodecContext::execute and execute2 that run the slices in the conversion pool. Only used with the shared pool.
+	static int executeInPool(
+		AVCodecContext *c,
+		int (*func)(AVCodecContext *c2, void *arg),
+		void *arg,
+		int *ret,
+		int count,
+		int size
+	) noexcept;
+	static int executeInPool2(
+		AVCodecContext *c,
+		int (*func)(AVCodecContext *c2, void *arg, int jobnr, int threadnr),
+		void *arg,
+		int *ret,
+		int count
+	) noexcept;
 
 	FFmpegBackend *f;
+	std::unique_ptr<InputContext> inputContext;
 	UniqueAVFormatContext formatContext;
 	UniqueAVIOContext ioContext;
 	UniqueAVPacket tempPacket;
 	UniqueAVFrame tempFrame;
+	UniqueAVFrame hwTransferFrame;
 	double position;
 	bool eof;
 	bool prepared;
+	uint32_t maxThreads;
+	bool sharedPool;
+	// Either owned by this instance or the shared pool.
+	std::shared_ptr<ThreadPool> conversionPool;
+	int poolPriority;
 
 	std::vector<nav_streaminfo_t> streamInfo;
 	std::vector<AVCodecContext*> decoders;
-	std::vector<SwrContext*> resamplers;
-	std::vector<SwsContext*> rescalers;
+	std::vector<std::shared_ptr<Converter>> converters;
+	// Decoded (or downloaded, for hardware frames) pixel format of video streams.
+	std::vector<AVPixelFormat> sourceFormats;
+	std::vector<int> scaleFlags;
 	std::vector<bool> streamEofs;
+	// Streams that haven't reached the accurate seek target yet.
+	std::vector<bool> prerolling;
+	// Video streams that left keyframe-only mode. They keep skipping packets until the next keyframe.
+	std::vector<bool> awaitingKeyframe;
+	double seekTarget;
+	// Last video frame before the seek target, per stream, and its position. Allocated on first use.
+	std::vector<UniqueAVFrame> prerollFrames;
+	std::vector<double> prerollPositions;
+	// Frame that comes after a held preroll frame. It's returned by the next read.
+	UniqueAVFrame pendingFrame;
+	size_t pendingIndex;
+	double pendingPosition;
+	std::vector<std::shared_ptr<FramePool>> framePools;
 };
 
 class FFmpegBackend: public Backend
@@ -102,10 +259,28 @@ public:
 	nav_backendtype getType() const noexcept override;
 	const char *getInfo() override;
 	State *open(nav_input *input, const char *filename, const nav_settings *settings) override;
+	State *openCached(
+		nav_input *input,
+		const char *filename,
+		const nav_settings *settings,
+		const std::vector<uint8_t> &probeData
+	) override;
+	bool canOpen(ContainerType container) override;
 
 private:
 	friend class FFmpegState;
+
+	// Opens the demuxer of `input` without probing its streams.
+	void openFormat(
+		nav_input *input,
+		const char *filename,
+		const nav_settings &settings,
+		std::unique_ptr<InputContext> &inputContext,
+		UniqueAVIOContext &ioContext,
+		UniqueAVFormatContext &formatContext
+	);
 	friend class FFmpegFrame;
+	friend struct Converter;
 
 	DynLib avutil, avcodec, avformat, swscale, swresample;
 	std::string info;
@@ -1,15 +1,29 @@
 #if defined(_NAV_PROXY_FUNCTION_POINTER) && defined(_NAV_FFMPEG_VERSION)
+#if _NAV_FFMPEG_VERSION >= 5
+_NAV_PROXY_FUNCTION_POINTER(avutil, av_buffer_create)
+#endif
 _NAV_PROXY_FUNCTION_POINTER(avutil, av_buffer_ref)
 _NAV_PROXY_FUNCTION_POINTER(avutil, av_buffer_unref)
+#if _NAV_FFMPEG_VERSION >= 6
+_NAV_PROXY_FUNCTION_POINTER(avutil, av_channel_layout_default)
+_NAV_PROXY_FUNCTION_POINTER(avutil, av_channel_layout_from_mask)
+#endif
 _NAV_PROXY_FUNCTION_POINTER(avutil, av_frame_alloc)
-_NAV_PROXY_FUNCTION_POINTER(avutil, av_frame_clone)
 _NAV_PROXY_FUNCTION_POINTER(avutil, av_frame_free)
+_NAV_PROXY_FUNCTION_POINTER(avutil, av_frame_move_ref)
 _NAV_PROXY_FUNCTION_POINTER(avutil, av_frame_unref)
+_NAV_PROXY_FUNCTION_POINTER(avutil, av_free)
+_NAV_PROXY_FUNCTION_POINTER(avutil, av_get_bytes_per_sample)
 _NAV_PROXY_FUNCTION_POINTER(avutil, av_get_packed_sample_fmt)
 _NAV_PROXY_FUNCTION_POINTER(avutil, av_hwdevice_ctx_create)
 _NAV_PROXY_FUNCTION_POINTER(avutil, av_hwdevice_iterate_types)
 _NAV_PROXY_FUNCTION_POINTER(avutil, av_hwframe_transfer_data)
 _NAV_PROXY_FUNCTION_POINTER(avutil, av_malloc)
+_NAV_PROXY_FUNCTION_POINTER(avutil, av_mallocz)
+#if _NAV_FFMPEG_VERSION >= 5
+_NAV_PROXY_FUNCTION_POINTER(avutil, av_opt_set_int)
+#endif
+_NAV_PROXY_FUNCTION_POINTER(avutil, av_sample_fmt_is_planar)
 _NAV_PROXY_FUNCTION_POINTER(avutil, av_strerror)
 _NAV_PROXY_FUNCTION_POINTER(avutil, avutil_version)
 _NAV_PROXY_FUNCTION_POINTER(avcodec, av_packet_alloc)
@@ -25,6 +39,7 @@ _NAV_PROXY_FUNCTION_POINTER(avcodec, avcodec_parameters_to_context)
 _NAV_PROXY_FUNCTION_POINTER(avcodec, avcodec_receive_frame)
 _NAV_PROXY_FUNCTION_POINTER(avcodec, avcodec_send_packet)
 _NAV_PROXY_FUNCTION_POINTER(avcodec, avcodec_version)
+_NAV_PROXY_FUNCTION_POINTER(avformat, av_find_input_format)
 _NAV_PROXY_FUNCTION_POINTER(avformat, av_read_frame)
 _NAV_PROXY_FUNCTION_POINTER(avformat, avformat_alloc_context)
 _NAV_PROXY_FUNCTION_POINTER(avformat, avformat_find_stream_info)
@@ -44,8 +59,14 @@ _NAV_PROXY_FUNCTION_POINTER(swresample, swr_convert)
 _NAV_PROXY_FUNCTION_POINTER(swresample, swr_free)
 _NAV_PROXY_FUNCTION_POINTER(swresample, swr_init)
 _NAV_PROXY_FUNCTION_POINTER(swresample, swresample_version)
+#if _NAV_FFMPEG_VERSION >= 5
+_NAV_PROXY_FUNCTION_POINTER(swscale, sws_alloc_context)
+_NAV_PROXY_FUNCTION_POINTER(swscale, sws_init_context)
+_NAV_PROXY_FUNCTION_POINTER(swscale, sws_scale_frame)
+#else
 _NAV_PROXY_FUNCTION_POINTER(swscale, sws_getContext)
-_NAV_PROXY_FUNCTION_POINTER(swscale, sws_freeContext)
 _NAV_PROXY_FUNCTION_POINTER(swscale, sws_scale)
+#endif
+_NAV_PROXY_FUNCTION_POINTER(swscale, sws_freeContext)
 _NAV_PROXY_FUNCTION_POINTER(swscale, swscale_version)
 #endif /* defined(_NAV_PROXY_FUNCTION_POINTER) && defined(_NAV_FFMPEG_VERSION) */
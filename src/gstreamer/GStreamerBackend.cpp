@@ -25,14 +25,28 @@ constexpr struct NAVGstPixelFormatMap
 {
 	const char *gstName;
 	nav_pixelformat format;
+	bool requestOnly; // Only used if the caller asks for it.
 } NAV_PIXELFORMAT_MAP[] = {
 	// When NAV supports more pixel format, add it here.
-	{"Y444", NAV_PIXELFORMAT_YUV444},
-	{"I420", NAV_PIXELFORMAT_YUV420},
-	{"NV12", NAV_PIXELFORMAT_NV12},
-	{"RGB", NAV_PIXELFORMAT_RGB8}
+	{"Y444", NAV_PIXELFORMAT_YUV444, false},
+	{"I420", NAV_PIXELFORMAT_YUV420, false},
+	{"NV12", NAV_PIXELFORMAT_NV12, false},
+	{"RGB", NAV_PIXELFORMAT_RGB8, false},
+	{"RGBA", NAV_PIXELFORMAT_RGBA8, true},
+	{"BGRA", NAV_PIXELFORMAT_BGRA8, true}
 };
 
+static const char *getGstPixelFormatName(nav_pixelformat format)
+{
+	for (const NAVGstPixelFormatMap &map: NAV_PIXELFORMAT_MAP)
+	{
+		if (map.format == format)
+			return map.gstName;
+	}
+
+	return nullptr;
+}
+
 constexpr struct NAVGstAudioFormatMap
 {
 	const char *gstName;
@@ -114,13 +128,39 @@ GStreamerAudioFrame::GStreamerAudioFrame(
 , streamInfo(sinfo)
 , streamIndex(si)
 {
+	reset(backend, buf, sinfo, si, pts);
+}
+
+GStreamerAudioFrame::~GStreamerAudioFrame()
+{
+	recycle();
+}
+
+void GStreamerAudioFrame::reset(GStreamerBackend *backend, GstBuffer *buf, nav_streaminfo_t *sinfo, size_t si, double pts)
+{
+	f = backend;
+	streamInfo = sinfo;
+	streamIndex = si;
+	this->pts = pts;
 	buffer = NAV_FFCALL(gst_buffer_ref)(buf);
 	memory = NAV_FFCALL(gst_buffer_get_all_memory)(buffer);
 }
 
-GStreamerAudioFrame::~GStreamerAudioFrame()
+void GStreamerAudioFrame::recycle() noexcept
 {
-	NAV_FFCALL(gst_buffer_unref)(buffer);
+	release();
+
+	if (memory)
+	{
+		NAV_FFCALL(gst_memory_unref)(memory);
+		memory = nullptr;
+	}
+
+	if (buffer)
+	{
+		NAV_FFCALL(gst_buffer_unref)(buffer);
+		buffer = nullptr;
+	}
 }
 
 size_t GStreamerAudioFrame::getStreamIndex() const noexcept
@@ -161,7 +201,9 @@ void GStreamerAudioFrame::release() noexcept
 	if (acquireData.source)
 	{
 		NAV_FFCALL(gst_memory_unmap)(memory, &mapInfo);
-		acquireData = {};
+		acquireData.source = nullptr;
+		acquireData.planes.clear();
+		acquireData.strides.clear();
 	}
 }
 
@@ -179,7 +221,7 @@ void *GStreamerAudioFrame::getHWAccelHandle()
 
 GStreamerVideoFrame::GStreamerVideoFrame(
 	GStreamerBackend *backend,
-	UniqueGst<GstVideoInfo> &&videoInfo,
+	const GstVideoInfo &videoInfo,
 	GstBuffer *buffer,
 	nav_streaminfo_t *sinfo,
 	size_t si,
@@ -187,19 +229,47 @@ GStreamerVideoFrame::GStreamerVideoFrame(
 )
 : acquireData()
 , videoFrame()
-, videoInfo(std::move(videoInfo))
+, videoInfo(videoInfo)
 , pts(pts)
 , f(backend)
 , buffer(nullptr)
 , streamInfo(sinfo)
 , streamIndex(si)
 {
-	this->buffer = NAV_FFCALL(gst_buffer_ref)(buffer);
+	reset(backend, videoInfo, buffer, sinfo, si, pts);
 }
 
 GStreamerVideoFrame::~GStreamerVideoFrame()
 {
-	NAV_FFCALL(gst_buffer_unref)(buffer);
+	recycle();
+}
+
+void GStreamerVideoFrame::reset(
+	GStreamerBackend *backend,
+	const GstVideoInfo &videoInfo,
+	GstBuffer *buffer,
+	nav_streaminfo_t *sinfo,
+	size_t si,
+	double pts
+)
+{
+	f = backend;
+	this->videoInfo = videoInfo;
+	streamInfo = sinfo;
+	streamIndex = si;
+	this->pts = pts;
+	this->buffer = NAV_FFCALL(gst_buffer_ref)(buffer);
+}
+
+void GStreamerVideoFrame::recycle() noexcept
+{
+	release();
+
+	if (buffer)
+	{
+		NAV_FFCALL(gst_buffer_unref)(buffer);
+		buffer = nullptr;
+	}
 }
 
 size_t GStreamerVideoFrame::getStreamIndex() const noexcept
@@ -221,7 +291,7 @@ const uint8_t *const *GStreamerVideoFrame::acquire(ptrdiff_t **strides, size_t *
 {
 	if (!acquireData.source)
 	{
-		if (!NAV_FFCALL(gst_video_frame_map)(&videoFrame, videoInfo.get(), buffer, GST_MAP_READ))
+		if (!NAV_FFCALL(gst_video_frame_map)(&videoFrame, &videoInfo, buffer, GST_MAP_READ))
 			throw std::runtime_error("Cannot map video frame");
 
 		acquireData.source = (uint8_t *) videoFrame.buffer; // Just for marking
@@ -250,7 +320,9 @@ void GStreamerVideoFrame::release() noexcept
 	if (acquireData.source)
 	{
 		NAV_FFCALL(gst_video_frame_unmap)(&videoFrame);
-		acquireData = {};
+		acquireData.source = nullptr;
+		acquireData.planes.clear();
+		acquireData.strides.clear();
 	}
 }
 
@@ -266,9 +338,11 @@ void *GStreamerVideoFrame::getHWAccelHandle()
 }
 
 
-GStreamerState::GStreamerState(GStreamerBackend *backend, nav_input *input)
+GStreamerState::GStreamerState(GStreamerBackend *backend, nav_input *input, size_t ioBufferSize, bool lowLatency)
 : f(backend)
 , input(*input)
+, ioBufferSize(ioBufferSize)
+, lowLatency(lowLatency)
 , bus(nullptr, NAV_FFCALL(gst_object_unref))
 , pipeline(nullptr, NAV_FFCALL(gst_object_unref))
 , source(nullptr)
@@ -408,6 +482,8 @@ GStreamerState::GStreamerState(GStreamerBackend *backend, nav_input *input)
 						sw->streamInfo.video.width = (uint32_t) temp;
 						NAV_FFCALL(gst_structure_get_int)(s, "height", &temp);
 						sw->streamInfo.video.height = (uint32_t) temp;
+						sw->sourceWidth = sw->streamInfo.video.width;
+						sw->sourceHeight = sw->streamInfo.video.height;
 
 						if (NAV_FFCALL(gst_structure_get_fraction)(s, "framerate", &temp, &temp2))
 							sw->streamInfo.video.fps = derationalize(temp, temp2);
@@ -482,6 +558,83 @@ bool GStreamerState::setStreamEnabled(size_t index, bool enabled)
 	return true;
 }
 
+bool GStreamerState::setPixelFormat(size_t index, nav_pixelformat format)
+{
+	AppSinkWrapper *sw = getReconfigurableVideo(index);
+	if (sw == nullptr)
+		return false;
+
+	if (getGstPixelFormatName(format) == nullptr)
+	{
+		nav::error::set("Unsupported pixel format");
+		return false;
+	}
+
+	sw->streamInfo.video.format = format;
+	reconfigureVideoSink(sw);
+	return true;
+}
+
+bool GStreamerState::setVideoSize(size_t index, uint32_t width, uint32_t height, nav_scaler scaler)
+{
+	AppSinkWrapper *sw = getReconfigurableVideo(index);
+	if (sw == nullptr)
+		return false;
+
+	if (sw->scale == nullptr)
+		return nav_t::setVideoSize(index, width, height, scaler);
+
+	switch (scaler)
+	{
+		case NAV_SCALER_DEFAULT:
+		default:
+			break;
+		case NAV_SCALER_FAST_BILINEAR:
+		case NAV_SCALER_BILINEAR:
+			NAV_FFCALL(gst_util_set_object_arg)(G_CAST<GObject>(f, G_TYPE_OBJECT, sw->scale), "method", "bilinear");
+			break;
+		case NAV_SCALER_BICUBIC:
+			NAV_FFCALL(gst_util_set_object_arg)(G_CAST<GObject>(f, G_TYPE_OBJECT, sw->scale), "method", "4-tap");
+			break;
+	}
+
+	sw->streamInfo.video.width = width ? width : sw->sourceWidth;
+	sw->streamInfo.video.height = height ? height : sw->sourceHeight;
+	reconfigureVideoSink(sw);
+	return true;
+}
+
+bool GStreamerState::setKeyframesOnly(size_t index, bool keyframesOnly)
+{
+	if (index >= streams.size())
+	{
+		nav::error::set("Stream index out of range");
+		return false;
+	}
+
+	std::unique_ptr<AppSinkWrapper> &sw = streams[index];
+	if (sw->streamInfo.type != NAV_STREAMTYPE_VIDEO)
+	{
+		nav::error::set("Not a video stream");
+		return false;
+	}
+
+	if (sw->keyframesOnly == keyframesOnly)
+		return true;
+
+	sw->keyframesOnly = keyframesOnly;
+
+	// Trick mode only takes effect through a seek.
+	double position = getPosition();
+	if (position < 0 || setPosition(position) < 0)
+	{
+		sw->keyframesOnly = !keyframesOnly;
+		return false;
+	}
+
+	return true;
+}
+
 double GStreamerState::getDuration() noexcept
 {
 	gint64 dur = 0;
@@ -506,21 +659,13 @@ double GStreamerState::getPosition() noexcept
 
 double GStreamerState::setPosition(double off)
 {
-	gint64 pos = (gint64) (off * GST_SECOND);
-	if (!NAV_FFCALL(gst_element_seek_simple)(
-		pipeline.get(),
-		GST_FORMAT_TIME,
-		(GstSeekFlags) (GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT | GST_SEEK_FLAG_SNAP_BEFORE),
-		pos
-	))
-	{
-		nav::error::set("gst_element_seek_simple failed");
-		return -1;
-	}
+	return seekPipeline(off, false);
+}
 
-	eos = false;
-	clearQueuedFrames();
-	return getPosition();
+double GStreamerState::setPositionAccurate(double off)
+{
+	// The decoders clip frames outside the new segment before they reach the converters.
+	return seekPipeline(off, true);
 }
 
 bool GStreamerState::prepare()
@@ -564,8 +709,8 @@ nav_frame_t *GStreamerState::read()
 
 				if (sample)
 				{
-					GstBuffer *buffer = NAV_FFCALL(gst_sample_get_buffer)(sample.get());
-					queuedFrames.push(dispatchDecode(buffer, sw->streamIndex));
+					if (Frame *frame = dispatchDecode(sample.get(), sw->streamIndex))
+						queuedFrames.push(frame);
 				}
 				else
 				{
@@ -591,13 +736,68 @@ nav_frame_t *GStreamerState::read()
 	return nullptr;
 }
 
-GstCaps *GStreamerState::newVideoCapsForNAV()
+bool GStreamerState::readBatch(nav_frame_t **out, size_t max, size_t *count)
+{
+	*count = 0;
+
+	if (max > 0 && (out[0] = read()) != nullptr)
+	{
+		// Frames pulled from the other sinks in the same pass are ready too.
+		for (*count = 1; *count < max && !queuedFrames.empty(); ++*count)
+		{
+			out[*count] = queuedFrames.top();
+			queuedFrames.pop();
+		}
+	}
+
+	return true;
+}
+
+GStreamerState::AppSinkWrapper *GStreamerState::getReconfigurableVideo(size_t index)
+{
+	if (index >= streams.size())
+	{
+		nav::error::set("Stream index out of range");
+		return nullptr;
+	}
+
+	if (prepared)
+	{
+		nav::error::set("Decoder already initialized");
+		return nullptr;
+	}
+
+	AppSinkWrapper *sw = streams[index].get();
+	if (sw->streamInfo.type != NAV_STREAMTYPE_VIDEO)
+	{
+		nav::error::set("Not a video stream");
+		return nullptr;
+	}
+
+	return sw;
+}
+
+void GStreamerState::reconfigureVideoSink(AppSinkWrapper *sw)
+{
+	// Restrict the appsink caps so videoconvert and videoscale do the whole conversion, then renegotiate.
+	const nav_streaminfo_t::VideoStreamInfo &video = sw->streamInfo.video;
+	UniqueGst<GstCaps> caps {newVideoCapsForNAV(video.format, video.width, video.height), NAV_FFCALL(gst_caps_unref)};
+	NAV_FFCALL(g_object_set)(sw->sink, "caps", caps.get(), nullptr);
+
+	UniqueGstObject<GstPad> pad {NAV_FFCALL(gst_element_get_static_pad)(sw->sink, "sink"), NAV_FFCALL(gst_object_unref)};
+	NAV_FFCALL(gst_pad_push_event)(pad.get(), NAV_FFCALL(gst_event_new_reconfigure)());
+}
+
+GstCaps *GStreamerState::newVideoCapsForNAV(nav_pixelformat only, uint32_t width, uint32_t height)
 {
 	GValue format = G_VALUE_INIT;
 	NAV_FFCALL(g_value_init)(&format, NAV_GST_TYPE_LIST);
 
 	for (const NAVGstPixelFormatMap &map: NAV_PIXELFORMAT_MAP)
 	{
+		if (only == NAV_PIXELFORMAT_UNKNOWN ? map.requestOnly : map.format != only)
+			continue;
+
 		GValue v = G_VALUE_INIT;
 		NAV_FFCALL(g_value_init)(&v, G_TYPE_STRING);
 		NAV_FFCALL(g_value_set_static_string)(&v, map.gstName);
@@ -605,13 +805,24 @@ GstCaps *GStreamerState::newVideoCapsForNAV()
 	}
 
 	GstStructure *s = NAV_FFCALL(gst_structure_new)("video/x-raw",
-		"width", NAV_GST_TYPE_INT_RANGE, 1, G_MAXINT,
-		"height", NAV_GST_TYPE_INT_RANGE, 1, G_MAXINT,
 		"interlace-mode", G_TYPE_STRING, "progressive",
 		nullptr
 	);
 	NAV_FFCALL(gst_structure_take_value)(s, "format", &format);
 
+	if (width > 0 && height > 0)
+		NAV_FFCALL(gst_structure_set)(s,
+			"width", G_TYPE_INT, (gint) width,
+			"height", G_TYPE_INT, (gint) height,
+			nullptr
+		);
+	else
+		NAV_FFCALL(gst_structure_set)(s,
+			"width", NAV_GST_TYPE_INT_RANGE, 1, G_MAXINT,
+			"height", NAV_GST_TYPE_INT_RANGE, 1, G_MAXINT,
+			nullptr
+		);
+
 	GstCaps *caps = NAV_FFCALL(gst_caps_new_empty)();
 	NAV_FFCALL(gst_caps_append_structure)(caps, s);
 	return caps;
@@ -648,7 +859,7 @@ void GStreamerState::clearQueuedFrames()
 	while (!queuedFrames.empty())
 	{
 		Frame *fv = queuedFrames.top();
-		delete fv;
+		fv->dispose();
 		queuedFrames.pop();
 	}
 }
@@ -690,22 +901,31 @@ void GStreamerState::pollBus(bool noexc)
 	}
 }
 
-Frame *GStreamerState::dispatchDecode(GstBuffer *buffer, size_t streamIndex)
+Frame *GStreamerState::dispatchDecode(GstSample *sample, size_t streamIndex)
 {
 	std::unique_ptr<AppSinkWrapper> &sw = streams[streamIndex];
+	GstBuffer *buffer = NAV_FFCALL(gst_sample_get_buffer)(sample);
 
 	if (sw->streamInfo.type == NAV_STREAMTYPE_VIDEO)
 	{
-		UniqueGstObject<GstPad> pad {NAV_FFCALL(gst_element_get_static_pad)(sw->convert, "src"), NAV_FFCALL(gst_object_unref)};
-		UniqueGst<GstCaps> caps {NAV_FFCALL(gst_pad_get_current_caps)(pad.get()), NAV_FFCALL(gst_caps_unref)};
-		UniqueGst<GstVideoInfo> videoInfo{NAV_FFCALL(gst_video_info_new)(), NAV_FFCALL(gst_video_info_free)};
+		GstVideoInfo videoInfo;
+
+		if (!NAV_FFCALL(gst_video_info_from_caps)(&videoInfo, NAV_FFCALL(gst_sample_get_caps)(sample)))
+			return nullptr;
 
-		if (!NAV_FFCALL(gst_video_info_from_caps)(videoInfo.get(), caps.get()))
+		// Drop samples that were negotiated before the output format or dimensions are changed.
+		const char *formatName = getGstPixelFormatName(sw->streamInfo.video.format);
+		if (
+			formatName == nullptr ||
+			strcmp(GST_VIDEO_INFO_NAME(&videoInfo), formatName) != 0 ||
+			(uint32_t) GST_VIDEO_INFO_WIDTH(&videoInfo) != sw->streamInfo.video.width ||
+			(uint32_t) GST_VIDEO_INFO_HEIGHT(&videoInfo) != sw->streamInfo.video.height
+		)
 			return nullptr;
 
-		return new GStreamerVideoFrame(
+		return sw->framePool->make<GStreamerVideoFrame>(
 			f,
-			std::move(videoInfo),
+			videoInfo,
 			buffer,
 			&sw->streamInfo,
 			streamIndex,
@@ -714,7 +934,7 @@ Frame *GStreamerState::dispatchDecode(GstBuffer *buffer, size_t streamIndex)
 	}
 	else
 	{
-		return new GStreamerAudioFrame(
+		return sw->framePool->make<GStreamerAudioFrame>(
 			f,
 			buffer,
 			&sw->streamInfo,
@@ -724,6 +944,36 @@ Frame *GStreamerState::dispatchDecode(GstBuffer *buffer, size_t streamIndex)
 	}
 }
 
+double GStreamerState::seekPipeline(double off, bool accurate)
+{
+	gint64 pos = (gint64) (off * GST_SECOND);
+	if (!NAV_FFCALL(gst_element_seek_simple)(pipeline.get(), GST_FORMAT_TIME, getSeekFlags(accurate), pos))
+	{
+		nav::error::set("gst_element_seek_simple failed");
+		return -1;
+	}
+
+	eos = false;
+	clearQueuedFrames();
+	return getPosition();
+}
+
+GstSeekFlags GStreamerState::getSeekFlags(bool accurate) const noexcept
+{
+	int flags = GST_SEEK_FLAG_FLUSH | (accurate ? GST_SEEK_FLAG_ACCURATE : (GST_SEEK_FLAG_KEY_UNIT | GST_SEEK_FLAG_SNAP_BEFORE));
+
+	for (const std::unique_ptr<AppSinkWrapper> &sw: streams)
+	{
+		if (sw->keyframesOnly && sw->enabled)
+		{
+			flags |= GST_SEEK_FLAG_TRICKMODE | GST_SEEK_FLAG_TRICKMODE_KEY_UNITS;
+			break;
+		}
+	}
+
+	return (GstSeekFlags) flags;
+}
+
 #undef NAV_FFCALL
 #define NAV_FFCALL(n) self->f->ptr_##n
 
@@ -749,6 +999,9 @@ void GStreamerState::padAdded(GstElement *element, GstPad *pad, GStreamerState *
 		GstElement *queue = NAV_FFCALL(gst_element_factory_make)("queue", nullptr);
 		GstElement *converter = NAV_FFCALL(gst_element_factory_make)(videoStream ? "videoconvert" : "audioconvert", nullptr);
 		GstElement *sink = NAV_FFCALL(gst_element_factory_make)("appsink", nullptr);
+		// Optional, only needed if the caller requests different dimensions. It passes through otherwise.
+		GstElement *scale = videoStream ? NAV_FFCALL(gst_element_factory_make)("videoscale", nullptr) : nullptr;
+		GstElement *last = scale ? scale : converter;
 		GstCaps *targetCap = nullptr;
 		
 		// Populate caps
@@ -765,27 +1018,40 @@ void GStreamerState::padAdded(GstElement *element, GstPad *pad, GStreamerState *
 		);
 		NAV_FFCALL(gst_caps_unref)(targetCap);
 
+		if (self->lowLatency)
+			// The byte and time limits are only upper bounds, so the buffer count is what keeps the queue short.
+			NAV_FFCALL(g_object_set)(queue, "max-size-buffers", (guint) 1, nullptr);
+
 		// Add to pipeline
 		GstBin *binFromPipeline = G_CAST<GstBin>(self->f, NAV_FFCALL(gst_bin_get_type)(), self->pipeline.get());
 		NAV_FFCALL(gst_bin_add_many)(binFromPipeline, queue, converter, sink, nullptr);
+		if (scale)
+			NAV_FFCALL(gst_bin_add)(binFromPipeline, scale);
 
 		GstPad *queueSinkPad = NAV_FFCALL(gst_element_get_static_pad)(queue, "sink");
-		// Link the pad to the converter and the converter to the app sink
+		// Link the pad to the converter and the converter (through the scaler) to the app sink
 		if (
 			GST_PAD_LINK_FAILED(NAV_FFCALL(gst_pad_link)(pad, queueSinkPad)) ||
-			!NAV_FFCALL(gst_element_link_many)(queue, converter, sink, nullptr)
+			!NAV_FFCALL(gst_element_link)(queue, converter) ||
+			(scale && !NAV_FFCALL(gst_element_link)(converter, scale)) ||
+			!NAV_FFCALL(gst_element_link)(last, sink)
 		)
 		{
 			NAV_FFCALL(gst_bin_remove_many)(binFromPipeline, queue, converter, sink, nullptr);
+			if (scale)
+				NAV_FFCALL(gst_bin_remove_many)(binFromPipeline, scale, nullptr);
 			return;
 		}
 
 		streamWrapper->queue = queue;
 		streamWrapper->convert = converter;
+		streamWrapper->scale = scale;
 		streamWrapper->sink = sink;
 
 		NAV_FFCALL(gst_element_set_state)(queue, GST_STATE_PLAYING);
 		NAV_FFCALL(gst_element_set_state)(converter, GST_STATE_PLAYING);
+		if (scale)
+			NAV_FFCALL(gst_element_set_state)(scale, GST_STATE_PLAYING);
 		NAV_FFCALL(gst_element_set_state)(sink, GST_STATE_PLAYING);
 
 		// Populate stream info type.
@@ -809,31 +1075,59 @@ void GStreamerState::noMorePads(GstElement *element, GStreamerState *self)
 
 void GStreamerState::needData(GstElement *element, guint length, GStreamerState *self)
 {
-	constexpr size_t DEFAULT_SIZE = 4096; // if length is -1
-	size_t toRead = length == (guint)-1 ? DEFAULT_SIZE : length;
+	size_t toRead = length == (guint)-1 ? self->ioBufferSize : length;
 	GstFlowReturn ret;
 
 	// TODO: Error checking
-	GstMapInfo mapInfo = {};
-	GstMemory *memory = NAV_FFCALL(gst_allocator_alloc)(nullptr, (gsize) toRead, nullptr);
-	// Read
+	GstMemory *memory = nullptr;
 	size_t readed = 0;
-	{
-		GstMemoryMapLock mapInfo(self->f, memory, GST_MAP_WRITE, false);
-		readed = self->input.readf(mapInfo.data, toRead);
-	}
 
-	if (readed < toRead)
+	if (self->input.canBorrow())
 	{
+		// Wrap the input data directly. It outlives the pipeline, so nothing has to be freed.
+		uint64_t pos = self->input.tellf();
+		const void *data = nullptr;
+		readed = self->input.borrowf(pos, toRead, &data);
+
 		if (readed == 0)
 		{
 			// EOF
-			NAV_FFCALL(gst_memory_unref)(memory);
 			NAV_FFCALL(g_signal_emit_by_name)(element, "end-of-stream", &ret);
 			return;
 		}
 
-		NAV_FFCALL(gst_memory_resize)(memory, 0, (gsize) readed);
+		memory = NAV_FFCALL(gst_memory_new_wrapped)(
+			GST_MEMORY_FLAG_READONLY,
+			(gpointer) data,
+			(gsize) readed,
+			0,
+			(gsize) readed,
+			nullptr,
+			nullptr
+		);
+		self->input.seekf(pos + readed);
+	}
+	else
+	{
+		memory = NAV_FFCALL(gst_allocator_alloc)(nullptr, (gsize) toRead, nullptr);
+		// Read
+		{
+			GstMemoryMapLock mapInfo(self->f, memory, GST_MAP_WRITE, false);
+			readed = self->input.readf(mapInfo.data, toRead);
+		}
+
+		if (readed < toRead)
+		{
+			if (readed == 0)
+			{
+				// EOF
+				NAV_FFCALL(gst_memory_unref)(memory);
+				NAV_FFCALL(g_signal_emit_by_name)(element, "end-of-stream", &ret);
+				return;
+			}
+
+			NAV_FFCALL(gst_memory_resize)(memory, 0, (gsize) readed);
+		}
 	}
 
 	uint64_t newpos = self->input.tellf();
@@ -862,8 +1156,14 @@ GStreamerState::AppSinkWrapper::AppSinkWrapper(GStreamerState *state, size_t str
 , self(state)
 , queue(nullptr)
 , convert(nullptr)
+, scale(nullptr)
 , sink(nullptr)
+, sourceWidth(0)
+, sourceHeight(0)
+, framePool(std::make_shared<FramePool>())
 , eos(false)
+, enabled(false)
+, keyframesOnly(false)
 {
 	streamInfo.type = NAV_STREAMTYPE_UNKNOWN;
 }
@@ -944,18 +1244,20 @@ const char *GStreamerBackend::getInfo()
 	return version.c_str();
 }
 
-State *GStreamerBackend::open(nav_input *input, const char *filename, [[maybe_unused]] const nav_settings *settings)
+State *GStreamerBackend::open(nav_input *input, const char *filename, const nav_settings *settings)
 {
-	return new GStreamerState(this, input);
+	return new GStreamerState(this, input, settings->io_buffer_size, settings->low_latency);
 }
 
 #undef NAV_FFCALL
 
-Backend *create()
+static bool isDisabled()
 {
-	if (checkBackendDisabled("GSTREAMER"))
-		return nullptr;
+	return checkBackendDisabled("GSTREAMER");
+}
 
+Backend *create()
+{
 	try
 	{
 		return new GStreamerBackend();
@@ -967,6 +1269,8 @@ Backend *create()
 	}
 }
 
+const BackendDescriptor descriptor = {"gstreamer", NAV_BACKENDTYPE_3RD_PARTY, false, isDisabled, create};
+
 }
 
 #endif /* NAV_BACKEND_GSTREAMER */
@@ -11,6 +11,7 @@
 namespace nav::gstreamer
 {
 
+extern const BackendDescriptor descriptor;
 Backend *create();
 
 }
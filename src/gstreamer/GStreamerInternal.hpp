@@ -6,6 +6,7 @@
 #ifdef NAV_BACKEND_GSTREAMER
 
 #include <gst/gst.h>
+#include <gst/video/video.h>
 
 #include <memory>
 #include <string>
@@ -39,6 +40,7 @@ public:
 		double pts
 	);
 	~GStreamerAudioFrame() override;
+	void reset(GStreamerBackend *backend, GstBuffer *buffer, nav_streaminfo_t *sinfo, size_t si, double pts);
 	size_t getStreamIndex() const noexcept override;
 	const nav_streaminfo_t *getStreamInfo() const noexcept override;
 	double tell() const noexcept override;
@@ -46,6 +48,7 @@ public:
 	void release() noexcept override;
 	nav_hwacceltype getHWAccelType() const noexcept override;
 	void *getHWAccelHandle() override;
+	void recycle() noexcept override;
 
 private:
 	AcquireData acquireData;
@@ -63,13 +66,21 @@ class GStreamerVideoFrame: public Frame
 public:
 	GStreamerVideoFrame(
 		GStreamerBackend *backend,
-		UniqueGst<GstVideoInfo> &&videoInfo,
+		const GstVideoInfo &videoInfo,
 		GstBuffer *buffer,
 		nav_streaminfo_t *sinfo,
 		size_t si,
 		double pts
 	);
 	~GStreamerVideoFrame() override;
+	void reset(
+		GStreamerBackend *backend,
+		const GstVideoInfo &videoInfo,
+		GstBuffer *buffer,
+		nav_streaminfo_t *sinfo,
+		size_t si,
+		double pts
+	);
 	size_t getStreamIndex() const noexcept override;
 	const nav_streaminfo_t *getStreamInfo() const noexcept override;
 	double tell() const noexcept override;
@@ -77,11 +88,12 @@ public:
 	void release() noexcept override;
 	nav_hwacceltype getHWAccelType() const noexcept override;
 	void *getHWAccelHandle() override;
+	void recycle() noexcept override;
 
 private:
 	AcquireData acquireData;
 	GstVideoFrame videoFrame;
-	UniqueGst<GstVideoInfo> videoInfo;
+	GstVideoInfo videoInfo;
 	double pts;
 	GStreamerBackend *f;
 	GstBuffer *buffer;
@@ -92,19 +104,24 @@ private:
 class GStreamerState: public State
 {
 public:
-	GStreamerState(GStreamerBackend *backend, nav_input *input);
+	GStreamerState(GStreamerBackend *backend, nav_input *input, size_t ioBufferSize, bool lowLatency);
 	~GStreamerState() override;
 	Backend *getBackend() const noexcept override;
 	size_t getStreamCount() const noexcept override;
 	const nav_streaminfo_t *getStreamInfo(size_t index) const noexcept override;
 	bool isStreamEnabled(size_t index) const noexcept override;
 	bool setStreamEnabled(size_t index, bool enabled) override;
+	bool setPixelFormat(size_t index, nav_pixelformat format) override;
+	bool setVideoSize(size_t index, uint32_t width, uint32_t height, nav_scaler scaler) override;
+	bool setKeyframesOnly(size_t index, bool keyframesOnly) override;
 	double getDuration() noexcept override;
 	double getPosition() noexcept override;
 	double setPosition(double off) override;
+	double setPositionAccurate(double off) override;
 	bool prepare() override;
 	bool isPrepared() const noexcept override;
 	nav_frame_t *read() override;
+	bool readBatch(nav_frame_t **out, size_t max, size_t *count) override;
 
 private:
 	struct AppSinkWrapper
@@ -123,9 +140,12 @@ private:
 		nav_streaminfo_t streamInfo;
 		size_t streamIndex;
 		GStreamerState *self;
-		GstElement *queue, *convert, *sink;
+		GstElement *queue, *convert, *scale, *sink;
+		// Decoded dimensions, before scaling.
+		uint32_t sourceWidth, sourceHeight;
+		std::shared_ptr<FramePool> framePool;
 		gulong probeID;
-		bool eos, enabled;
+		bool eos, enabled, keyframesOnly;
 	};
 
 	struct FrameComparator
@@ -135,6 +155,10 @@ private:
 
 	GStreamerBackend *f;
 	nav_input input;
+	// Amount of bytes pushed to appsrc when it doesn't ask for a specific size.
+	size_t ioBufferSize;
+	// Keep as few buffers as possible between the decoder and the appsinks.
+	bool lowLatency;
 	UniqueGstObject<GstBus> bus;
 	UniqueGstElement pipeline;
 	GstElement *source, *decoder;
@@ -142,11 +166,17 @@ private:
 	std::priority_queue<Frame*, std::deque<Frame*>, FrameComparator> queuedFrames;
 	bool padProbed, eos, prepared;
 
-	GstCaps *newVideoCapsForNAV();
+	// If `only` is specified, restrict the caps to that pixel format. Same for the dimensions if they're not 0.
+	GstCaps *newVideoCapsForNAV(nav_pixelformat only = NAV_PIXELFORMAT_UNKNOWN, uint32_t width = 0, uint32_t height = 0);
+	AppSinkWrapper *getReconfigurableVideo(size_t index);
+	void reconfigureVideoSink(AppSinkWrapper *sw);
 	GstCaps *newAudioCapsForNAV();
 	void clearQueuedFrames();
 	void pollBus(bool noexception = false);
-	Frame *dispatchDecode(GstBuffer *buffer, size_t streamIndex);
+	Frame *dispatchDecode(GstSample *sample, size_t streamIndex);
+	// Trick mode applies to the whole pipeline, so it's used if any stream wants keyframes only.
+	GstSeekFlags getSeekFlags(bool accurate = false) const noexcept;
+	double seekPipeline(double off, bool accurate);
 	static void padAdded(GstElement *element, GstPad *newPad, GStreamerState *self);
 	static void noMorePads(GstElement *element, GStreamerState *self);
 	static void needData(GstElement *element, guint length, GStreamerState *self);
@@ -36,8 +36,10 @@ _NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_element_seek_simple)
 _NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_element_set_state)
 _NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_element_query_duration)
 _NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_element_query_position)
+_NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_event_new_reconfigure)
 _NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_init_check)
 _NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_memory_map)
+_NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_memory_new_wrapped)
 _NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_memory_resize)
 _NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_memory_unmap)
 _NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_memory_unref)
@@ -47,8 +49,10 @@ _NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_object_unref)
 _NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_pad_add_probe)
 _NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_pad_get_current_caps)
 _NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_pad_link)
+_NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_pad_push_event)
 _NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_pipeline_new)
 _NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_sample_get_buffer)
+_NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_sample_get_caps)
 _NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_sample_unref)
 _NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_structure_get_double)
 _NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_structure_get_fraction)
@@ -56,6 +60,7 @@ _NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_structure_get_int)
 _NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_structure_get_name)
 _NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_structure_get_string)
 _NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_structure_new)
+_NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_structure_set)
 _NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_structure_take_value)
 _NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_util_set_object_arg)
 _NAV_PROXY_FUNCTION_POINTER(gstreamer, gst_value_list_append_and_take_value)
@@ -65,7 +70,5 @@ _NAV_PROXY_FUNCTION_POINTER(gstreamer, _gst_int_range_type)
 _NAV_PROXY_FUNCTION_POINTER(gstreamer, _gst_value_list_type)
 _NAV_PROXY_FUNCTION_POINTER(gstvideo, gst_video_frame_map)
 _NAV_PROXY_FUNCTION_POINTER(gstvideo, gst_video_frame_unmap)
-_NAV_PROXY_FUNCTION_POINTER(gstvideo, gst_video_info_new)
-_NAV_PROXY_FUNCTION_POINTER(gstvideo, gst_video_info_free)
 _NAV_PROXY_FUNCTION_POINTER(gstvideo, gst_video_info_from_caps)
 #endif /* _NAV_PROXY_FUNCTION_POINTER */
@@ -441,6 +441,23 @@ MediaFoundationFrame::MediaFoundationFrame(nav_streaminfo_t *sinfo, ComPtr<IMFMe
 {
 }
 
+void MediaFoundationFrame::reset(nav_streaminfo_t *sinfo, ComPtr<IMFMediaBuffer> &buffer, double pts, size_t si)
+{
+	mediaBuffer = buffer;
+	buffer2D = buffer.dcast<IMF2DBuffer>(IMF2DBuffer_GUID);
+	this->pts = pts;
+	streamInfo = sinfo;
+	index = si;
+	ishwaccelerated = bool(mediaBuffer.dcast<IMFDXGIBuffer>(IMFDXGIBuffer_GUID));
+}
+
+void MediaFoundationFrame::recycle() noexcept
+{
+	release();
+	buffer2D.release(true);
+	mediaBuffer.release(true);
+}
+
 size_t MediaFoundationFrame::getStreamIndex() const noexcept
 {
 	return index;
@@ -616,7 +633,9 @@ void MediaFoundationFrame::release() noexcept
 			mediaBuffer->Unlock();
 	}
 	
-	acquireData = {};
+	acquireData.source = nullptr;
+	acquireData.planes.clear();
+	acquireData.strides.clear();
 }
 
 nav_hwacceltype MediaFoundationFrame::getHWAccelType() const noexcept
@@ -655,6 +674,7 @@ MediaFoundationState::MediaFoundationState(
 , mfSourceReader(mfsr)
 , hwaccel()
 , streamInfoList()
+, framePools()
 , currentPosition(0)
 , prepared(false)
 {
@@ -802,6 +822,7 @@ MediaFoundationState::MediaFoundationState(
 		}
 
 		streamInfoList.push_back(streamInfo);
+		framePools.push_back(std::make_shared<FramePool>());
 	}
 }
 
@@ -968,7 +989,7 @@ nav_frame_t *MediaFoundationState::decode(ComPtr<IMFSample> &mfSample, size_t st
 	if (HRESULT hr = mfSample->GetBufferByIndex(0, mfMediaBuffer.dptr()); FAILED(hr))
 		runtimeErrorWithHRESULT("IMFSample::GetBufferByIndex failed", hr);
 
-	return new MediaFoundationFrame(
+	return framePools[streamIndex]->make<MediaFoundationFrame>(
 		&streamInfoList[streamIndex],
 		mfMediaBuffer,
 		derationalize(timestamp, MF_100NS_UNIT),
@@ -1110,11 +1131,13 @@ const char *MediaFoundationBackend::getInfo()
 	return nullptr;
 }
 
-Backend *create()
+static bool isDisabled()
 {
-	if (checkBackendDisabled("MEDIAFOUNDATION"))
-		return nullptr;
+	return checkBackendDisabled("MEDIAFOUNDATION");
+}
 
+Backend *create()
+{
 	try
 	{
 		return new MediaFoundationBackend();
@@ -1126,6 +1149,9 @@ Backend *create()
 	}
 }
 
+// COM is initialized in the thread that loads it.
+const BackendDescriptor descriptor = {"mediafoundation", NAV_BACKENDTYPE_OS_API, true, isDisabled, create};
+
 }
 
 #endif /* NAV_BACKEND_MEDIAFOUNDATION */
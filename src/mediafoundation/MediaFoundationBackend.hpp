@@ -11,6 +11,7 @@
 namespace nav::mediafoundation
 {
 
+extern const BackendDescriptor descriptor;
 Backend *create();
 
 }
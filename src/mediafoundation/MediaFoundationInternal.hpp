@@ -1,6 +1,7 @@
 #ifndef _NAV_BACKEND_MEDIAFOUNDATION_INTERNAL_
 #define _NAV_BACKEND_MEDIAFOUNDATION_INTERNAL_
 
+#include <memory>
 #include <string>
 #include <type_traits>
 #include <vector>
@@ -14,6 +15,7 @@
 #include "Internal.hpp"
 #include "nav/input.h"
 #include "Backend.hpp"
+#include "Common.hpp"
 #include "DynLib.hpp"
 
 namespace nav::mediafoundation
@@ -71,8 +73,15 @@ public:
 
 	ComPtr &operator=(ComPtr<T> &&other)
 	{
-		ptr = other.ptr;
-		other.ptr = nullptr;
+		if (this != &other)
+		{
+			if (ptr)
+				ptr->Release();
+
+			ptr = other.ptr;
+			other.ptr = nullptr;
+		}
+
 		return *this;
 	}
 
@@ -174,6 +183,7 @@ class MediaFoundationFrame: public Frame
 {
 public:
 	MediaFoundationFrame(nav_streaminfo_t *sinfo, ComPtr<IMFMediaBuffer> &buffer, double pts, size_t si);
+	void reset(nav_streaminfo_t *sinfo, ComPtr<IMFMediaBuffer> &buffer, double pts, size_t si);
 	size_t getStreamIndex() const noexcept override;
 	const nav_streaminfo_t *getStreamInfo() const noexcept override;
 	double tell() const noexcept override;
@@ -181,6 +191,7 @@ public:
 	void release() noexcept override;
 	nav_hwacceltype getHWAccelType() const noexcept override;
 	void *getHWAccelHandle() override;
+	void recycle() noexcept override;
 
 private:
 	void acquireDefault();
@@ -232,6 +243,7 @@ private:
 	HWAccelState hwaccel;
 
 	std::vector<nav::StreamInfo> streamInfoList;
+	std::vector<std::shared_ptr<FramePool>> framePools;
 	UINT64 currentPosition; // in 100-nanosecond
 	bool prepared;
 };